@@ -38,6 +38,7 @@
 # include <arpa/inet.h>
 # include <netinet/tcp.h>
 # include <netinet/in.h>
+# include <linux/filter.h>
 #elif defined(KUMA_OS_MAC)
 # include <string.h>
 # include <pthread.h>
@@ -67,6 +68,9 @@
 
 using namespace kuma;
 
+// max fds accepted in one wakeup, then give the other fds on this loop a chance
+#define ACCEPT_BATCH_SIZE   64
+
 AcceptorBase::AcceptorBase(const EventLoopPtr &loop)
 : loop_(loop)
 {
@@ -116,7 +120,8 @@ KMError AcceptorBase::listen(const std::string &host, uint16_t port)
         KUMA_ERRXTRACE("startListen, bind failed, err="<<getLastError());
         return KMError::FAILED;
     }
-    if(::listen(fd_, 128) != 0) {
+    setListenOption();
+    if(::listen(fd_, backlog_) != 0) {
         closeFd(fd_);
         fd_ = INVALID_FD;
         KUMA_ERRXTRACE("startListen, socket listen fail, err="<<getLastError());
@@ -131,7 +136,7 @@ bool AcceptorBase::registerFd(SOCKET_FD fd)
 {
     auto loop = loop_.lock();
     if (loop && fd != INVALID_FD) {
-        if (loop->registerFd(fd, KUMA_EV_NETWORK, [this](KMEvent ev, void *ol, size_t sz) { ioReady(ev, ol, sz); }) == KMError::NOERR) {
+        if (loop->registerFd(fd, KUMA_EV_NETWORK, [this](KMEvent ev, void *ol, size_t sz) { ioReady(ev, ol, sz); }, this) == KMError::NOERR) {
             registered_ = true;
         }
     }
@@ -169,6 +174,66 @@ void AcceptorBase::setSocketOption()
     
     int opt_val = 1;
     setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, (char*)&opt_val, sizeof(int));
+    if (flags_ & LISTEN_FLAG_REUSEPORT) {
+#ifdef SO_REUSEPORT
+        if (setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, (char*)&opt_val, sizeof(int)) != 0) {
+            KUMA_WARNXTRACE("setSocketOption, failed to set SO_REUSEPORT, err="<<getLastError());
+        }
+#else
+        KUMA_WARNXTRACE("setSocketOption, SO_REUSEPORT is not supported");
+#endif
+    }
+}
+
+void AcceptorBase::setListenOption()
+{
+    if (defer_accept_s_ > 0) {
+#ifdef TCP_DEFER_ACCEPT
+        int opt_val = int(defer_accept_s_);
+        if (setsockopt(fd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, (char*)&opt_val, sizeof(int)) != 0) {
+            KUMA_WARNXTRACE("setListenOption, failed to set TCP_DEFER_ACCEPT, err="<<getLastError());
+        }
+#else
+        KUMA_WARNXTRACE("setListenOption, TCP_DEFER_ACCEPT is not supported");
+#endif
+    }
+    if (fastopen_qlen_ > 0) {
+#ifdef TCP_FASTOPEN
+# ifdef KUMA_OS_MAC
+        int opt_val = 1; // mac only accepts on/off
+# else
+        int opt_val = fastopen_qlen_;
+# endif
+        if (setsockopt(fd_, IPPROTO_TCP, TCP_FASTOPEN, (char*)&opt_val, sizeof(int)) != 0) {
+            KUMA_WARNXTRACE("setListenOption, failed to set TCP_FASTOPEN, err="<<getLastError());
+        }
+#else
+        KUMA_WARNXTRACE("setListenOption, TCP_FASTOPEN is not supported");
+#endif
+    }
+}
+
+KMError AcceptorBase::attachCpuSteering(uint32_t group_size)
+{
+    if (INVALID_FD == fd_ || group_size == 0) {
+        return KMError::INVALID_STATE;
+    }
+#if defined(KUMA_OS_LINUX) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    // return (current cpu % group_size) as the socket index in reuseport group
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, uint32_t(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, group_size },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog = { (unsigned short)ARRAY_SIZE(code), code };
+    if (setsockopt(fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) != 0) {
+        KUMA_ERRXTRACE("attachCpuSteering, failed, err="<<getLastError());
+        return KMError::FAILED;
+    }
+    return KMError::NOERR;
+#else
+    return KMError::UNSUPPORT;
+#endif
 }
 
 KMError AcceptorBase::close()
@@ -190,23 +255,35 @@ void AcceptorBase::onAccept()
 {
     SOCKET_FD fd = INVALID_FD;
     auto loop = loop_.lock();
+    int count = 0;
     while(!closed_ && !loop->stopped()) {
-        fd = ::accept(fd_, NULL, NULL);
+        if (++count > ACCEPT_BATCH_SIZE) {
+            if (!loop->isPollLT()) {
+                // rearm the edge triggered fd, the remaining fds will be accepted in next wakeup
+                loop->updateFd(fd_, KUMA_EV_NETWORK);
+            }
+            return ;
+        }
+        sockaddr_storage ss_addr = { 0 };
+        socklen_t ss_len = sizeof(ss_addr);
+#ifdef KUMA_OS_LINUX
+        // fd is nonblocking and close-on-exec without extra syscalls
+        fd = ::accept4(fd_, (struct sockaddr*)&ss_addr, &ss_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        fd = ::accept(fd_, (struct sockaddr*)&ss_addr, &ss_len);
+#endif
         if(INVALID_FD == fd) {
             if (EINTR == errno) {
                 continue;
             }
             return ;
         }
-        onAccept(fd);
+        onAccept(fd, (struct sockaddr*)&ss_addr, ss_len);
     }
 }
 
 void AcceptorBase::onAccept(SOCKET_FD fd)
 {
-    char peer_ip[128] = { 0 };
-    uint16_t peer_port = 0;
-
     sockaddr_storage ss_addr = { 0 };
 #if defined(KUMA_OS_LINUX) || defined(KUMA_OS_MAC)
     socklen_t ss_len = sizeof(ss_addr);
@@ -214,11 +291,19 @@ void AcceptorBase::onAccept(SOCKET_FD fd)
     int ss_len = sizeof(ss_addr);
 #endif
     int ret = getpeername(fd, (struct sockaddr*)&ss_addr, &ss_len);
-    if (ret == 0) {
-        km_get_sock_addr((struct sockaddr*)&ss_addr, sizeof(ss_addr), peer_ip, sizeof(peer_ip), &peer_port);
-    }
-    else {
+    if (ret != 0) {
         KUMA_WARNXTRACE("onAccept, getpeername failed, err=" << getLastError());
+        ss_len = 0;
+    }
+    onAccept(fd, (struct sockaddr*)&ss_addr, ss_len);
+}
+
+void AcceptorBase::onAccept(SOCKET_FD fd, const sockaddr *addr, size_t addr_len)
+{
+    char peer_ip[128] = { 0 };
+    uint16_t peer_port = 0;
+    if (addr_len > 0) {
+        km_get_sock_addr(addr, addr_len, peer_ip, sizeof(peer_ip), &peer_port);
     }
 
     KUMA_INFOXTRACE("onAccept, fd=" << fd << ", peer_ip=" << peer_ip << ", peer_port=" << peer_port);
@@ -43,6 +43,12 @@ public:
     
     void setAcceptCallback(AcceptCallback cb) { accept_cb_ = std::move(cb); }
     void setErrorCallback(ErrorCallback cb) { error_cb_ = std::move(cb); }
+    void setListenFlags(uint32_t flags) { flags_ = flags; }
+    void setBacklog(int backlog) { backlog_ = backlog; }
+    void setDeferAccept(uint32_t timeout_s) { defer_accept_s_ = timeout_s; }
+    void setFastOpen(int queue_len) { fastopen_qlen_ = queue_len; }
+    // steer connections to the socket (current CPU % group_size) of the reuseport group
+    KMError attachCpuSteering(uint32_t group_size);
     
     SOCKET_FD getFd() const { return fd_; }
     EventLoopPtr eventLoop() const { return loop_.lock(); }
@@ -53,8 +59,10 @@ protected:
 
 protected:
     void setSocketOption();
+    void setListenOption();
     virtual void onAccept();
     void onAccept(SOCKET_FD fd);
+    void onAccept(SOCKET_FD fd, const sockaddr *addr, size_t addr_len);
     void onClose(KMError err);
     void cleanup();
     virtual void ioReady(KMEvent events, void* ol, size_t io_size);
@@ -63,7 +71,10 @@ protected:
     SOCKET_FD           fd_{ INVALID_FD };
     EventLoopWeakPtr    loop_;
     bool                registered_{ false };
-    uint32_t            flags_{ 0 };
+    uint32_t            flags_{ 0 }; // LISTEN_FLAG_XXX
+    int                 backlog_{ 128 };
+    uint32_t            defer_accept_s_{ 0 };
+    int                 fastopen_qlen_{ 0 };
     bool                closed_{ false };
 #ifdef KUMA_OS_WIN
     ADDRESS_FAMILY
@@ -0,0 +1,186 @@
+/* Copyright (c) 2014, Fengping Bao <jamol@live.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "EventLoopGroupImpl.h"
+#include "EventLoopImpl.h"
+#include "util/util.h"
+#include "util/kmtrace.h"
+
+#ifndef KUMA_OS_WIN
+# include <unistd.h>
+#endif
+
+#include <future>
+#include <string>
+
+KUMA_NS_BEGIN
+
+EventLoopGroup::Impl::Impl(EventLoopGroup *group, PollType poll_type)
+: group_(group)
+, poll_type_(poll_type)
+{
+    KM_SetObjKey("EventLoopGroup");
+}
+
+EventLoopGroup::Impl::~Impl()
+{
+    stop();
+}
+
+KMError EventLoopGroup::Impl::start(size_t count, bool cpu_affinity)
+{
+    if (!loops_.empty()) {
+        return KMError::INVALID_STATE;
+    }
+    size_t cpu_count = std::thread::hardware_concurrency();
+    if (cpu_count == 0) {
+        cpu_count = 1;
+    }
+    if (count == 0) {
+        count = cpu_count;
+    }
+    KUMA_INFOXTRACE("start, count="<<count<<", cpu_affinity="<<cpu_affinity);
+    
+    std::vector<std::future<bool>> inits;
+    for (size_t i = 0; i < count; ++i) {
+        loops_.emplace_back(new EventLoop(poll_type_));
+        auto *loop = loops_.back().get();
+        auto init_promise = std::make_shared<std::promise<bool>>();
+        inits.emplace_back(init_promise->get_future());
+        int cpu = cpu_affinity ? int(i % cpu_count) : -1;
+        threads_.emplace_back([loop, cpu, init_promise, this] {
+            if (cpu >= 0 && !set_thread_affinity(cpu)) {
+                KUMA_WARNXTRACE("start, failed to set thread affinity, cpu="<<cpu);
+            }
+            if (!loop->init()) {
+                init_promise->set_value(false);
+                return;
+            }
+            init_promise->set_value(true);
+            loop->loop();
+        });
+    }
+    bool ok = true;
+    for (auto &f : inits) {
+        ok = f.get() && ok;
+    }
+    if (!ok) {
+        KUMA_ERRXTRACE("start, failed to init EventLoop");
+        stop();
+        return KMError::FAILED;
+    }
+    return KMError::NOERR;
+}
+
+void EventLoopGroup::Impl::stop()
+{
+    for (auto &loop : loops_) {
+        loop->stop();
+    }
+    for (auto &t : threads_) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threads_.clear();
+    loops_.clear();
+}
+
+KMError EventLoopGroup::Impl::setSelectCallback(SelectCallback cb)
+{
+    if (!loops_.empty()) {
+        return KMError::INVALID_STATE;
+    }
+    select_cb_ = std::move(cb);
+    return KMError::NOERR;
+}
+
+template<typename Func>
+size_t EventLoopGroup::Impl::selectLeast(Func &&func)
+{
+    // start from next_loop_ so that the loops with same load are selected in turn
+    auto start = next_loop_.fetch_add(1, std::memory_order_relaxed);
+    size_t index = 0;
+    size_t least = size_t(-1);
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        auto idx = (start + i) % loops_.size();
+        auto val = func(loops_[idx]->pimpl());
+        if (val < least) {
+            least = val;
+            index = idx;
+        }
+    }
+    return index;
+}
+
+EventLoop* EventLoopGroup::Impl::selectLoop()
+{
+    if (loops_.empty()) {
+        return nullptr;
+    }
+    if (select_cb_) {
+        return getLoop(select_cb_(group_));
+    }
+    size_t index = 0;
+    switch (policy_.load(std::memory_order_relaxed)) {
+        case Policy::LEAST_CONNECTIONS:
+            index = selectLeast([] (EventLoop::Impl *loop) { return loop->getConnectionCount(); });
+            break;
+        case Policy::LEAST_PENDING_TASKS:
+            index = selectLeast([] (EventLoop::Impl *loop) { return loop->getPendingTaskCount(); });
+            break;
+        default:
+            index = next_loop_.fetch_add(1, std::memory_order_relaxed) % loops_.size();
+            break;
+    }
+    return loops_[index].get();
+}
+
+size_t EventLoopGroup::Impl::getConnectionCount(size_t index) const
+{
+    return index < loops_.size() ? loops_[index]->pimpl()->getConnectionCount() : 0;
+}
+
+size_t EventLoopGroup::Impl::getPendingTaskCount(size_t index) const
+{
+    return index < loops_.size() ? loops_[index]->pimpl()->getPendingTaskCount() : 0;
+}
+
+bool EventLoopGroup::Impl::dispatchFd(SOCKET_FD fd, const char* ip, uint16_t port, const std::shared_ptr<LoopAcceptCallback> &cb)
+{
+    auto *loop = selectLoop();
+    if (!loop) {
+        return false;
+    }
+    std::string peer_ip(ip ? ip : "");
+    auto ret = loop->post([loop, fd, peer_ip, port, cb] {
+        if (!(*cb)(loop, fd, peer_ip.c_str(), port)) {
+            closeFd(fd);
+        }
+    });
+    if (ret != KMError::NOERR) {
+        KUMA_WARNXTRACE("dispatchFd, failed to post to loop, fd="<<fd<<", err="<<int(ret));
+        return false;
+    }
+    return true;
+}
+
+KUMA_NS_END
@@ -0,0 +1,83 @@
+/* Copyright (c) 2014, Fengping Bao <jamol@live.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __EventLoopGroupImpl_H__
+#define __EventLoopGroupImpl_H__
+
+#include "kmapi.h"
+#include "evdefs.h"
+#include "util/kmobject.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+KUMA_NS_BEGIN
+
+class EventLoopGroup::Impl final : public KMObject
+{
+public:
+    using Policy = EventLoopGroup::Policy;
+    using SelectCallback = EventLoopGroup::SelectCallback;
+    using LoopAcceptCallback = TcpListener::LoopAcceptCallback;
+    
+    Impl(EventLoopGroup *group, PollType poll_type);
+    ~Impl();
+    
+    KMError start(size_t count, bool cpu_affinity);
+    void stop();
+    
+    size_t size() const { return loops_.size(); }
+    EventLoop* getLoop(size_t index) { return index < loops_.size() ? loops_[index].get() : nullptr; }
+    
+    EventLoop* selectLoop();
+    void setPolicy(Policy policy) { policy_ = policy; }
+    KMError setSelectCallback(SelectCallback cb);
+    
+    size_t getConnectionCount(size_t index) const;
+    size_t getPendingTaskCount(size_t index) const;
+    
+    /* hand the accepted fd to selected loop, cb will be called in that loop thread
+     * return false if no loop is available, the caller should close the fd
+     */
+    bool dispatchFd(SOCKET_FD fd, const char* ip, uint16_t port, const std::shared_ptr<LoopAcceptCallback> &cb);
+    
+protected:
+    template<typename Func> // (EventLoop::Impl*) -> size_t
+    size_t selectLeast(Func &&func);
+    
+protected:
+    using EventLoopList = std::vector<std::unique_ptr<EventLoop>>;
+    
+    EventLoopGroup*             group_;
+    PollType                    poll_type_;
+    EventLoopList               loops_;
+    std::vector<std::thread>    threads_;
+    
+    std::atomic<Policy>         policy_{ Policy::ROUND_ROBIN };
+    SelectCallback              select_cb_;
+    std::atomic<size_t>         next_loop_{ 0 };
+};
+
+KUMA_NS_END
+
+#endif
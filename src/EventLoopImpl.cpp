@@ -25,20 +25,155 @@
 #include "util/kmtrace.h"
 #include <thread>
 #include <condition_variable>
+#include <vector>
 
 KUMA_NS_BEGIN
 
 IOPoll* createIOPoll(PollType poll_type);
 
+namespace {
+// bucket 0 is for 0, bucket i is for [2^(i-1), 2^i)
+int stats_bucket(uint64_t value)
+{
+    int idx = 0;
+    while (value && idx < EventLoop::Stats::HISTOGRAM_BUCKETS - 1) {
+        value >>= 1;
+        ++idx;
+    }
+    return idx;
+}
+
+// times the I/O callbacks of the fds registered through loop
+class LoopIOObserver final : public IOObserver
+{
+public:
+    explicit LoopIOObserver(EventLoop::Impl *loop) : loop_(loop) {}
+    
+    uint64_t onCallbackBegin(long obj_id) override
+    {
+        auto start_us = get_tick_count_us();
+        loop_->beginCallback(EventLoop::Impl::CallbackKind::IO, start_us, obj_id);
+        return start_us;
+    }
+    
+    void onCallbackEnd(uint64_t start_us) override
+    {
+        loop_->endCallback();
+        loop_->onIOCallback(get_tick_count_us() - start_us);
+    }
+    
+private:
+    EventLoop::Impl* loop_;
+};
+
+const char* callback_kind_name(EventLoop::Impl::CallbackKind kind)
+{
+    switch (kind) {
+        case EventLoop::Impl::CallbackKind::IO:
+            return "I/O";
+        case EventLoop::Impl::CallbackKind::TASK:
+            return "task";
+        case EventLoop::Impl::CallbackKind::TIMER:
+            return "timer";
+    }
+    return "unknown";
+}
+
+/**
+ * LoopWatchdog is the thread shared by the loops that enabled watchdog, it checks
+ * the loops at half of the smallest threshold. the thread exits when no loop is watched
+ */
+class LoopWatchdog
+{
+public:
+    static LoopWatchdog& instance()
+    {
+        // never destroyed, the loops may be destroyed in static destruction
+        static LoopWatchdog *watchdog = new LoopWatchdog();
+        return *watchdog;
+    }
+    
+    void add(EventLoop::Impl *loop)
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        for (auto &w : loops_) {
+            if (w.loop == loop) {
+                cv_.notify_one(); // threshold changed
+                return;
+            }
+        }
+        loops_.push_back({loop, 0});
+        if (!running_) {
+            if (thread_.joinable()) {
+                thread_.join(); // it has exited the check loop
+            }
+            running_ = true;
+            thread_ = std::thread([this] { run(); });
+        }
+        cv_.notify_one();
+    }
+    
+    void remove(EventLoop::Impl *loop)
+    {
+        std::lock_guard<std::mutex> g(mutex_);
+        for (auto it = loops_.begin(); it != loops_.end(); ++it) {
+            if (it->loop == loop) {
+                loops_.erase(it);
+                cv_.notify_one();
+                break;
+            }
+        }
+    }
+    
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        while (!loops_.empty()) {
+            uint32_t interval_ms = -1;
+            auto now_us = get_tick_count_us();
+            for (auto &w : loops_) {
+                w.loop->checkSlowCallback(now_us, w.reported_seq);
+                auto threshold_ms = w.loop->getWatchdogThreshold();
+                if (threshold_ms && threshold_ms / 2 < interval_ms) {
+                    interval_ms = threshold_ms / 2;
+                }
+            }
+            if (interval_ms == 0) {
+                interval_ms = 1;
+            }
+            cv_.wait_for(lk, std::chrono::milliseconds(interval_ms));
+        }
+        running_ = false;
+    }
+    
+    struct WatchedLoop
+    {
+        EventLoop::Impl* loop;
+        uint64_t reported_seq;
+    };
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<WatchedLoop> loops_;
+    std::thread thread_;
+    bool running_ = false;
+};
+}
+
 EventLoop::Impl::Impl(PollType poll_type)
 : poll_(createIOPoll(poll_type))
+, io_observer_(new LoopIOObserver(this))
 , timer_mgr_(new TimerManager(this))
 {
     KM_SetObjKey("EventLoop");
+    poll_->setObserver(io_observer_.get());
 }
 
 EventLoop::Impl::~Impl()
 {
+    if (watchdog_ms_) {
+        LoopWatchdog::instance().remove(this);
+    }
     while (pending_objects_) {
         auto obj = pending_objects_;
         pending_objects_ = pending_objects_->next_;
@@ -48,6 +183,11 @@ EventLoop::Impl::~Impl()
     while (obs_queue_.dequeue(cb)) {
         cb(LoopActivity::EXIT);
     }
+    for (auto &tq : task_queues_) {
+        while (auto *slot = tq.queue.dequeue()) {
+            releaseTask(slot);
+        }
+    }
     if(poll_) {
         delete poll_;
         poll_ = nullptr;
@@ -72,6 +212,22 @@ PollType EventLoop::Impl::getPollType() const
     return PollType::NONE;
 }
 
+KMError EventLoop::Impl::setPollBatchSize(uint32_t max_events)
+{
+    return poll_->setMaxEvents(max_events);
+}
+
+KMError EventLoop::Impl::enablePollDirectItem()
+{
+    return poll_->enableDirectItem();
+}
+
+void EventLoop::Impl::setBusyPoll(uint32_t spin_us, bool sock_busy_poll)
+{
+    spin_us_ = spin_us;
+    sock_busy_poll_ = sock_busy_poll && spin_us > 0;
+}
+
 bool EventLoop::Impl::isPollLT() const
 {
     if(poll_) {
@@ -80,16 +236,32 @@ bool EventLoop::Impl::isPollLT() const
     return false;
 }
 
-KMError EventLoop::Impl::registerFd(SOCKET_FD fd, uint32_t events, IOCallback cb)
+KMError EventLoop::Impl::registerFd(SOCKET_FD fd, uint32_t events, IOCallback cb, const KMObject *obj)
 {
+#ifdef SO_BUSY_POLL
+    if (sock_busy_poll_) {
+        int busy_poll_us = int(spin_us_);
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) != 0 &&
+            errno != ENOTSOCK) {
+            KUMA_WARNXTRACE("registerFd, failed to set SO_BUSY_POLL, fd="<<fd<<", errno="<<errno);
+        }
+    }
+#endif
+    // the callbacks are timed by io_observer_ in dispatch
+    long obj_id = obj ? obj->getObjId() : 0;
     if(inSameThread()) {
-        return poll_->registerFd(fd, events, std::move(cb));
+        auto ret = poll_->registerFd(fd, events, std::move(cb));
+        if(ret == KMError::NOERR) {
+            poll_->observeFd(fd, obj_id);
+        }
+        return ret;
     }
     return async([=] () mutable {
         auto ret = poll_->registerFd(fd, events, cb);
         if(ret != KMError::NOERR) {
             return ;
         }
+        poll_->observeFd(fd, obj_id);
     });
 }
 
@@ -186,40 +358,310 @@ void EventLoop::Impl::removePendingObject(PendingObject *obj)
     }
 }
 
+void EventLoop::Impl::appendFlushObject(FlushObject *obj)
+{
+    KUMA_ASSERT(inSameThread());
+    if (obj->flush_queued_) {
+        return;
+    }
+    obj->flush_queued_ = true;
+    obj->flush_prev_ = nullptr;
+    obj->flush_next_ = flush_objects_;
+    if (flush_objects_) {
+        flush_objects_->flush_prev_ = obj;
+    }
+    flush_objects_ = obj;
+}
+
+void EventLoop::Impl::removeFlushObject(FlushObject *obj)
+{
+    KUMA_ASSERT(inSameThread());
+    if (!obj->flush_queued_) {
+        return;
+    }
+    if (flush_objects_ == obj) {
+        flush_objects_ = obj->flush_next_;
+    }
+    if (obj->flush_prev_) {
+        obj->flush_prev_->flush_next_ = obj->flush_next_;
+    }
+    if (obj->flush_next_) {
+        obj->flush_next_->flush_prev_ = obj->flush_prev_;
+    }
+    obj->flush_prev_ = obj->flush_next_ = nullptr;
+    obj->flush_queued_ = false;
+}
+
+void EventLoop::Impl::flushObjects()
+{
+    // the object is removed before flushing, the flush may remove or destroy other objects
+    while (flush_objects_) {
+        auto obj = flush_objects_;
+        removeFlushObject(obj);
+        obj->onLoopFlush();
+    }
+}
+
+size_t EventLoop::Impl::getPendingTaskCount() const
+{
+    size_t count = 0;
+    for (auto &tq : task_queues_) {
+        count += tq.count.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
 void EventLoop::Impl::processTasks()
 {
-    TaskQueue tq;
-    std::unique_lock<LockType> ul(task_mutex_);
-    task_queue_.swap(tq);
-    
-    while (auto node = tq.front_node()) {
-        tq.pop_front();
-        auto &task_slot = node->element();
-        task_slot.state = TaskSlot::State::RUNNING;
-        ul.unlock();
-        {// execute the task
+    stats_.max_pending_tasks.max(getPendingTaskCount());
+    auto start_us = get_tick_count_us();
+    runTasks(getTaskQueue(TaskPriority::URGENT), start_us, 0);
+    runTasks(getTaskQueue(TaskPriority::NORMAL), start_us, task_budget_ms_);
+}
+
+bool EventLoop::Impl::runTasks(PriorityTaskQueue &tq, uint64_t start_us, uint32_t budget_ms)
+{
+    // only run the tasks queued before, the tasks posted by running task
+    // will be run in next loop
+    auto count = tq.count.load(std::memory_order_acquire);
+    if (count == 0) {
+        return true;
+    }
+    // the tick count read for the task time is used to check the budget as well
+    auto now_us = get_tick_count_us();
+    while (count-- > 0) {
+        if (budget_ms && now_us - start_us >= uint64_t(budget_ms) * 1000) {
+            return false;
+        }
+        auto *slot = tq.queue.dequeue();
+        if (!slot) {
+            break; // producer is in progress, it will notify the loop
+        }
+        tq.count.fetch_sub(1, std::memory_order_relaxed);
+        auto task_start_us = now_us;
+        beginCallback(CallbackKind::TASK, task_start_us);
+        runTask(slot);
+        endCallback();
+        now_us = get_tick_count_us();
+        auto elapsed_us = now_us - task_start_us;
+        stats_.tasks_executed.add(1);
+        stats_.task_us.add(elapsed_us);
+        onCallback(elapsed_us);
+    }
+    return true;
+}
+
+void EventLoop::Impl::runTask(TaskSlot *slot)
+{
+    auto state = TaskSlot::State::ACTIVE;
+    if (slot->state.compare_exchange_strong(state, TaskSlot::State::RUNNING)) {
+        if (slot->cancelable) {
             LockGuard g(task_run_mutex_);
-            if (task_slot.state != TaskSlot::State::INACTIVE) {
-                task_slot();
-                task_slot.state = TaskSlot::State::INACTIVE;
+            if (slot->state.load() == TaskSlot::State::RUNNING) {
+                (*slot)();
             }
+        } else {
+            (*slot)();
         }
-        ul.lock();
-        if (task_slot.token) {
-            task_slot.token->removeTaskNode(node);
+        slot->state = TaskSlot::State::INACTIVE;
+    }
+    if (slot->cancelable) {
+        LockGuard g(task_mutex_);
+        if (slot->token) {
+            slot->token->removeTaskNode(slot);
         }
     }
+    releaseTask(slot);
 }
 
-void EventLoop::Impl::loopOnce(uint32_t max_wait_ms)
+void EventLoop::Impl::releaseTask(TaskSlot *slot)
+{
+    slot->task = nullptr;
+    slot->token = nullptr;
+    slot->cancelable = false;
+    task_pool_.release(slot);
+}
+
+unsigned long EventLoop::Impl::checkTimers(uint32_t max_wait_ms)
 {
-    processTasks();
     unsigned long wait_ms = max_wait_ms;
+    auto watched = watchdog_ms_.load(std::memory_order_relaxed) > 0;
+    if (watched) {
+        beginCallback(CallbackKind::TIMER, get_tick_count_us());
+    }
     timer_mgr_->checkExpire(&wait_ms);
+    if (watched) {
+        endCallback();
+    }
     if(wait_ms > max_wait_ms) {
         wait_ms = max_wait_ms;
     }
-    poll_->wait((uint32_t)wait_ms);
+    return wait_ms;
+}
+
+void EventLoop::Impl::loopOnce(uint32_t max_wait_ms)
+{
+    stats_.iterations.add(1);
+    processTasks();
+    auto wait_ms = checkTimers(max_wait_ms);
+    if (hasTasks(TaskPriority::URGENT) || hasTasks(TaskPriority::NORMAL)) {
+        wait_ms = 0; // tasks are deferred by time budget
+    } else if (wait_ms > 0 && hasTasks(TaskPriority::IDLE)) {
+        // the loop would block in poll, it is time to run idle tasks
+        runTasks(getTaskQueue(TaskPriority::IDLE), get_tick_count_us(), task_budget_ms_);
+        if (hasTasks(TaskPriority::IDLE)) {
+            wait_ms = 0;
+        } else {
+            // the timers expired while running idle tasks or scheduled by them are checked,
+            // the timers scheduled in loop thread don't wake up the poll
+            wait_ms = checkTimers(max_wait_ms);
+        }
+    }
+    // the data written by tasks and timers are sent before waiting
+    flushObjects();
+    // busy poll for a while before sleeping, it returns once any event or task arrives
+    if (wait_ms > 0 && spin_us_ > 0 && spinPoll(wait_ms)) {
+        spin_hits_.fetch_add(1, std::memory_order_relaxed);
+        wakeup_state_.store(0, std::memory_order_release);
+        flushObjects();
+        return;
+    }
+    // the tasks or timers appended after processTasks or checkExpire have set
+    // WAKEUP_PENDING without notifying the poll, don't sleep on them
+    auto state = wakeup_state_.exchange(WAKEUP_SLEEPING, std::memory_order_acq_rel);
+    if (state & WAKEUP_PENDING) {
+        wait_ms = 0;
+    }
+    if (wait_ms > 0) {
+        blocking_waits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    pollWait((uint32_t)wait_ms);
+    wakeup_state_.store(0, std::memory_order_release);
+    flushObjects();
+}
+
+void EventLoop::Impl::pollWait(uint32_t wait_ms)
+{
+    io_callback_us_ = 0;
+    auto start_us = get_tick_count_us();
+    poll_->wait(wait_ms);
+    auto elapsed_us = get_tick_count_us() - start_us;
+    stats_.wait_us.add(elapsed_us > io_callback_us_ ? elapsed_us - io_callback_us_ : 0);
+    auto events = poll_->lastEventCount();
+    stats_.io_events.add(events);
+    stats_.events_per_wait[stats_bucket(events)].add(1);
+}
+
+KMError EventLoop::Impl::setWatchdog(uint32_t threshold_ms)
+{
+    auto old_ms = watchdog_ms_.exchange(threshold_ms);
+    if (threshold_ms) {
+        LoopWatchdog::instance().add(this);
+    } else if (old_ms) {
+        LoopWatchdog::instance().remove(this);
+    }
+    return KMError::NOERR;
+}
+
+void EventLoop::Impl::beginCallback(CallbackKind kind, uint64_t start_us, long obj_id)
+{
+    cb_obj_id_.store(obj_id, std::memory_order_relaxed);
+    cb_seq_.store(cb_seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    cb_kind_.store(kind, std::memory_order_relaxed);
+    cb_start_us_.store(start_us, std::memory_order_release);
+}
+
+void EventLoop::Impl::checkSlowCallback(uint64_t now_us, uint64_t &reported_seq)
+{
+    uint64_t threshold_us = uint64_t(watchdog_ms_.load(std::memory_order_relaxed)) * 1000;
+    auto start_us = cb_start_us_.load(std::memory_order_acquire);
+    auto seq = cb_seq_.load(std::memory_order_relaxed);
+    auto kind = cb_kind_.load(std::memory_order_relaxed);
+    if (!threshold_us || !start_us || seq == reported_seq ||
+        now_us < start_us || now_us - start_us < threshold_us) {
+        return;
+    }
+    auto obj_id = cb_obj_id_.load(std::memory_order_relaxed);
+    if (cb_start_us_.load(std::memory_order_acquire) != start_us ||
+        cb_seq_.load(std::memory_order_relaxed) != seq) {
+        return; // the callback is completed
+    }
+    reported_seq = seq;
+    // obj_id is 0 if the callback is not I/O or the owner of fd is unknown
+    KUMA_WARNXTRACE("slow " << callback_kind_name(kind) << " callback, obj_id=" << obj_id
+                    << ", elapsed=" << (now_us - start_us) / 1000 << "ms");
+}
+
+void EventLoop::Impl::onIOCallback(uint64_t elapsed_us)
+{
+    io_callback_us_ += elapsed_us;
+    onCallback(elapsed_us);
+}
+
+void EventLoop::Impl::onCallback(uint64_t elapsed_us)
+{
+    stats_.callback_us[stats_bucket(elapsed_us)].add(1);
+    stats_.max_callback_us.max(elapsed_us);
+}
+
+KMBuffer EventLoop::Impl::acquireRecvBuffer()
+{
+    KMBuffer buf(KMBuffer::StorageType::AUTO);
+    if (recv_buffer_.capacity() > 0) {
+        buf = std::move(recv_buffer_);
+        buf.rewind();
+    } else {
+        // the block and its header fit in the biggest size class of KMBufferPool, the
+        // blocks kept by handlers are freed to the pool and replaced from it
+        buf.allocBuffer(KMBufferPool::MAX_CLASS_SIZE);
+    }
+    return buf;
+}
+
+void EventLoop::Impl::releaseRecvBuffer(KMBuffer &&buf)
+{
+    if (!buf.isShared() && buf.capacity() > 0) {
+        recv_buffer_ = std::move(buf);
+    }
+}
+
+EventLoop::Stats EventLoop::Impl::getStats() const
+{
+    EventLoop::Stats stats;
+    stats.iterations = stats_.iterations.get();
+    stats.wait_us = stats_.wait_us.get();
+    stats.task_us = stats_.task_us.get();
+    stats.tasks_executed = stats_.tasks_executed.get();
+    stats.max_pending_tasks = stats_.max_pending_tasks.get();
+    stats.timers_fired = timer_mgr_->getFiredCount();
+    stats.io_events = stats_.io_events.get();
+    stats.max_callback_us = stats_.max_callback_us.get();
+    stats.notifies = getNotifyCount();
+    stats.notifies_suppressed = getSuppressedNotifyCount();
+    for (int i = 0; i < EventLoop::Stats::HISTOGRAM_BUCKETS; ++i) {
+        stats.events_per_wait[i] = stats_.events_per_wait[i].get();
+        stats.callback_us[i] = stats_.callback_us[i].get();
+    }
+    return stats;
+}
+
+bool EventLoop::Impl::spinPoll(unsigned long wait_ms)
+{
+    // the loop is awake while spinning, the tasks appended only set WAKEUP_PENDING
+    uint64_t spin_us = spin_us_;
+    if (spin_us > uint64_t(wait_ms) * 1000) {
+        spin_us = wait_ms * 1000; // don't delay the timers
+    }
+    auto start_us = get_tick_count_us();
+    do {
+        pollWait(0);
+        if (poll_->lastEventCount() > 0 ||
+            (wakeup_state_.load(std::memory_order_acquire) & WAKEUP_PENDING) ||
+            stop_loop_) {
+            return true;
+        }
+    } while (get_tick_count_us() - start_us < spin_us);
+    return false;
 }
 
 void EventLoop::Impl::loop(uint32_t max_wait_ms)
@@ -227,7 +669,15 @@ void EventLoop::Impl::loop(uint32_t max_wait_ms)
     while (!stop_loop_) {
         loopOnce(max_wait_ms);
     }
-    processTasks();
+    // the producers that passed the stop check are enqueueing, the tasks appended
+    // after them are rejected
+    while (task_producers_.load() > 0) {
+        std::this_thread::yield();
+    }
+    for (auto &tq : task_queues_) {
+        runTasks(tq, 0, 0); // run all the remaining tasks
+    }
+    flushObjects();
     
     while (pending_objects_) {
         auto obj = pending_objects_;
@@ -241,35 +691,144 @@ void EventLoop::Impl::loop(uint32_t max_wait_ms)
             cb(LoopActivity::EXIT);
         }
     }
-    KUMA_INFOXTRACE("loop, stopped");
+    KUMA_INFOXTRACE("loop, stopped, notify="<<getNotifyCount()<<", suppressed="<<getSuppressedNotifyCount());
 }
 
 void EventLoop::Impl::notify()
 {
-    poll_->notify();
+    // only the first notification while the loop is sleeping goes to IOPoll,
+    // loop will check WAKEUP_PENDING before next wait if it is awake
+    auto state = wakeup_state_.fetch_or(WAKEUP_PENDING, std::memory_order_acq_rel);
+    if (state == WAKEUP_SLEEPING) {
+        notify_count_.fetch_add(1, std::memory_order_relaxed);
+        poll_->notify();
+    } else {
+        notify_suppressed_.fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
 void EventLoop::Impl::stop()
 {
     KUMA_INFOXTRACE("stop");
     stop_loop_ = true;
-    poll_->notify();
+    notify();
+}
+
+bool EventLoop::Impl::enterAppend()
+{
+    // pairs with the loop that sees stop_loop_ and then waits for task_producers_
+    task_producers_.fetch_add(1);
+    if (stop_loop_.load()) {
+        leaveAppend();
+        return false;
+    }
+    return true;
+}
+
+KMError EventLoop::Impl::appendTask(Task task, EventLoopToken *token, TaskPriority priority)
+{
+    if (!enterAppend()) {
+        return KMError::INVALID_STATE;
+    }
+    TaskSlot *slot = nullptr;
+    auto ret = prepareTask(std::move(task), token, slot);
+    if (ret == KMError::NOERR) {
+        enqueueTask(slot, priority);
+    }
+    leaveAppend();
+    return ret;
 }
 
-KMError EventLoop::Impl::appendTask(Task task, EventLoopToken *token)
+KMError EventLoop::Impl::prepareTask(Task task, EventLoopToken *token, TaskSlot* &slot)
 {
     if (token && token->eventLoop().get() != this) {
         return KMError::INVALID_PARAM;
     }
-    auto node = std::make_shared<TaskQueue::DLNode>(std::move(task), token);
-    LockGuard g(task_mutex_);
     if (stop_loop_) {
         return KMError::INVALID_STATE;
     }
-    task_queue_.enqueue(node);
+    slot = task_pool_.acquire();
+    slot->task = std::move(task);
+    slot->state = TaskSlot::State::ACTIVE;
+    if (token) {
+        slot->cancelable = true;
+        LockGuard g(task_mutex_);
+        token->appendTaskNode(slot);
+    }
+    return KMError::NOERR;
+}
+
+void EventLoop::Impl::enqueueTask(TaskSlot *slot, TaskPriority priority)
+{
+    auto &tq = getTaskQueue(priority);
+    tq.count.fetch_add(1, std::memory_order_release);
+    tq.queue.enqueue(slot);
+}
+
+void EventLoop::Impl::dropTask(TaskSlot *slot)
+{
+    slot->state = TaskSlot::State::INACTIVE;
+    if (slot->cancelable) {
+        LockGuard g(task_mutex_);
+        if (slot->token) {
+            slot->token->removeTaskNode(slot);
+        }
+    }
+    releaseTask(slot);
+}
+
+void EventLoop::Impl::postPreparedTask(TaskSlot *slot, bool cancel)
+{
+    if (!enterAppend()) {
+        dropTask(slot);
+        return;
+    }
+    if (cancel) {
+        // it is released by loop without running
+        slot->state = TaskSlot::State::INACTIVE;
+    }
+    enqueueTask(slot, TaskPriority::NORMAL);
+    leaveAppend();
+    notify();
+}
+
+KMError EventLoop::Impl::appendTasks(Task *tasks, size_t count, EventLoopToken *token, TaskPriority priority)
+{
+    if (token && token->eventLoop().get() != this) {
+        return KMError::INVALID_PARAM;
+    }
+    if (!tasks || count == 0) {
+        return stop_loop_ ? KMError::INVALID_STATE : KMError::NOERR;
+    }
+    if (!enterAppend()) {
+        return KMError::INVALID_STATE;
+    }
+    // link the slots locally and enqueue them with one exchange
+    TaskSlot *first = nullptr;
+    TaskSlot *last = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        auto *slot = task_pool_.acquire();
+        slot->task = std::move(tasks[i]);
+        slot->state = TaskSlot::State::ACTIVE;
+        slot->cancelable = token != nullptr;
+        slot->mpsc_next_.store(nullptr, std::memory_order_relaxed);
+        if (last) {
+            last->mpsc_next_.store(slot, std::memory_order_relaxed);
+        } else {
+            first = slot;
+        }
+        last = slot;
+    }
     if (token) {
-        token->appendTaskNode(node);
+        LockGuard g(task_mutex_);
+        for (auto *slot = first; slot; slot = slot->mpsc_next_.load(std::memory_order_relaxed)) {
+            token->appendTaskNode(slot);
+        }
     }
+    auto &tq = getTaskQueue(priority);
+    tq.count.fetch_add(count, std::memory_order_release);
+    tq.queue.enqueue(first, last);
+    leaveAppend();
     return KMError::NOERR;
 }
 
@@ -281,15 +840,18 @@ KMError EventLoop::Impl::removeTask(EventLoopToken *token)
     bool is_running = false;
     {
         LockGuard g(task_mutex_);
-        for (auto &node : token->task_nodes_) {
-            auto &task_slot = node->element();
-            if (task_slot.state == TaskSlot::State::RUNNING) {
+        auto *slot = token->task_nodes_;
+        while (slot) {
+            auto *next = slot->token_next_;
+            // the slot is still in task queue, it will be released after dequeued
+            if (slot->state.exchange(TaskSlot::State::INACTIVE) == TaskSlot::State::RUNNING) {
                 is_running = true;
-                task_slot.state = TaskSlot::State::INACTIVE;
             }
-            task_queue_.remove(node);
+            slot->token = nullptr;
+            slot->token_prev_ = slot->token_next_ = nullptr;
+            slot = next;
         }
-        token->task_nodes_.clear();
+        token->task_nodes_ = nullptr;
     }
     if (is_running && !inSameThread()) {
         // wait for end of running
@@ -334,13 +896,23 @@ KMError EventLoop::Impl::async(Task task, EventLoopToken *token)
     }
 }
 
-KMError EventLoop::Impl::post(Task task, EventLoopToken *token)
+KMError EventLoop::Impl::post(Task task, EventLoopToken *token, TaskPriority priority)
 {
-    auto ret = appendTask(std::move(task), token);
+    auto ret = appendTask(std::move(task), token, priority);
     if (ret != KMError::NOERR) {
         return ret;
     }
-    poll_->notify();
+    notify();
+    return KMError::NOERR;
+}
+
+KMError EventLoop::Impl::postBatch(Task *tasks, size_t count, EventLoopToken *token, TaskPriority priority)
+{
+    auto ret = appendTasks(tasks, count, token, priority);
+    if (ret != KMError::NOERR || count == 0) {
+        return ret;
+    }
+    notify();
     return KMError::NOERR;
 }
 
@@ -366,19 +938,29 @@ EventLoopPtr EventLoopToken::eventLoop()
     return loop_.lock();
 }
 
-void EventLoopToken::appendTaskNode(TaskNodePtr &node)
+void EventLoopToken::appendTaskNode(TaskSlot *slot)
 {
-    task_nodes_.emplace_back(node);
+    slot->token = this;
+    slot->token_prev_ = nullptr;
+    slot->token_next_ = task_nodes_;
+    if (task_nodes_) {
+        task_nodes_->token_prev_ = slot;
+    }
+    task_nodes_ = slot;
 }
 
-void EventLoopToken::removeTaskNode(TaskNodePtr &node)
+void EventLoopToken::removeTaskNode(TaskSlot *slot)
 {
-    for (auto it = task_nodes_.begin(); it != task_nodes_.end(); ++it) {
-        if (*it == node) {
-            task_nodes_.erase(it);
-            break;
-        }
+    if (slot->token_prev_) {
+        slot->token_prev_->token_next_ = slot->token_next_;
+    } else if (task_nodes_ == slot) {
+        task_nodes_ = slot->token_next_;
     }
+    if (slot->token_next_) {
+        slot->token_next_->token_prev_ = slot->token_prev_;
+    }
+    slot->token = nullptr;
+    slot->token_prev_ = slot->token_next_ = nullptr;
 }
 
 bool EventLoopToken::expired()
@@ -390,7 +972,7 @@ void EventLoopToken::reset()
 {
     auto loop = loop_.lock();
     if (loop) {
-        if (!task_nodes_.empty()) {
+        if (task_nodes_) {
             loop->removeTask(this);
         }
         if (!obs_token_.expired()) {
@@ -399,7 +981,7 @@ void EventLoopToken::reset()
         }
         loop_.reset();
     } else {
-        task_nodes_.clear();
+        task_nodes_ = nullptr;
     }
 }
 
@@ -410,6 +992,7 @@ IOPoll* createVPoll();
 IOPoll* createKQueue();
 IOPoll* createSelectPoll();
 IOPoll* createIocpPoll();
+IOPoll* createUringPoll();
 
 #ifdef KUMA_OS_WIN
 # include <MSWSock.h>
@@ -459,6 +1042,16 @@ IOPoll* createIOPoll(PollType poll_type)
             return createIocpPoll();
 #else
             return createDefaultIOPoll();
+#endif
+        case PollType::IO_URING:
+#ifdef KUMA_OS_LINUX
+        {
+            // fall back to default poll if io_uring is not supported by kernel
+            auto *poll = createUringPoll();
+            return poll ? poll : createDefaultIOPoll();
+        }
+#else
+            return createDefaultIOPoll();
 #endif
         default:
             return createDefaultIOPoll();
@@ -33,11 +33,12 @@
 #endif
 #include <stdint.h>
 #include <thread>
-#include <list>
+#include <atomic>
 
 KUMA_NS_BEGIN
 
 class IOPoll;
+class IOObserver;
 class EventLoopToken;
 
 class TaskSlot
@@ -49,8 +50,6 @@ public:
         RUNNING,
         INACTIVE,
     };
-    TaskSlot(EventLoop::Task &&t, EventLoopToken *token)
-    : task(std::move(t)), token(token) {}
     void operator() ()
     {
         if (task) {
@@ -58,11 +57,19 @@ public:
         }
     }
     EventLoop::Task task;
-    State state = State::ACTIVE;
-    EventLoopToken* token;
+    std::atomic<State> state{ State::ACTIVE };
+    EventLoopToken* token = nullptr; // protected by EventLoop task_mutex_
+    bool cancelable = false; // token was set when it is queued
+    
+    // intrusive links
+    std::atomic<TaskSlot*> mpsc_next_{ nullptr };
+    TaskSlot* token_prev_ = nullptr;
+    TaskSlot* token_next_ = nullptr;
+    uint32_t pool_index_ = 0;
+    std::atomic<uint32_t> pool_next_{ 0 };
 };
-using TaskQueue = DLQueue<TaskSlot>;
-using TaskNodePtr = TaskQueue::NodePtr;
+using TaskQueue = MPSCQueue<TaskSlot>;
+using TaskPool = NodePool<TaskSlot>;
 
 enum class LoopActivity {
     EXIT,
@@ -87,6 +94,23 @@ public:
     PendingObject* prev_ = nullptr;
 };
 
+/**
+ * FlushObject is flushed once before the loop waits for I/O, and once after the I/O
+ * events are dispatched, e.g. the corked TcpSocket writes out the data sent in the
+ * iteration by one send call
+ */
+class FlushObject
+{
+public:
+    virtual ~FlushObject() {}
+    virtual void onLoopFlush() = 0;
+
+public:
+    FlushObject* flush_next_ = nullptr;
+    FlushObject* flush_prev_ = nullptr;
+    bool flush_queued_ = false;
+};
+
 class EventLoop::Impl final : public KMObject
 {
 public:
@@ -95,13 +119,16 @@ public:
 
 public:
     bool init();
-    KMError registerFd(SOCKET_FD fd, uint32_t events, IOCallback cb);
+    // obj is the owner of fd, its id is reported by watchdog if the callback is slow
+    KMError registerFd(SOCKET_FD fd, uint32_t events, IOCallback cb, const KMObject *obj=nullptr);
     KMError updateFd(SOCKET_FD fd, uint32_t events);
     KMError unregisterFd(SOCKET_FD fd, bool close_fd);
     TimerManagerPtr getTimerMgr() { return timer_mgr_; }
     
     PollType getPollType() const;
     bool isPollLT() const; // level trigger
+    // for the completion based sockets that submit operations to IOPoll directly
+    IOPoll* getPoll() const { return poll_; }
     
     KMError appendObserver(ObserverCallback cb, EventLoopToken *token);
     KMError removeObserver(EventLoopToken *token);
@@ -109,22 +136,138 @@ public:
 public:
     bool inSameThread() const { return std::this_thread::get_id() == thread_id_; }
     std::thread::id threadId() const { return thread_id_; }
-    KMError appendTask(Task task, EventLoopToken *token);
+    KMError appendTask(Task task, EventLoopToken *token, TaskPriority priority=TaskPriority::NORMAL);
+    KMError appendTasks(Task *tasks, size_t count, EventLoopToken *token,
+                        TaskPriority priority=TaskPriority::NORMAL);
     KMError removeTask(EventLoopToken *token);
+    /* the task is bound to token at once, and is queued later by postPreparedTask. so it
+     * can be cancelled by token before it is queued, e.g. the continuation of offloaded work
+     */
+    KMError prepareTask(Task task, EventLoopToken *token, TaskSlot* &slot);
+    // the task is dropped if loop is stopped
+    void postPreparedTask(TaskSlot *slot, bool cancel=false);
+    static bool isTaskCancelled(const TaskSlot *slot)
+    {
+        return slot->state.load(std::memory_order_acquire) == TaskSlot::State::INACTIVE;
+    }
     KMError sync(Task task);
     KMError async(Task task, EventLoopToken *token=nullptr);
-    KMError post(Task task, EventLoopToken *token=nullptr);
+    KMError post(Task task, EventLoopToken *token=nullptr, TaskPriority priority=TaskPriority::NORMAL);
+    KMError postBatch(Task *tasks, size_t count, EventLoopToken *token=nullptr,
+                      TaskPriority priority=TaskPriority::NORMAL);
+    void setTaskTimeBudget(uint32_t budget_ms) { task_budget_ms_ = budget_ms; }
+    KMError setPollBatchSize(uint32_t max_events);
+    KMError enablePollDirectItem();
+    void setBusyPoll(uint32_t spin_us, bool sock_busy_poll);
     void loopOnce(uint32_t max_wait_ms);
     void loop(uint32_t max_wait_ms = -1);
     void notify();
     void stop();
-    bool stopped() const { return stop_loop_; }
+    bool stopped() const { return stop_loop_.load(std::memory_order_acquire); }
+    
+    // the TCP connections registered in loop, the internal fds are not counted
+    void addConnection() { conn_count_.fetch_add(1, std::memory_order_relaxed); }
+    void removeConnection() { conn_count_.fetch_sub(1, std::memory_order_relaxed); }
+    size_t getConnectionCount() const { return conn_count_.load(std::memory_order_relaxed); }
+    size_t getPendingTaskCount() const;
+    
+    // notifications that reached IOPoll and the ones coalesced
+    uint64_t getNotifyCount() const { return notify_count_.load(std::memory_order_relaxed); }
+    uint64_t getSuppressedNotifyCount() const { return notify_suppressed_.load(std::memory_order_relaxed); }
+    // spins that got I/O events or tasks, and the waits that blocked in IOPoll
+    uint64_t getSpinHitCount() const { return spin_hits_.load(std::memory_order_relaxed); }
+    uint64_t getBlockingWaitCount() const { return blocking_waits_.load(std::memory_order_relaxed); }
+    EventLoop::Stats getStats() const;
+    KMError setWatchdog(uint32_t threshold_ms);
+    
+    enum class CallbackKind : uint32_t {
+        IO,
+        TASK,
+        TIMER,
+    };
+    // mark the callback in running for watchdog, called in loop thread
+    void beginCallback(CallbackKind kind, uint64_t start_us, long obj_id=0);
+    void endCallback() { cb_start_us_.store(0, std::memory_order_release); }
+    // time of an I/O callback of the fds registered through loop, called in loop thread
+    void onIOCallback(uint64_t elapsed_us);
+    // called by watchdog thread, report the callback running longer than the threshold.
+    // reported_seq is the sequence of the callback reported last time
+    void checkSlowCallback(uint64_t now_us, uint64_t &reported_seq);
+    uint32_t getWatchdogThreshold() const { return watchdog_ms_.load(std::memory_order_relaxed); }
 
     void appendPendingObject(PendingObject *obj);
     void removePendingObject(PendingObject *obj);
+    // obj is flushed once, it is ignored if it is queued already
+    void appendFlushObject(FlushObject *obj);
+    void removeFlushObject(FlushObject *obj);
+    
+    /* the read block shared by the connections of this loop, called in loop thread.
+     * the data is received into the block and handed to the handlers by reference,
+     * handler can keep a slice of it by KMBuffer::subbuffer instead of copying.
+     * a block that is still referenced by slices is not given back to the loop
+     */
+    KMBuffer acquireRecvBuffer();
+    void releaseRecvBuffer(KMBuffer &&buf);
 
 protected:
+    struct PriorityTaskQueue
+    {
+        TaskQueue           queue;
+        std::atomic<size_t> count{ 0 };
+    };
+    PriorityTaskQueue& getTaskQueue(TaskPriority priority) { return task_queues_[int(priority)]; }
+    bool hasTasks(TaskPriority priority) const
+    {
+        return task_queues_[int(priority)].count.load(std::memory_order_acquire) > 0;
+    }
+    // producers are counted from the stop check to the end of enqueueing, so that
+    // the loop drains the task queues after the last one. return false if loop is stopped
+    bool enterAppend();
+    void leaveAppend() { task_producers_.fetch_sub(1, std::memory_order_release); }
+    void enqueueTask(TaskSlot *slot, TaskPriority priority);
+    // release the task that is not queued, it is never run
+    void dropTask(TaskSlot *slot);
     void processTasks();
+    // run the expired timers, return the time to wait for next timer, at most max_wait_ms
+    unsigned long checkTimers(uint32_t max_wait_ms);
+    // return false if the tasks are not completed in budget time
+    bool runTasks(PriorityTaskQueue &tq, uint64_t start_us, uint32_t budget_ms);
+    void runTask(TaskSlot *slot);
+    void releaseTask(TaskSlot *slot);
+    // return true if I/O events or tasks arrived in spin time
+    bool spinPoll(unsigned long wait_ms);
+    void pollWait(uint32_t wait_ms);
+    void flushObjects();
+    void onCallback(uint64_t elapsed_us);
+    
+    // written in loop thread only, so it is updated without read-modify-write
+    class StatCounter
+    {
+    public:
+        void add(uint64_t n) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+        void max(uint64_t n)
+        {
+            if (n > value_.load(std::memory_order_relaxed)) {
+                value_.store(n, std::memory_order_relaxed);
+            }
+        }
+        uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+        
+    private:
+        std::atomic<uint64_t> value_{ 0 };
+    };
+    struct LoopStats
+    {
+        StatCounter iterations;
+        StatCounter wait_us;
+        StatCounter task_us;
+        StatCounter tasks_executed;
+        StatCounter max_pending_tasks;
+        StatCounter io_events;
+        StatCounter max_callback_us;
+        StatCounter events_per_wait[EventLoop::Stats::HISTOGRAM_BUCKETS];
+        StatCounter callback_us[EventLoop::Stats::HISTOGRAM_BUCKETS];
+    };
     
 protected:
     using ObserverQueue = DLQueue<ObserverCallback>;
@@ -132,23 +275,57 @@ protected:
     using LockGuard = std::lock_guard<LockType>;
     
     IOPoll*             poll_;
-    bool                stop_loop_{ false };
+    std::unique_ptr<IOObserver> io_observer_;
+    std::atomic<bool>   stop_loop_{ false };
+    std::atomic<size_t> conn_count_{ 0 };
     std::thread::id     thread_id_;
     
-    TaskQueue           task_queue_;
-    LockType            task_mutex_;
+    TaskPool            task_pool_;
+    PriorityTaskQueue   task_queues_[3]; // indexed by TaskPriority
+    std::atomic<uint32_t> task_budget_ms_{ 10 };
+    std::atomic<uint32_t> task_producers_{ 0 };
+    LockType            task_mutex_; // for token only
     LockType            task_run_mutex_;
     
+    enum : uint32_t {
+        WAKEUP_SLEEPING = 1, // loop is waiting in IOPoll
+        WAKEUP_PENDING  = 2, // wakeup requested since loop started the iteration
+    };
+    std::atomic<uint32_t> wakeup_state_{ 0 };
+    std::atomic<uint64_t> notify_count_{ 0 };
+    std::atomic<uint64_t> notify_suppressed_{ 0 };
+    
+    std::atomic<uint32_t> spin_us_{ 0 };
+    std::atomic<bool>   sock_busy_poll_{ false };
+    std::atomic<uint64_t> spin_hits_{ 0 };
+    std::atomic<uint64_t> blocking_waits_{ 0 };
+    
+    LoopStats           stats_;
+    uint64_t            io_callback_us_ = 0; // time of I/O callbacks in current poll wait
+    
+    // the callback in running, it is checked by watchdog thread
+    std::atomic<uint32_t> watchdog_ms_{ 0 };
+    std::atomic<uint64_t> cb_seq_{ 0 };
+    std::atomic<uint64_t> cb_start_us_{ 0 }; // 0 if no callback is running
+    std::atomic<CallbackKind> cb_kind_{ CallbackKind::TASK };
+    std::atomic<long>   cb_obj_id_{ 0 }; // owner of fd if the callback is I/O
+    
     ObserverQueue       obs_queue_;
     LockType            obs_mutex_;
     
     TimerManagerPtr     timer_mgr_;
 
     PendingObject*      pending_objects_ = nullptr;
+    FlushObject*        flush_objects_ = nullptr;
+    
+    KMBuffer            recv_buffer_{ KMBuffer::StorageType::AUTO };
 };
 using EventLoopPtr = std::shared_ptr<EventLoop::Impl>;
 using EventLoopWeakPtr = std::weak_ptr<EventLoop::Impl>;
 
+// shared pointer of the EventLoop::Impl created by EventLoop, it is defined in kmapi.cpp
+EventLoopPtr getEventLoopPtr(EventLoop::Impl *loop);
+
 class EventLoopToken
 {
 public:
@@ -158,8 +335,8 @@ public:
     void eventLoop(const EventLoopPtr &loop);
     EventLoopPtr eventLoop();
     
-    void appendTaskNode(TaskNodePtr &node);
-    void removeTaskNode(TaskNodePtr &node);
+    void appendTaskNode(TaskSlot *slot);
+    void removeTaskNode(TaskSlot *slot);
     
     bool expired();
     void reset();
@@ -169,7 +346,7 @@ protected:
     EventLoopWeakPtr loop_;
     
     // task_nodes_ is protected by EventLoop task_mutex_
-    std::list<TaskNodePtr> task_nodes_;
+    TaskSlot* task_nodes_ = nullptr;
     
     bool observed = false;
     ObserverToken obs_token_;
@@ -39,6 +39,7 @@
 # include <arpa/inet.h>
 # include <netinet/tcp.h>
 # include <netinet/in.h>
+# include <sys/sendfile.h>
 # ifdef KUMA_OS_ANDROID
 #  include <sys/uio.h>
 # endif
@@ -50,6 +51,7 @@
 # include <sys/socket.h>
 # include <sys/ioctl.h>
 # include <sys/fcntl.h>
+# include <sys/stat.h>
 # include <sys/time.h>
 # include <sys/uio.h>
 # include <netinet/tcp.h>
@@ -63,6 +65,9 @@
 
 using namespace kuma;
 
+#define RECV_BUFFER_SIZE    (16 * 1024)
+#define SEND_IOV_BATCH      64
+
 SocketBase::SocketBase(const EventLoopPtr &loop)
     : loop_(loop), timer_(loop?loop->getTimerMgr():nullptr)
 {
@@ -250,8 +255,9 @@ bool SocketBase::registerFd(SOCKET_FD fd)
 {
     auto loop = loop_.lock();
     if (loop && fd != INVALID_FD) {
-        if (loop->registerFd(fd, KUMA_EV_NETWORK, [this](KMEvent ev, void* ol, size_t io_size) { ioReady(ev, ol, io_size); }) == KMError::NOERR) {
+        if (loop->registerFd(fd, KUMA_EV_NETWORK, [this](KMEvent ev, void* ol, size_t io_size) { ioReady(ev, ol, io_size); }, this) == KMError::NOERR) {
             registered_ = true;
+            loop->addConnection();
         }
     }
     return registered_;
@@ -262,6 +268,9 @@ void SocketBase::unregisterFd(SOCKET_FD fd, bool close_fd)
     if (registered_) {
         registered_ = false;
         auto loop = loop_.lock();
+        if (loop) {
+            loop->removeConnection();
+        }
         if (loop && fd != INVALID_FD) {
             loop->unregisterFd(fd, close_fd);
             return;
@@ -366,13 +375,86 @@ int SocketBase::send(const iovec* iovs, int count)
 
 int SocketBase::send(const KMBuffer &buf)
 {
-    IOVEC iovs;
-    buf.fillIov(iovs);
-    if (iovs.empty()) {
-        return 0;
+    // send the chain in batches with iovs on stack
+    iovec iovs[SEND_IOV_BATCH];
+    const KMBuffer *pos = &buf;
+    int bytes_sent = 0;
+    while (pos) {
+        int cnt = buf.fillIov(iovs, SEND_IOV_BATCH, pos);
+        if (cnt == 0) {
+            break;
+        }
+        size_t bytes_total = 0;
+        for (int i = 0; i < cnt; ++i) {
+            bytes_total += iovs[i].iov_len;
+        }
+        int ret = send(iovs, cnt);
+        if (ret < 0) {
+            return ret;
+        }
+        bytes_sent += ret;
+        if (static_cast<size_t>(ret) < bytes_total) {
+            break;
+        }
     }
-    return send(&iovs[0], static_cast<int>(iovs.size()));
+    return bytes_sent;
+}
+
+#ifndef KUMA_OS_WIN
+int SocketBase::sendFile(int fd, int64_t offset, size_t length)
+{
+    if (!isReady()) {
+        KUMA_WARNXTRACE("sendFile, invalid state=" << getState());
+        return 0;
+    }
+    if (length == 0) {
+        return 0;
+    }
+    if (length > INT_MAX) {
+        length = INT_MAX;
+    }
+
+    int ret = 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || offset + int64_t(length) > st.st_size) {
+        KUMA_ERRXTRACE("sendFile, out of file, fd=" << fd << ", offset=" << offset << ", length=" << length);
+        cleanup();
+        setState(State::CLOSED);
+        return -1;
+    }
+#ifdef KUMA_OS_MAC
+    off_t bytes_sent = length;
+    ret = ::sendfile(fd, fd_, offset, &bytes_sent, NULL, 0);
+    if (ret == 0 || (bytes_sent > 0 && (EAGAIN == getLastError() || EWOULDBLOCK == getLastError()))) {
+        ret = (int)bytes_sent;
+    }
+#else
+    off_t off = offset;
+    ret = (int)::sendfile(fd_, fd, &off, length);
+#endif
+    if (0 == ret) {
+        // the file is shorter than length
+        KUMA_ERRXTRACE("sendFile, end of file, fd=" << fd << ", offset=" << offset);
+        ret = -1;
+    }
+    else if (ret < 0) {
+        if (EAGAIN == getLastError() || EWOULDBLOCK == getLastError()) {
+            ret = 0;
+        }
+        else {
+            KUMA_ERRXTRACE("sendFile, failed, err=" << getLastError());
+        }
+    }
+
+    if (ret >= 0 && static_cast<size_t>(ret) < length) {
+        notifySendBlocked();
+    } else if (ret < 0) {
+        cleanup();
+        setState(State::CLOSED);
+    }
+    return ret;
 }
+#endif
 
 int SocketBase::receive(void* data, size_t length)
 {
@@ -409,6 +491,36 @@ int SocketBase::receive(void* data, size_t length)
     return ret;
 }
 
+int SocketBase::receive(KMBuffer &buf)
+{
+    auto loop = loop_.lock();
+    if (!loop) {
+        KMBuffer kmb(RECV_BUFFER_SIZE);
+        int ret = receive(kmb.writePtr(), kmb.space());
+        if (ret > 0) {
+            kmb.bytesWritten(ret);
+            buf = std::move(kmb);
+        }
+        return ret;
+    }
+    // receive into the read block of loop, a small read is copied into a buffer
+    // of its size class, so that the block is reused by the next read
+    auto block = loop->acquireRecvBuffer();
+    int ret = receive(block.writePtr(), block.space());
+    if (ret > 0) {
+        block.bytesWritten(ret);
+        if (size_t(ret) < block.capacity() / 4) {
+            KMBuffer kmb(ret);
+            kmb.write(block.readPtr(), ret);
+            buf = std::move(kmb);
+        } else {
+            buf = std::move(block);
+        }
+    }
+    loop->releaseRecvBuffer(std::move(block));
+    return ret;
+}
+
 KMError SocketBase::close()
 {
     KUMA_INFOXTRACE("close, state=" << getState());
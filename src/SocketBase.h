@@ -45,7 +45,12 @@ public:
     virtual int send(const void* data, size_t length);
     virtual int send(const iovec* iovs, int count);
     virtual int send(const KMBuffer &buf);
+#ifndef KUMA_OS_WIN
+    // send the file by sendfile(2), the sockets of IOCP and io_uring don't support it
+    int sendFile(int fd, int64_t offset, size_t length);
+#endif
     virtual int receive(void* data, size_t length);
+    virtual int receive(KMBuffer &buf);
     virtual KMError pause();
     virtual KMError resume();
     virtual KMError close();
@@ -21,14 +21,19 @@
 
 #include "TcpConnection.h"
 #include "util/kmtrace.h"
+#include "util/util.h"
 
 #include <sstream>
+#include <algorithm>
 
 using namespace kuma;
 
+#define SEND_BLOCK_SIZE         (4 * 1024)
+#define SEND_HIGH_WATERMARK     (256 * 1024)
+
 //////////////////////////////////////////////////////////////////////////
 TcpConnection::TcpConnection(const EventLoopPtr &loop)
-: tcp_(loop)
+: tcp_(loop), send_high_watermark_(SEND_HIGH_WATERMARK)
 {
     
 }
@@ -68,9 +73,8 @@ KMError TcpConnection::connect(const std::string &host, uint16_t port)
 void TcpConnection::saveInitData(const KMBuffer *init_buf)
 {
     if(init_buf && init_buf->chainLength() > 0) {
-        auto chain_size = init_buf->chainLength();
-        initData_.resize(chain_size);
-        init_buf->readChained(&initData_[0], initData_.size());
+        // the storage is shared if init_buf owns it
+        initData_.reset(init_buf->clone());
     }
 }
 
@@ -96,18 +100,24 @@ int TcpConnection::send(const void* data, size_t len)
 {
     if(!sendBufferEmpty()) {
         // try to send buffered data
-        auto ret = sendBufferedData();
-        if (ret != KMError::NOERR) {
+        if (sendBufferedData() != KMError::NOERR) {
             return -1;
-        } else if (!sendBufferEmpty()) {
+        }
+    }
+    if(!sendBufferEmpty()) {
+        // the data is sent with the queue on writable event
+        if (sendQueueFull()) {
             return 0;
         }
+        appendSendBuffer(data, len);
+        return int(len);
     }
     int ret = tcp_.send(data, len);
-    if (ret > 0) {
+    if (ret >= 0) {
+        // the rest is queued if socket is write blocked, even nothing is sent
         if (static_cast<size_t>(ret) < len) {
-            KMBuffer buf((char*)data + ret, len - ret, len - ret);
-            appendSendBuffer(buf);
+            appendSendBuffer((const char*)data + ret, len - ret);
+            write_blocked_ = true;
         }
         return int(len);
     }
@@ -117,18 +127,30 @@ int TcpConnection::send(const void* data, size_t len)
 int TcpConnection::send(const iovec* iovs, int count)
 {
     if(!sendBufferEmpty()) {
-        return 0;
+        if (sendBufferedData() != KMError::NOERR) {
+            return -1;
+        }
+    }
+    size_t total_len = 0;
+    if(!sendBufferEmpty()) {
+        if (sendQueueFull()) {
+            return 0;
+        }
+        for (int i=0; i<count; ++i) {
+            appendSendBuffer(iovs[i].iov_base, iovs[i].iov_len);
+            total_len += iovs[i].iov_len;
+        }
+        return int(total_len);
     }
     int ret = tcp_.send(iovs, count);
     if (ret >= 0) {
-        size_t total_len = 0;
         for (int i=0; i<count; ++i) {
             total_len += iovs[i].iov_len;
             const uint8_t* first = ((uint8_t*)iovs[i].iov_base) + ret;
             const uint8_t* last = ((uint8_t*)iovs[i].iov_base) + iovs[i].iov_len;
             if(first < last) {
-                KMBuffer buf(first, last - first, last - first);
-                appendSendBuffer(buf);
+                appendSendBuffer(first, last - first);
+                write_blocked_ = true;
                 ret = 0;
             } else {
                 ret -= iovs[i].iov_len;
@@ -142,29 +164,52 @@ int TcpConnection::send(const iovec* iovs, int count)
 int TcpConnection::send(const KMBuffer &buf)
 {
     if(!sendBufferEmpty()) {
-        // try to send buffered data
-        auto ret = sendBufferedData();
-        if (ret != KMError::NOERR) {
+        if (sendBufferedData() != KMError::NOERR) {
             return -1;
-        } else if (!sendBufferEmpty()) {
-            return 0;
         }
     }
     int chain_len = static_cast<int>(buf.chainLength());
+    if(!sendBufferEmpty()) {
+        if (sendQueueFull()) {
+            return 0;
+        }
+        appendSendBuffer(buf);
+        return chain_len;
+    }
     int ret = tcp_.send(buf);
-    if (ret > 0) {
+    if (ret >= 0) {
         if (ret < chain_len) {
-            if (send_buffer_) {
-                send_buffer_->append(buf.subbuffer(ret, chain_len - ret));
-            } else {
-                send_buffer_.reset(buf.subbuffer(ret, chain_len - ret));
-            }
+            appendSendChain(buf.subbuffer(ret, chain_len - ret), chain_len - ret);
+            write_blocked_ = true;
         }
         return chain_len;
     }
     return ret;
 }
 
+int TcpConnection::sendFile(int fd, int64_t offset, size_t len)
+{
+    if(!sendBufferEmpty()) {
+        if (sendBufferedData() != KMError::NOERR) {
+            return -1;
+        }
+    }
+    if(!sendBufferEmpty()) {
+        if (sendQueueFull()) {
+            return 0;
+        }
+        // the mapping of one chunk is queued, the rest is sent again on onWrite
+        len = std::min<size_t>(len, KM_FILE_CHUNK_SIZE);
+        return appendSendFile(fd, offset, len) ? int(len) : -1;
+    }
+    // the rest is not queued, so that it is sent by sendfile as well on onWrite
+    int ret = tcp_.sendFile(fd, offset, len);
+    if (ret >= 0 && static_cast<size_t>(ret) < std::min<size_t>(len, INT_MAX)) {
+        write_blocked_ = true;
+    }
+    return ret;
+}
+
 KMError TcpConnection::close()
 {
     //KUMA_INFOXTRACE("close");
@@ -174,61 +219,158 @@ KMError TcpConnection::close()
 
 KMError TcpConnection::sendBufferedData()
 {
-    if(send_buffer_ && !send_buffer_->empty()) {
-        int ret = tcp_.send(*send_buffer_);
+    // the iovs of one writev, it is used in loop thread only
+    static thread_local iovec s_iovs[KM_IOV_MAX];
+    if (write_blocked_) {
+        // the queue is sent on writable event
+        return KMError::NOERR;
+    }
+    while(send_buffer_len_ > 0) {
+        const KMBuffer *pos = send_buffer_.get();
+        int cnt = send_buffer_->fillIov(s_iovs, KM_IOV_MAX, pos);
+        if (cnt == 0) {
+            break;
+        }
+        int ret = tcp_.send(s_iovs, cnt);
         if(ret < 0) {
             return KMError::SOCK_ERROR;
-        } else {
-            send_buffer_->bytesRead(ret);
-            if (send_buffer_->empty()) {
-                send_buffer_.reset();
-            }
+        }
+        send_buffer_->bytesRead(ret);
+        send_buffer_len_ -= ret;
+        send_buffer_.reset(send_buffer_.release()->popFront());
+        if (!send_buffer_) {
+            send_tail_ = nullptr;
+        }
+        if (pos == nullptr || send_buffer_len_ == 0) {
+            // the queue is sent out, or socket is write blocked
+            write_blocked_ = send_buffer_len_ > 0;
+            break;
+        }
+        // more than KM_IOV_MAX buffers in queue
+        size_t batch_len = 0;
+        for (int i = 0; i < cnt; ++i) {
+            batch_len += s_iovs[i].iov_len;
+        }
+        if (static_cast<size_t>(ret) < batch_len) {
+            write_blocked_ = true;
+            break;
         }
     }
     return KMError::NOERR;
 }
 
-void TcpConnection::appendSendBuffer(const KMBuffer &buf)
+void TcpConnection::appendSendChain(KMBuffer *kmb, size_t len)
 {
+    if (!kmb) {
+        return;
+    }
     if (send_buffer_) {
-        send_buffer_->append(buf.clone());
+        send_buffer_->append(kmb);
     } else {
-        send_buffer_.reset(buf.clone());
+        send_buffer_.reset(kmb);
     }
+    send_buffer_len_ += len;
+    send_tail_ = nullptr;
+}
+
+bool TcpConnection::appendSendFile(int fd, int64_t offset, size_t len)
+{
+    auto *kmb = km_map_file(fd, offset, len);
+    if (!kmb) {
+        KUMA_ERRTRACE("appendSendFile, failed to map file, fd=" << fd << ", offset=" << offset << ", len=" << len);
+        return false;
+    }
+    appendSendChain(kmb, len);
+    return true;
+}
+
+void TcpConnection::appendSendBuffer(const KMBuffer &buf)
+{
+    appendSendChain(buf.clone(), buf.chainLength());
+}
+
+void TcpConnection::appendSendBuffer(const void *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    if (send_tail_ && send_tail_->space() >= len) {
+        send_tail_->write(data, len);
+        send_buffer_len_ += len;
+        return;
+    }
+    auto *kmb = new KMBuffer(len > SEND_BLOCK_SIZE ? len : SEND_BLOCK_SIZE);
+    kmb->write(data, len);
+    appendSendChain(kmb, len);
+    send_tail_ = kmb;
+}
+
+void TcpConnection::setSendWatermarks(size_t high, size_t low)
+{
+    send_high_watermark_ = high;
+    send_low_watermark_ = low < high ? low : high;
 }
 
 void TcpConnection::reset()
 {
     send_buffer_.reset();
-    initData_.clear();
+    send_buffer_len_ = 0;
+    send_tail_ = nullptr;
+    write_blocked_ = false;
+    initData_.reset();
 }
 
 void TcpConnection::onSend(KMError err)
 {
+    write_blocked_ = false;
     if (sendBufferedData() != KMError::NOERR) {
         cleanup();
         onError(KMError::SOCK_ERROR);
         return;
     }
-    if (sendBufferEmpty()) {
+    if (send_buffer_len_ <= send_low_watermark_) {
         onWrite();
     }
 }
 
+KMError TcpConnection::handleInputData(KMBuffer &buf)
+{
+    for (auto &kmb : buf) {
+        if (kmb.length() > 0) {
+            auto ret = handleInputData((uint8_t*)kmb.readPtr(), kmb.length());
+            if (ret != KMError::NOERR) {
+                return ret;
+            }
+        }
+    }
+    return KMError::NOERR;
+}
+
 void TcpConnection::onReceive(KMError err)
 {
-    if(!initData_.empty()) {
-        auto ret = handleInputData(&initData_[0], initData_.size());
+    if(initData_) {
+        auto ret = handleInputData(*initData_);
         if (ret != KMError::NOERR) {
             return;
         }
-        initData_.clear();
+        initData_.reset();
+    }
+    auto loop = eventLoop();
+    if (!loop) {
+        return;
     }
-    uint8_t buf[128*1024];
+    auto buf = loop->acquireRecvBuffer();
     do {
-        int ret = tcp_.receive(buf, sizeof(buf));
+        if (buf.isShared()) {
+            // the block is kept by handler
+            buf.allocBuffer(buf.capacity());
+        } else {
+            buf.rewind();
+        }
+        int ret = tcp_.receive(buf.writePtr(), buf.space());
         if (ret > 0) {
-            if (handleInputData(buf, ret) != KMError::NOERR) {
+            buf.bytesWritten(ret);
+            if (handleInputData(buf) != KMError::NOERR) {
                 break;
             }
         } else if (0 == ret) {
@@ -236,9 +378,10 @@ void TcpConnection::onReceive(KMError err)
         } else { // ret < 0
             cleanup();
             onError(KMError::SOCK_ERROR);
-            return;
+            break;
         }
     } while(true);
+    loop->releaseRecvBuffer(std::move(buf));
 }
 
 void TcpConnection::onClose(KMError err)
@@ -43,7 +43,15 @@ public:
     int send(const void* data, size_t len);
     int send(const iovec* iovs, int count);
     int send(const KMBuffer &buf);
+    // the file is sent by sendfile and the bytes sent is returned, it is queued by its
+    // mapping if the queue is not empty
+    int sendFile(int fd, int64_t offset, size_t len);
     KMError close();
+    /* the data is queued when socket is write blocked, send returns 0 when the queued bytes
+     * reach high watermark, and onWrite is called when it drops to low watermark
+     */
+    void setSendWatermarks(size_t high, size_t low);
+    KMError migrate(const EventLoopPtr &loop) { return tcp_.migrate(loop); }
     
     EventLoopPtr eventLoop() { return tcp_.eventLoop(); }
     
@@ -51,13 +59,20 @@ protected:
     // subclass should install destroy detector in this interface or implement delayed destroy
     // otherwise invalid memory accessing may happen on onReceive
     virtual KMError handleInputData(uint8_t *src, size_t len) = 0;
+    // buf references the read block of event loop, subclass can keep a slice of it by
+    // KMBuffer::subbuffer instead of copying the data. it calls handleInputData(src, len)
+    // by default
+    virtual KMError handleInputData(KMBuffer &buf);
     virtual void onConnect(KMError err) {};
     virtual void onWrite() = 0;
     virtual void onError(KMError err) = 0;
     bool isServer() { return isServer_; }
-    bool sendBufferEmpty() { return !send_buffer_ || send_buffer_->empty(); }
+    bool sendBufferEmpty() { return send_buffer_len_ == 0; }
+    bool sendQueueFull() { return send_buffer_len_ >= send_high_watermark_; }
     KMError sendBufferedData();
     void appendSendBuffer(const KMBuffer &buf);
+    // the data is copied, small data is coalesced into the tail buffer of queue
+    void appendSendBuffer(const void *data, size_t len);
     void reset();
     
 private:
@@ -69,15 +84,22 @@ private:
     void cleanup();
     void setupCallbacks();
     void saveInitData(const KMBuffer *init_buf);
+    void appendSendChain(KMBuffer *kmb, size_t len);
+    bool appendSendFile(int fd, int64_t offset, size_t len);
     
 protected:
     TcpSocket::Impl tcp_;
     std::string host_;
     uint16_t port_{ 0 };
     KMBuffer::Ptr send_buffer_;
+    size_t send_buffer_len_{ 0 };
     
 private:
-    std::vector<uint8_t>    initData_;
+    KMBuffer::Ptr           initData_;
+    KMBuffer*               send_tail_{ nullptr }; // the tail buffer that small data can be written into
+    bool                    write_blocked_{ false }; // waiting for writable event
+    size_t                  send_high_watermark_;
+    size_t                  send_low_watermark_{ 0 };
     
     bool                    isServer_{ false };
 };
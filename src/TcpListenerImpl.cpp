@@ -25,50 +25,122 @@
 #include <errno.h>
 
 #include "EventLoopImpl.h"
+#include "EventLoopGroupImpl.h"
 #include "TcpListenerImpl.h"
 #include "util/util.h"
 #include "util/kmtrace.h"
 #ifdef KUMA_OS_WIN
 # include "iocp/IocpAcceptor.h"
 #endif
+#ifdef KUMA_OS_LINUX
+# include "uring/UringAcceptor.h"
+#endif
 
 using namespace kuma;
 
 TcpListener::Impl::Impl(const EventLoopPtr &loop)
+: acceptor_(createAcceptor(loop))
+{
+
+}
+
+TcpListener::Impl::~Impl()
+{
+    close();
+}
+
+AcceptorBase* TcpListener::Impl::createAcceptor(const EventLoopPtr &loop)
 {
 #ifdef KUMA_OS_WIN
     if (loop->getPollType() == PollType::IOCP) {
-        acceptor_.reset(new IocpAcceptor(loop));
+        return new IocpAcceptor(loop);
     }
-    else
 #endif
-    {
-        acceptor_.reset(new AcceptorBase(loop));
+#ifdef KUMA_HAS_IO_URING
+    if (loop->getPollType() == PollType::IO_URING) {
+        return new UringAcceptor(loop);
     }
+#endif
+    return new AcceptorBase(loop);
 }
 
-TcpListener::Impl::~Impl()
+void TcpListener::Impl::setAcceptCallback(AcceptCallback cb)
 {
-    if (acceptor_) {
-        acceptor_->close();
-    }
+    acceptor_->setAcceptCallback(std::move(cb));
 }
 
-void TcpListener::Impl::setAcceptCallback(AcceptCallback cb)
+void TcpListener::Impl::setAcceptCallback(EventLoopGroup::Impl *group, LoopAcceptCallback cb)
 {
-    acceptor_->setAcceptCallback(std::move(cb));
+    if (!group || !cb) {
+        group_ = nullptr;
+        loop_accept_cb_.reset();
+        acceptor_->setAcceptCallback(nullptr);
+        return;
+    }
+    group_ = group;
+    // shared by the tasks dispatched to group loops
+    auto accept_cb = std::make_shared<LoopAcceptCallback>(std::move(cb));
+    loop_accept_cb_ = accept_cb;
+    acceptor_->setAcceptCallback([group, accept_cb] (SOCKET_FD fd, const char* ip, uint16_t port) {
+        return group->dispatchFd(fd, ip, port, accept_cb);
+    });
 }
 
 void TcpListener::Impl::setErrorCallback(ErrorCallback cb)
 {
+    error_cb_ = cb;
     acceptor_->setErrorCallback(std::move(cb));
 }
 
-KMError TcpListener::Impl::startListen(const std::string &host, uint16_t port)
+KMError TcpListener::Impl::startListen(const std::string &host, uint16_t port, uint32_t listen_flags)
 {
+    if ((listen_flags & LISTEN_FLAG_REUSEPORT) && group_ && group_->size() > 0) {
+        return startGroupListen(host, port, listen_flags);
+    }
+    setupAcceptor(acceptor_.get(), listen_flags);
     return acceptor_->listen(host, port);
 }
 
+void TcpListener::Impl::setupAcceptor(AcceptorBase *acceptor, uint32_t listen_flags)
+{
+    acceptor->setListenFlags(listen_flags);
+    acceptor->setBacklog(backlog_);
+    acceptor->setDeferAccept(defer_accept_s_);
+    acceptor->setFastOpen(fastopen_qlen_);
+}
+
+KMError TcpListener::Impl::startGroupListen(const std::string &host, uint16_t port, uint32_t listen_flags)
+{
+    if (!group_acceptors_.empty()) {
+        return KMError::INVALID_STATE;
+    }
+    auto accept_cb = loop_accept_cb_;
+    for (size_t i = 0; i < group_->size(); ++i) {
+        auto *loop = group_->getLoop(i);
+        AcceptorPtr acceptor(createAcceptor(getEventLoopPtr(loop->pimpl())));
+        // the fd is accepted in loop thread, no dispatching
+        acceptor->setAcceptCallback([loop, accept_cb] (SOCKET_FD fd, const char* ip, uint16_t port) {
+            return (*accept_cb)(loop, fd, ip, port);
+        });
+        acceptor->setErrorCallback(error_cb_);
+        setupAcceptor(acceptor.get(), listen_flags);
+        auto ret = acceptor->listen(host, port);
+        if (ret != KMError::NOERR) {
+            close();
+            return ret;
+        }
+        group_acceptors_.emplace_back(std::move(acceptor));
+    }
+    if (listen_flags & LISTEN_FLAG_CPU_STEERING) {
+        auto ret = group_acceptors_.front()->attachCpuSteering(uint32_t(group_acceptors_.size()));
+        if (ret != KMError::NOERR) {
+            // connections are still distributed by kernel hash
+            KUMA_WARNTRACE("TcpListener::startListen, failed to attach CPU steering, err="<<int(ret));
+        }
+    }
+    return KMError::NOERR;
+}
+
 KMError TcpListener::Impl::stopListen(const std::string &host, uint16_t port)
 {
     return close();
@@ -76,5 +148,9 @@ KMError TcpListener::Impl::stopListen(const std::string &host, uint16_t port)
 
 KMError TcpListener::Impl::close()
 {
+    for (auto &acceptor : group_acceptors_) {
+        acceptor->close();
+    }
+    group_acceptors_.clear();
     return acceptor_->close();
 }
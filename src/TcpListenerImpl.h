@@ -26,26 +26,50 @@
 #include "kmapi.h"
 #include "evdefs.h"
 #include "AcceptorBase.h"
+
+#include <vector>
+#include <memory>
 KUMA_NS_BEGIN
 
 class TcpListener::Impl
 {
 public:
     using AcceptCallback = TcpListener::AcceptCallback;
+    using LoopAcceptCallback = TcpListener::LoopAcceptCallback;
     using ErrorCallback = TcpListener::ErrorCallback;
     
     Impl(const EventLoopPtr &loop);
     ~Impl();
     
-    KMError startListen(const std::string &host, uint16_t port);
+    KMError startListen(const std::string &host, uint16_t port, uint32_t listen_flags);
     KMError stopListen(const std::string &host, uint16_t port);
     KMError close();
     
     void setAcceptCallback(AcceptCallback cb);
+    void setAcceptCallback(EventLoopGroup::Impl *group, LoopAcceptCallback cb);
     void setErrorCallback(ErrorCallback cb);
+    void setBacklog(int backlog) { backlog_ = backlog; }
+    void setDeferAccept(uint32_t timeout_s) { defer_accept_s_ = timeout_s; }
+    void setFastOpen(int queue_len) { fastopen_qlen_ = queue_len; }
+    
+private:
+    static AcceptorBase* createAcceptor(const EventLoopPtr &loop);
+    KMError startGroupListen(const std::string &host, uint16_t port, uint32_t listen_flags);
+    void setupAcceptor(AcceptorBase *acceptor, uint32_t listen_flags);
     
 private:
+    using AcceptorPtr = std::unique_ptr<AcceptorBase>;
+    
     std::unique_ptr<AcceptorBase> acceptor_;
+    
+    // one SO_REUSEPORT acceptor per loop of group
+    std::vector<AcceptorPtr> group_acceptors_;
+    EventLoopGroup::Impl* group_ = nullptr;
+    std::shared_ptr<LoopAcceptCallback> loop_accept_cb_;
+    ErrorCallback error_cb_;
+    int backlog_ = 128;
+    uint32_t defer_accept_s_ = 0;
+    int fastopen_qlen_ = 0;
 };
 
 KUMA_NS_END
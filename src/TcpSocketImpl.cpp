@@ -71,11 +71,19 @@
 #ifdef KUMA_OS_WIN
 # include "iocp/IocpSocket.h"
 #endif
+#ifdef KUMA_OS_LINUX
+# include "uring/UringSocket.h"
+#endif
 #include "ssl/BioHandler.h"
 #include "ssl/SioHandler.h"
 
 using namespace kuma;
 
+#define SSL_RECV_BUFFER_SIZE    (16 * 1024)
+#define CORK_BLOCK_SIZE         (4 * 1024)
+// the corked data is written out once it reaches this size
+#define CORK_MAX_SIZE           (64 * 1024)
+
 TcpSocket::Impl::Impl(const EventLoopPtr &loop)
 : loop_(loop)
 {
@@ -89,6 +97,11 @@ TcpSocket::Impl::~Impl()
 
 void TcpSocket::Impl::cleanup()
 {
+    migrate_token_.reset();
+    if (migrate_fd_ != INVALID_FD) {
+        closeFd(migrate_fd_);
+        migrate_fd_ = INVALID_FD;
+    }
     if (socket_) {
         socket_->close();
         socket_.reset();
@@ -96,6 +109,7 @@ void TcpSocket::Impl::cleanup()
 #ifdef KUMA_HAS_OPENSSL
     ssl_handler_.reset();
 #endif
+    resetCork();
 }
 
 KMError TcpSocket::Impl::setSslFlags(uint32_t ssl_flags)
@@ -180,6 +194,91 @@ KMError TcpSocket::Impl::detachFd(SOCKET_FD &fd)
     return err;
 }
 
+KMError TcpSocket::Impl::checkMigrate(const EventLoopPtr &loop) const
+{
+    auto cur_loop = eventLoop();
+    if (!loop || !cur_loop) {
+        return KMError::INVALID_PARAM;
+    }
+    if (!cur_loop->inSameThread()) {
+        KUMA_ERRXTRACE("migrate, not in loop thread");
+        return KMError::INVALID_STATE;
+    }
+    if (loop == cur_loop) {
+        return KMError::NOERR;
+    }
+    // the SSL handler and socket type are chosen by poll type
+    auto poll_type = cur_loop->getPollType();
+    if (loop->getPollType() != poll_type) {
+        KUMA_ERRXTRACE("migrate, different poll type");
+        return KMError::INVALID_PARAM;
+    }
+    if (poll_type == PollType::IOCP || poll_type == PollType::IO_URING) {
+        // the pending operations cannot be moved
+        return KMError::UNSUPPORT;
+    }
+    if (!socket_ || !socket_->isReady()) {
+        return KMError::INVALID_STATE;
+    }
+#ifdef KUMA_HAS_OPENSSL
+    if (sslEnabled() && !ssl_handler_) {
+        return KMError::INVALID_STATE;
+    }
+#endif
+    return KMError::NOERR;
+}
+
+KMError TcpSocket::Impl::migrate(const EventLoopPtr &loop)
+{
+    auto ret = checkMigrate(loop);
+    if (ret != KMError::NOERR || loop == eventLoop()) {
+        return ret;
+    }
+    SOCKET_FD fd = INVALID_FD;
+    ret = socket_->detachFd(fd);
+    if (ret != KMError::NOERR) {
+        return ret;
+    }
+    KUMA_INFOXTRACE("migrate, fd=" << fd);
+    // the SSL handler works on the fd or this object, and is kept as it is.
+    // the new socket is not ready untill it is attached in target loop thread, so
+    // the receive loop of current callback stops and the data sent are buffered.
+    // the corked data is kept and flushed by target loop
+    if (flush_queued_) {
+        eventLoop()->removeFlushObject(this);
+    }
+    cork_blocked_ = false;
+    loop_ = loop;
+    if (!createSocket()) {
+        closeFd(fd);
+        return KMError::INVALID_STATE;
+    }
+    migrate_fd_ = fd;
+    migrate_token_.reset();
+    migrate_token_.eventLoop(loop);
+    ret = loop->post([this] {
+        auto fd = migrate_fd_;
+        migrate_fd_ = INVALID_FD;
+        if (socket_->attachFd(fd) != KMError::NOERR) {
+            closeFd(fd);
+            onClose(KMError::INVALID_STATE);
+            return;
+        }
+        if (cork_len_ > 0) {
+            eventLoop()->appendFlushObject(this);
+        }
+        // the data in kernel is reported by poll, but not the data decrypted by SSL
+        if (sslEnabled()) {
+            onReceive(KMError::NOERR);
+        }
+    }, &migrate_token_);
+    if (ret != KMError::NOERR) {
+        migrate_fd_ = INVALID_FD;
+        closeFd(fd);
+    }
+    return ret;
+}
+
 KMError TcpSocket::Impl::attach(Impl &&other)
 {
     if (eventLoop() != other.eventLoop()) {
@@ -216,6 +315,15 @@ KMError TcpSocket::Impl::attach(Impl &&other)
         }
     }
 #endif
+    cork_ = other.cork_;
+    cork_blocked_ = other.cork_blocked_;
+    cork_buffer_ = std::move(other.cork_buffer_);
+    cork_tail_ = other.cork_tail_;
+    cork_len_ = other.cork_len_;
+    other.resetCork();
+    if (cork_len_ > 0 && !cork_blocked_) {
+        eventLoop()->appendFlushObject(this);
+    }
     return KMError::NOERR;
 }
 
@@ -358,6 +466,16 @@ int TcpSocket::Impl::send(const void* data, size_t length)
         KUMA_WARNXTRACE("send, invalid state");
         return 0;
     }
+    if (cork_ || cork_len_ > 0) {
+        auto ret = checkCork(length);
+        if (ret <= 0) {
+            return ret;
+        }
+        if (cork_ && length < CORK_MAX_SIZE) {
+            appendCork(data, length);
+            return static_cast<int>(length);
+        }
+    }
 
     int ret = 0;
 #ifdef KUMA_HAS_OPENSSL
@@ -384,6 +502,22 @@ int TcpSocket::Impl::send(const iovec* iovs, int count)
         KUMA_WARNXTRACE("send 2, invalid state");
         return 0;
     }
+    if (cork_ || cork_len_ > 0) {
+        size_t bytes_total = 0;
+        for (int i = 0; i < count; ++i) {
+            bytes_total += iovs[i].iov_len;
+        }
+        auto ret = checkCork(bytes_total);
+        if (ret <= 0) {
+            return ret;
+        }
+        if (cork_ && bytes_total < CORK_MAX_SIZE) {
+            for (int i = 0; i < count; ++i) {
+                appendCork(iovs[i].iov_base, iovs[i].iov_len);
+            }
+            return static_cast<int>(bytes_total);
+        }
+    }
 
     int ret = 0;
 #ifdef KUMA_HAS_OPENSSL
@@ -413,12 +547,220 @@ int TcpSocket::Impl::send(const iovec* iovs, int count)
 
 int TcpSocket::Impl::send(const KMBuffer &buf)
 {
-    IOVEC iovs;
-    buf.fillIov(iovs);
-    if (iovs.empty()) {
+    if (!isReady()) {
+        KUMA_WARNXTRACE("send 3, invalid state");
         return 0;
     }
-    return send(&iovs[0], static_cast<int>(iovs.size()));
+    if (cork_ || cork_len_ > 0) {
+        auto bytes_total = buf.chainLength();
+        auto ret = checkCork(bytes_total);
+        if (ret <= 0) {
+            return ret;
+        }
+        if (cork_ && bytes_total < CORK_MAX_SIZE) {
+            for (auto &kmb : buf) {
+                appendCork(kmb.readPtr(), kmb.length());
+            }
+            return static_cast<int>(bytes_total);
+        }
+    }
+
+    int ret = sendChain(buf);
+    if (ret < 0) {
+        cleanup();
+    }
+    return ret;
+}
+
+int TcpSocket::Impl::sendChain(const KMBuffer &buf)
+{
+    int ret = 0;
+#ifdef KUMA_HAS_OPENSSL
+    if (sslEnabled()) {
+        auto bytes_total = buf.chainLength();
+        if (bytes_total == 0) {
+            return 0;
+        }
+        ret = ssl_handler_->send(buf);
+        if(!is_bio_handler_ && ret >= 0 && static_cast<size_t>(ret) < bytes_total) {
+            socket_->notifySendBlocked();
+        }
+    }
+    else
+#endif
+    {
+        ret = sendData(buf);
+    }
+    return ret;
+}
+
+int TcpSocket::Impl::sendFile(int fd, int64_t offset, size_t length)
+{
+    if (!isReady()) {
+        KUMA_WARNXTRACE("sendFile, invalid state");
+        return 0;
+    }
+    if (length > INT_MAX) {
+        length = INT_MAX;
+    }
+    if (cork_len_ > 0) {
+        // the corked data is sent ahead of the file
+        auto ret = checkCork(CORK_MAX_SIZE);
+        if (ret <= 0) {
+            return ret;
+        }
+    }
+    
+    size_t bytes_sent = 0;
+    while (bytes_sent < length) {
+        auto chunk_len = length - bytes_sent;
+        int ret = 0;
+#ifndef KUMA_OS_WIN
+        if (useSendfile()) {
+            ret = socket_->sendFile(fd, offset + bytes_sent, chunk_len);
+        }
+        else
+#endif
+        {
+            // SSL encrypts the data in user space, it is sent from the mapping of file
+            if (chunk_len > KM_FILE_CHUNK_SIZE) {
+                chunk_len = KM_FILE_CHUNK_SIZE;
+            }
+            KMBuffer::Ptr buf(km_map_file(fd, offset + bytes_sent, chunk_len));
+            if (!buf) {
+                KUMA_ERRXTRACE("sendFile, failed to map file, fd=" << fd << ", offset=" << offset + bytes_sent);
+                ret = -1;
+            } else {
+                ret = sendChain(*buf);
+            }
+        }
+        if (ret < 0) {
+            cleanup();
+            return ret;
+        }
+        bytes_sent += ret;
+        if (static_cast<size_t>(ret) < chunk_len) {
+            break;
+        }
+    }
+    return static_cast<int>(bytes_sent);
+}
+
+bool TcpSocket::Impl::useSendfile() const
+{
+#ifdef KUMA_OS_WIN
+    return false;
+#else
+    if (sslEnabled()) {
+        return false;
+    }
+    auto loop = eventLoop();
+    return loop && loop->getPollType() != PollType::IO_URING;
+#endif
+}
+
+KMError TcpSocket::Impl::setCork(bool enable)
+{
+    cork_ = enable;
+    if (!cork_ && cork_len_ > 0 && !cork_blocked_ && isReady()) {
+        if (flushCork() < 0) {
+            return KMError::SOCK_ERROR;
+        }
+    }
+    return KMError::NOERR;
+}
+
+int TcpSocket::Impl::checkCork(size_t length)
+{
+    if (cork_blocked_) {
+        // the corked data is sent on writable event
+        return 0;
+    }
+    if (cork_len_ > 0 && (!cork_ || cork_len_ + length > CORK_MAX_SIZE)) {
+        if (flushCork() < 0) {
+            return -1;
+        }
+        if (cork_blocked_) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void TcpSocket::Impl::appendCork(const void *data, size_t length)
+{
+    if (length == 0) {
+        return;
+    }
+    auto *ptr = static_cast<const uint8_t*>(data);
+    if (cork_tail_ && cork_tail_->space() > 0) {
+        auto bytes_written = cork_tail_->write(ptr, length);
+        ptr += bytes_written;
+        length -= bytes_written;
+        cork_len_ += bytes_written;
+    }
+    if (length > 0) {
+        auto *kmb = new KMBuffer(length > CORK_BLOCK_SIZE ? length : CORK_BLOCK_SIZE);
+        kmb->write(ptr, length);
+        if (cork_buffer_) {
+            cork_buffer_->append(kmb);
+        } else {
+            cork_buffer_.reset(kmb);
+        }
+        cork_tail_ = kmb;
+        cork_len_ += length;
+    }
+    if (!flush_queued_) {
+        eventLoop()->appendFlushObject(this);
+    }
+}
+
+int TcpSocket::Impl::flushCork()
+{
+    if (flush_queued_) {
+        eventLoop()->removeFlushObject(this);
+    }
+    if (cork_len_ == 0) {
+        return 0;
+    }
+    int ret = sendChain(*cork_buffer_);
+    if (ret < 0) {
+        cleanup();
+        return ret;
+    }
+    cork_buffer_->bytesRead(ret);
+    cork_len_ -= ret;
+    cork_buffer_.reset(cork_buffer_.release()->popFront());
+    if (!cork_buffer_) {
+        cork_tail_ = nullptr;
+    }
+    cork_blocked_ = cork_len_ > 0;
+    return ret;
+}
+
+void TcpSocket::Impl::resetCork()
+{
+    if (flush_queued_) {
+        auto loop = eventLoop();
+        if (loop) {
+            loop->removeFlushObject(this);
+        }
+    }
+    cork_buffer_.reset();
+    cork_tail_ = nullptr;
+    cork_len_ = 0;
+    cork_blocked_ = false;
+}
+
+void TcpSocket::Impl::onLoopFlush()
+{
+    if (!isReady() || cork_blocked_) {
+        return;
+    }
+    if (flushCork() < 0) {
+        KUMA_ERRXTRACE("onLoopFlush, failed to send corked data");
+        onClose(KMError::SOCK_ERROR);
+    }
 }
 
 int TcpSocket::Impl::receive(void* data, size_t length)
@@ -443,6 +785,33 @@ int TcpSocket::Impl::receive(void* data, size_t length)
     return ret;
 }
 
+int TcpSocket::Impl::receive(KMBuffer &buf)
+{
+    if (!isReady()) {
+        return 0;
+    }
+
+    int ret = 0;
+#ifdef KUMA_HAS_OPENSSL
+    if (sslEnabled()) {
+        KMBuffer kmb(SSL_RECV_BUFFER_SIZE);
+        ret = ssl_handler_->receive(kmb.writePtr(), kmb.space());
+        if (ret > 0) {
+            kmb.bytesWritten(ret);
+            buf = std::move(kmb);
+        }
+    }
+    else
+#endif
+    {
+        ret = socket_->receive(buf);
+    }
+    if (ret < 0) {
+        cleanup();
+    }
+    return ret;
+}
+
 KMError TcpSocket::Impl::close()
 {
     KUMA_INFOXTRACE("close");
@@ -510,6 +879,17 @@ void TcpSocket::Impl::onSend(KMError err)
         }
     }
 #endif
+    if (cork_len_ > 0 && isReady()) {
+        cork_blocked_ = false;
+        if (flushCork() < 0) {
+            KUMA_ERRXTRACE("onSend, failed to send corked data");
+            onClose(KMError::SOCK_ERROR);
+            return;
+        }
+        if (cork_blocked_) {
+            return;
+        }
+    }
 
     if (write_cb_ && isReady()) write_cb_(err);
 }
@@ -541,6 +921,12 @@ bool TcpSocket::Impl::createSocket()
             socket_.reset(new IocpSocket(loop));
         }
         else
+#endif
+#ifdef KUMA_HAS_IO_URING
+        if (loop->getPollType() == PollType::IO_URING) {
+            socket_.reset(new UringSocket(loop));
+        }
+        else
 #endif
         {
             socket_.reset(new SocketBase(loop));
@@ -563,7 +949,8 @@ bool TcpSocket::Impl::createSslHandler()
 {
     auto loop = eventLoop();
     if (loop) {
-        if (loop->getPollType() == PollType::IOCP) {
+        auto poll_type = loop->getPollType();
+        if (poll_type == PollType::IOCP || poll_type == PollType::IO_URING) {
             auto bio_handler = new BioHandler();
             bio_handler->setSendFunc([this](const KMBuffer &buf) -> int {
                 return sendData(buf);
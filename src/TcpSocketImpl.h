@@ -45,7 +45,7 @@
 KUMA_NS_BEGIN
 class SocketBase;
 
-class TcpSocket::Impl : public KMObject, public DestroyDetector
+class TcpSocket::Impl : public KMObject, public DestroyDetector, public FlushObject
 {
 public:
     using EventCallback = TcpSocket::EventCallback;
@@ -63,6 +63,9 @@ public:
     KMError attachFd(SOCKET_FD fd);
     KMError attach(Impl &&other);
     KMError detachFd(SOCKET_FD &fd);
+    // move the open socket to loop, it must be called in the thread of current loop
+    KMError migrate(const EventLoopPtr &loop);
+    KMError checkMigrate(const EventLoopPtr &loop) const;
 #ifdef KUMA_HAS_OPENSSL
     KMError setAlpnProtocols(const AlpnProtos &protocols);
     KMError getAlpnSelected(std::string &proto);
@@ -74,9 +77,15 @@ public:
     int send(const void* data, size_t length);
     int send(const iovec* iovs, int count);
     int send(const KMBuffer &buf);
+    // return less than length only if the socket is write blocked, length is truncated to INT_MAX
+    int sendFile(int fd, int64_t offset, size_t length);
     int receive(void* data, size_t length);
+    int receive(KMBuffer &buf);
     KMError close();
     
+    KMError setCork(bool enable);
+    bool getCork() const { return cork_; }
+    
     KMError pause();
     KMError resume();
     
@@ -92,6 +101,7 @@ private:
     void onSend(KMError err);
     void onReceive(KMError err);
     void onClose(KMError err);
+    void onLoopFlush() override;
     
     bool createSocket();
 #ifdef KUMA_HAS_OPENSSL
@@ -102,6 +112,15 @@ private:
     int sendData(const iovec *iovs, int count);
     int sendData(const KMBuffer &buf);
     int recvData(void *data, size_t length);
+    int sendChain(const KMBuffer &buf);
+    bool useSendfile() const;
+    
+    // return 1 if the data can be corked or sent, 0 if corked data is write blocked, -1 on error
+    int checkCork(size_t length);
+    void appendCork(const void *data, size_t length);
+    // return the bytes sent, or -1 on error
+    int flushCork();
+    void resetCork();
     
 private:
     void cleanup();
@@ -124,6 +143,18 @@ private:
     EventCallback       read_cb_;
     EventCallback       write_cb_;
     EventCallback       error_cb_;
+    
+    // the data sent in one loop iteration are coalesced in cork buffer, and are
+    // written out by one send call when the loop flushes this object
+    bool                cork_ = false;
+    bool                cork_blocked_ = false;
+    KMBuffer::Ptr       cork_buffer_;
+    KMBuffer*           cork_tail_ = nullptr;
+    size_t              cork_len_ = 0;
+    
+    // the fd is attached in target loop thread when migrating
+    SOCKET_FD           migrate_fd_{ INVALID_FD };
+    EventLoopToken      migrate_token_;
 };
 
 KUMA_NS_END
@@ -0,0 +1,238 @@
+/* Copyright (c) 2014, Fengping Bao <jamol@live.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ThreadPoolImpl.h"
+#include "util/kmtrace.h"
+
+KUMA_NS_BEGIN
+
+namespace {
+// the pool and worker index of current thread
+thread_local ThreadPool::Impl* tls_pool = nullptr;
+thread_local size_t tls_worker = 0;
+
+/**
+ * OffloadTask runs the work in worker thread and then posts the continuation to loop.
+ * the continuation is bound to token when offloaded, so the work is skipped and the
+ * continuation is dropped if token is cancelled before them
+ */
+class OffloadTask
+{
+public:
+    OffloadTask(const EventLoopPtr &loop, ThreadPool::Task &&work, TaskSlot *done)
+    : loop_(loop), work_(std::move(work)), done_(done) {}
+    OffloadTask(OffloadTask &&other)
+    : loop_(std::move(other.loop_)), work_(std::move(other.work_)), done_(other.done_)
+    {
+        other.done_ = nullptr;
+    }
+    OffloadTask(const OffloadTask &other) = delete;
+    ~OffloadTask()
+    {
+        if (done_) {
+            // discarded by stopped pool
+            loop_->postPreparedTask(done_, true);
+        }
+    }
+
+    void operator()()
+    {
+        if (done_ && EventLoop::Impl::isTaskCancelled(done_)) {
+            loop_->postPreparedTask(done_, true);
+            done_ = nullptr;
+            return;
+        }
+        if (work_) {
+            work_();
+        }
+        if (done_) {
+            loop_->postPreparedTask(done_);
+            done_ = nullptr;
+        }
+    }
+
+private:
+    EventLoopPtr        loop_;
+    ThreadPool::Task    work_;
+    TaskSlot*           done_;
+};
+}
+
+ThreadPool::Impl::Impl()
+{
+    KM_SetObjKey("ThreadPool");
+}
+
+ThreadPool::Impl::~Impl()
+{
+    stop();
+}
+
+KMError ThreadPool::Impl::start(size_t count)
+{
+    if (!workers_.empty()) {
+        return KMError::INVALID_STATE;
+    }
+    if (count == 0) {
+        count = std::thread::hardware_concurrency();
+        if (count == 0) {
+            count = 1;
+        }
+    }
+    KUMA_INFOXTRACE("start, count="<<count);
+    for (size_t i = 0; i < count; ++i) {
+        workers_.emplace_back(new Worker());
+    }
+    running_ = true;
+    for (size_t i = 0; i < count; ++i) {
+        workers_[i]->thread = std::thread([this, i] { run(i); });
+    }
+    return KMError::NOERR;
+}
+
+void ThreadPool::Impl::stop()
+{
+    if (workers_.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> g(idle_mutex_);
+        running_ = false;
+    }
+    idle_cv_.notify_all();
+    for (auto &w : workers_) {
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+    }
+    // the posters that have seen running_ are still accessing workers_
+    while (posters_.load() > 0) {
+        std::this_thread::yield();
+    }
+    // the tasks not run are discarded, and the continuations are cancelled
+    workers_.clear();
+    pending_ = 0;
+}
+
+KMError ThreadPool::Impl::post(Task task)
+{
+    if (!task) {
+        return KMError::INVALID_PARAM;
+    }
+    // pairs with stop that clears running_ and then waits for posters_
+    posters_.fetch_add(1);
+    if (!running_) {
+        posters_.fetch_sub(1, std::memory_order_release);
+        return KMError::INVALID_STATE;
+    }
+    size_t index = 0;
+    if (tls_pool == this) {
+        index = tls_worker;
+    } else {
+        index = next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    }
+    {
+        auto &w = *workers_[index];
+        std::lock_guard<std::mutex> g(w.mutex);
+        w.tasks.push_back(std::move(task));
+    }
+    // pairs with the idle worker that increases idle_count_ and then checks pending_
+    pending_.fetch_add(1);
+    if (idle_count_.load() > 0) {
+        std::lock_guard<std::mutex> g(idle_mutex_);
+        idle_cv_.notify_one();
+    }
+    posters_.fetch_sub(1, std::memory_order_release);
+    return KMError::NOERR;
+}
+
+KMError ThreadPool::Impl::offload(const EventLoopPtr &loop, Task work, Task done, EventLoopToken *token)
+{
+    if (!loop) {
+        return KMError::INVALID_PARAM;
+    }
+    if (!running_) {
+        return KMError::INVALID_STATE;
+    }
+    TaskSlot *slot = nullptr;
+    if (done) {
+        auto ret = loop->prepareTask(std::move(done), token, slot);
+        if (ret != KMError::NOERR) {
+            return ret;
+        }
+    }
+    // OffloadTask cancels the continuation if it is not posted
+    return post(OffloadTask(loop, std::move(work), slot));
+}
+
+void ThreadPool::Impl::run(size_t index)
+{
+    tls_pool = this;
+    tls_worker = index;
+    Task task;
+    while (true) {
+        if (popTask(index, task) || stealTask(index, task)) {
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(idle_mutex_);
+        idle_count_.fetch_add(1);
+        idle_cv_.wait(lk, [this] { return !running_ || pending_.load() > 0; });
+        idle_count_.fetch_sub(1);
+        if (!running_) {
+            break;
+        }
+    }
+    tls_pool = nullptr;
+}
+
+bool ThreadPool::Impl::popTask(size_t index, Task &task)
+{
+    auto &w = *workers_[index];
+    std::lock_guard<std::mutex> g(w.mutex);
+    if (w.tasks.empty()) {
+        return false;
+    }
+    // the newest one is likely hot in cache
+    task = std::move(w.tasks.back());
+    w.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::Impl::stealTask(size_t index, Task &task)
+{
+    auto count = workers_.size();
+    for (size_t i = 1; i < count; ++i) {
+        auto &w = *workers_[(index + i) % count];
+        std::lock_guard<std::mutex> g(w.mutex);
+        if (!w.tasks.empty()) {
+            task = std::move(w.tasks.front());
+            w.tasks.pop_front();
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+KUMA_NS_END
@@ -0,0 +1,90 @@
+/* Copyright (c) 2014, Fengping Bao <jamol@live.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __ThreadPoolImpl_H__
+#define __ThreadPoolImpl_H__
+
+#include "kmapi.h"
+#include "EventLoopImpl.h"
+#include "util/kmobject.h"
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+
+KUMA_NS_BEGIN
+
+/**
+ * each worker has its own task deque, the worker takes the newest task of its own deque
+ * and steals the oldest task of other deques when it has no task. the tasks posted in
+ * worker thread are pushed to its own deque, the others are distributed in turn
+ */
+class ThreadPool::Impl final : public KMObject
+{
+public:
+    using Task = ThreadPool::Task;
+
+    Impl();
+    ~Impl();
+
+    KMError start(size_t count);
+    void stop();
+
+    size_t size() const { return workers_.size(); }
+    size_t getPendingTaskCount() const { return pending_.load(std::memory_order_relaxed); }
+    uint64_t getStolenTaskCount() const { return stolen_.load(std::memory_order_relaxed); }
+
+    KMError post(Task task);
+    KMError offload(const EventLoopPtr &loop, Task work, Task done, EventLoopToken *token);
+
+protected:
+    struct Worker
+    {
+        std::mutex          mutex;
+        std::deque<Task>    tasks;
+        std::thread         thread;
+    };
+    void run(size_t index);
+    bool popTask(size_t index, Task &task);
+    bool stealTask(size_t index, Task &task);
+
+protected:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool>   running_{ false };
+    // the threads in post, stop waits for them before workers_ is cleared
+    std::atomic<uint32_t> posters_{ 0 };
+    std::atomic<size_t> next_worker_{ 0 };
+    std::atomic<size_t> pending_{ 0 };
+    std::atomic<uint64_t> stolen_{ 0 };
+
+    // the idle workers wait on cv_
+    std::mutex          idle_mutex_;
+    std::condition_variable idle_cv_;
+    std::atomic<size_t> idle_count_{ 0 };
+};
+
+KUMA_NS_END
+
+#endif
@@ -24,6 +24,10 @@
 #include "util/kmtrace.h"
 
 #include <string.h>
+#ifdef KUMA_OS_LINUX
+# include <sys/timerfd.h>
+# include <unistd.h>
+#endif
 
 using namespace kuma;
 
@@ -31,6 +35,7 @@ KUMA_NS_BEGIN
 
 int find_first_set(unsigned int b);
 TICK_COUNT_TYPE get_tick_count_ms();
+uint64_t get_tick_count_us();
 TICK_COUNT_TYPE calc_time_elapse_delta_ms(TICK_COUNT_TYPE now_tick, TICK_COUNT_TYPE& start_tick);
 
 KUMA_NS_END
@@ -54,8 +59,16 @@ bool Timer::Impl::schedule(uint32_t delay_ms, TimerCallback cb, TimerMode mode)
 {
     TimerManagerPtr mgr = timer_mgr_.lock();
     if(mgr) {
-        cb_ = std::move(cb);
-        return mgr->scheduleTimer(this, delay_ms, mode);
+        return mgr->scheduleTimer(this, delay_ms, mode, std::move(cb));
+    }
+    return false;
+}
+
+bool Timer::Impl::scheduleUs(uint32_t delay_us, TimerCallback cb, TimerMode mode)
+{
+    TimerManagerPtr mgr = timer_mgr_.lock();
+    if(mgr) {
+        return mgr->scheduleHighResTimer(this, delay_us, mode, std::move(cb));
     }
     return false;
 }
@@ -85,87 +98,329 @@ TimerManager::TimerManager(EventLoop::Impl* loop)
 
 TimerManager::~TimerManager()
 {
-    
+    if(hr_fd_ != INVALID_FD) {
+        closeFd(hr_fd_); // poll is gone with loop
+        hr_fd_ = INVALID_FD;
+    }
 }
 
-bool TimerManager::scheduleTimer(Timer::Impl* timer, uint32_t delay_ms, TimerMode mode)
+bool TimerManager::scheduleTimer(Timer::Impl* timer, uint32_t delay_ms, TimerMode mode, TimerCallback cb)
 {
+    if(loop_->inSameThread()) {
+        return scheduleTimer_i(timer, delay_ms, mode, cb);
+    }
+    // the following cancelTimer will wait for this task since they are in the same task queue,
+    // and the task is cancelled with token if the timer is destroyed after loop stopped
     TimerNode* timer_node = &timer->timer_node_;
-    if(isTimerPending(timer_node) && delay_ms == timer_node->delay_ms_) {
-        return true;
+    timer_node->armed_.store(true, std::memory_order_release);
+    auto ret = loop_->post([this, timer, delay_ms, mode, cb] () mutable {
+        if(loop_->stopped()) {
+            // the remaining tasks are run after loop stopped, the timer would never fire
+            timer->timer_node_.armed_.store(false, std::memory_order_relaxed);
+            return ;
+        }
+        scheduleTimer_i(timer, delay_ms, mode, cb);
+    }, getLoopToken(timer));
+    if(ret != KMError::NOERR) {
+        timer_node->armed_.store(false, std::memory_order_release);
+        return false;
     }
-    TICK_COUNT_TYPE now_tick = get_tick_count_ms();
-    timer_node->cancelled_ = false;
-    bool need_notify = false;
-    bool ret = false;
-    {
-        KM_Lock_Guard g(mutex_);
-        if(isTimerPending(timer_node)) {
-            removeTimer(timer_node);
+    return true;
+}
+
+bool TimerManager::scheduleHighResTimer(Timer::Impl* timer, uint32_t delay_us, TimerMode mode, TimerCallback cb)
+{
+    if(loop_->inSameThread()) {
+        return scheduleHighResTimer_i(timer, delay_us, mode, cb);
+    }
+    TimerNode* timer_node = &timer->timer_node_;
+    timer_node->armed_.store(true, std::memory_order_release);
+    auto ret = loop_->post([this, timer, delay_us, mode, cb] () mutable {
+        if(loop_->stopped()) {
+            timer->timer_node_.armed_.store(false, std::memory_order_relaxed);
+            return ;
         }
-        timer_node->start_tick_ = now_tick;
-        timer_node->delay_ms_ = delay_ms;
-        timer_node->repeating_ = mode == TimerMode::REPEATING;
-        
-        ret = addTimer(timer_node, FROM_SCHEDULE);
-        if(reschedule_node_ == timer_node) {
-            reschedule_node_ = nullptr;
+        scheduleHighResTimer_i(timer, delay_us, mode, cb);
+    }, getLoopToken(timer));
+    if(ret != KMError::NOERR) {
+        timer_node->armed_.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+KMError TimerManager::enableHighResTimer()
+{
+    return loop_->async([this] {
+        enableHighResTimer_i();
+    });
+}
+
+void TimerManager::cancelTimer(Timer::Impl* timer)
+{
+    if(loop_->inSameThread()) {
+        cancelTimer_i(timer);
+        return ;
+    }
+    TimerNode* timer_node = &timer->timer_node_;
+    if(!timer_node->armed_.load(std::memory_order_acquire)) {
+        return ; // neither pending nor running
+    }
+    // the timer callback is not running after sync returns
+    auto ret = loop_->sync([this, timer] {
+        cancelTimer_i(timer);
+    });
+    if(ret != KMError::NOERR) {
+        // loop is stopped, the schedule task may be still queued, cancel it
+        // or wait until it is completed
+        if(timer->loop_token_) {
+            loop_->removeTask(timer->loop_token_.get());
         }
-        long diff = long(now_tick - last_tick_);
-        if(last_remain_ms_ == -1 || (diff >= 0 && delay_ms < last_remain_ms_ - diff)) {
-            // need update poll wait time
-            need_notify = !loop_->inSameThread();
+        timer_node->armed_.store(false, std::memory_order_release);
+    }
+}
+
+EventLoopToken* TimerManager::getLoopToken(Timer::Impl* timer)
+{
+    if(!timer->loop_token_) {
+        timer->loop_token_.reset(new EventLoopToken());
+        timer->loop_token_->eventLoop(getEventLoopPtr(loop_));
+    }
+    return timer->loop_token_.get();
+}
+
+bool TimerManager::scheduleTimer_i(Timer::Impl* timer, uint32_t delay_ms, TimerMode mode, TimerCallback &cb)
+{
+    timer->cb_ = std::move(cb);
+    TimerNode* timer_node = &timer->timer_node_;
+    timer_node->cancelled_ = false;
+    timer_node->armed_.store(true, std::memory_order_relaxed);
+    timer_node->repeating_ = mode == TimerMode::REPEATING;
+    if(reschedule_node_ == timer_node) {
+        reschedule_node_ = nullptr;
+    }
+    if(isTimerPending(timer_node)) {
+        if(!timer_node->high_res_ && delay_ms == timer_node->delay_ms_) {
+            return true;
         }
+        removeTimer(timer_node);
     }
-    if(need_notify) {
-        loop_->notify();
+    timer_node->high_res_ = false;
+    TICK_COUNT_TYPE now_tick = get_tick_count_ms();
+    timer_node->start_tick_ = now_tick;
+    timer_node->delay_ms_ = delay_ms;
+    
+    bool ret = addTimer(timer_node, FROM_SCHEDULE);
+    long diff = long(now_tick - last_tick_);
+    if(last_remain_ms_ != -1 && diff >= 0 && delay_ms < last_remain_ms_ - diff) {
+        last_remain_ms_ = -1; // poll wait time will be recalculated
     }
     return ret;
 }
 
-void TimerManager::cancelTimer(Timer::Impl* timer)
+bool TimerManager::scheduleHighResTimer_i(Timer::Impl* timer, uint32_t delay_us, TimerMode mode, TimerCallback &cb)
+{
+    if(!hr_enabled_) {
+        return scheduleTimer_i(timer, (delay_us + 999) / 1000, mode, cb);
+    }
+    timer->cb_ = std::move(cb);
+    TimerNode* timer_node = &timer->timer_node_;
+    timer_node->cancelled_ = false;
+    timer_node->armed_.store(true, std::memory_order_relaxed);
+    timer_node->repeating_ = mode == TimerMode::REPEATING;
+    if(reschedule_node_ == timer_node) {
+        reschedule_node_ = nullptr;
+    }
+    if(isTimerPending(timer_node)) {
+        removeTimer(timer_node);
+    }
+    timer_node->high_res_ = true;
+    timer_node->delay_us_ = delay_us;
+    timer_node->fire_us_ = get_tick_count_us() + delay_us;
+    heap_push(timer_node);
+    if(timer_node->heap_index_ == 0) {
+        updateHighResTimer();
+    }
+    return true;
+}
+
+void TimerManager::cancelTimer_i(Timer::Impl* timer)
 {
     TimerNode* timer_node = &timer->timer_node_;
+    timer_node->armed_.store(false, std::memory_order_relaxed);
+    if(running_node_ == timer_node) {
+        running_node_ = nullptr; // cancelled or destroyed in its callback
+    }
     if(timer_node->cancelled_) {
         return ;
     }
     timer_node->cancelled_ = true;
-    bool cancelled = false;
-    if(reschedule_node_ == timer_node || isTimerPending(timer_node)) {
-        mutex_.lock();
-        if(isTimerPending(timer_node)) {
-            removeTimer(timer_node);
-            cancelled = true;
-        } else {
-            if(running_node_ != timer_node) {
-                cancelled = true;
-            }
-            if(reschedule_node_ == timer_node) {
-                reschedule_node_ = nullptr;
+    if(isTimerPending(timer_node)) {
+        removeTimer(timer_node);
+    }
+    if(reschedule_node_ == timer_node) {
+        reschedule_node_ = nullptr;
+    }
+}
+
+void TimerManager::enableHighResTimer_i()
+{
+    if(hr_enabled_) {
+        return ;
+    }
+    hr_enabled_ = true;
+#ifdef KUMA_OS_LINUX
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(fd < 0) {
+        KUMA_WARNTRACE("enableHighResTimer, timerfd_create failed, err="<<errno);
+        return ;
+    }
+    auto ret = loop_->registerFd(fd, KUMA_EV_READ, [this] (KMEvent, void*, size_t) {
+        onHighResTimer();
+    });
+    if(ret != KMError::NOERR) {
+        KUMA_WARNTRACE("enableHighResTimer, failed to register timerfd, err="<<int(ret));
+        closeFd(fd);
+        return ;
+    }
+    hr_fd_ = fd;
+#endif
+}
+
+void TimerManager::onHighResTimer()
+{
+#ifdef KUMA_OS_LINUX
+    uint64_t expirations = 0;
+    while(::read(hr_fd_, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+    }
+#endif
+    hr_armed_us_ = 0;
+    int count = runHighResTimers();
+    if(count > 0) {
+        fired_count_.store(fired_count_.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+}
+
+int TimerManager::runHighResTimers()
+{
+    if(hr_heap_.empty()) {
+        return 0;
+    }
+    int count = 0;
+    uint64_t now_us = get_tick_count_us();
+    while(!hr_heap_.empty() && hr_heap_[0]->fire_us_ <= now_us) {
+        TimerNode* timer_node = hr_heap_[0];
+        heap_remove(timer_node);
+        running_node_ = timer_node;
+        if(timer_node->timer_) {
+            timer_node->timer_->cb_();
+            ++count;
+        }
+        // running_node_ is reset if the timer is cancelled or destroyed in callback
+        if(running_node_ && !isTimerPending(timer_node)) {
+            if(timer_node->repeating_) {
+                // keep the pace, but don't burst for the missed periods
+                timer_node->fire_us_ += timer_node->delay_us_;
+                if(timer_node->fire_us_ <= now_us) {
+                    timer_node->fire_us_ = now_us + timer_node->delay_us_;
+                }
+                heap_push(timer_node);
+            } else {
+                timer_node->armed_.store(false, std::memory_order_relaxed);
             }
         }
-        mutex_.unlock();
-    }
-    // check timer running
-    if(!cancelled && running_node_ == timer_node) { // may be running, wait it
-        running_mutex_.lock();
-        if(running_node_ == timer_node) {
-            running_node_ = nullptr;
-            cancelled = true;
+        running_node_ = nullptr;
+    }
+    updateHighResTimer();
+    return count;
+}
+
+void TimerManager::updateHighResTimer()
+{
+#ifdef KUMA_OS_LINUX
+    if(hr_fd_ == INVALID_FD || hr_heap_.empty()) {
+        return ; // a stale timerfd expiration is harmless
+    }
+    uint64_t fire_us = hr_heap_[0]->fire_us_;
+    if(hr_armed_us_ != 0 && hr_armed_us_ <= fire_us) {
+        return ;
+    }
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    // get_tick_count_us is CLOCK_MONOTONIC based on linux
+    its.it_value.tv_sec = fire_us / 1000000;
+    its.it_value.tv_nsec = (fire_us % 1000000) * 1000;
+    if(its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+        its.it_value.tv_nsec = 1;
+    }
+    if(timerfd_settime(hr_fd_, TFD_TIMER_ABSTIME, &its, nullptr) != 0) {
+        KUMA_WARNTRACE("updateHighResTimer, timerfd_settime failed, err="<<errno);
+        return ;
+    }
+    hr_armed_us_ = fire_us;
+#endif
+}
+
+void TimerManager::heap_push(TimerNode* timer_node)
+{
+    timer_node->heap_index_ = int(hr_heap_.size());
+    hr_heap_.push_back(timer_node);
+    heap_sift_up(timer_node->heap_index_);
+}
+
+void TimerManager::heap_remove(TimerNode* timer_node)
+{
+    int idx = timer_node->heap_index_;
+    int last = int(hr_heap_.size()) - 1;
+    if(idx != last) {
+        hr_heap_[idx] = hr_heap_[last];
+        hr_heap_[idx]->heap_index_ = idx;
+    }
+    hr_heap_.pop_back();
+    timer_node->heap_index_ = -1;
+    if(idx < last) {
+        heap_sift_down(idx);
+        heap_sift_up(idx);
+    }
+}
+
+void TimerManager::heap_sift_up(int idx)
+{
+    TimerNode* timer_node = hr_heap_[idx];
+    while(idx > 0) {
+        int parent = (idx - 1) / 2;
+        if(hr_heap_[parent]->fire_us_ <= timer_node->fire_us_) {
+            break;
         }
-        running_mutex_.unlock();
+        hr_heap_[idx] = hr_heap_[parent];
+        hr_heap_[idx]->heap_index_ = idx;
+        idx = parent;
     }
-    // check again for reschedule timer
-    if(!cancelled && (reschedule_node_ == timer_node || isTimerPending(timer_node))) {
-        mutex_.lock();
-        if(isTimerPending(timer_node)) {
-            removeTimer(timer_node);
+    hr_heap_[idx] = timer_node;
+    timer_node->heap_index_ = idx;
+}
+
+void TimerManager::heap_sift_down(int idx)
+{
+    int size = int(hr_heap_.size());
+    TimerNode* timer_node = hr_heap_[idx];
+    while(true) {
+        int child = 2 * idx + 1;
+        if(child >= size) {
+            break;
+        }
+        if(child + 1 < size && hr_heap_[child + 1]->fire_us_ < hr_heap_[child]->fire_us_) {
+            ++child;
         }
-        if(reschedule_node_ == timer_node) {
-            reschedule_node_ = nullptr;
+        if(timer_node->fire_us_ <= hr_heap_[child]->fire_us_) {
+            break;
         }
-        mutex_.unlock();
+        hr_heap_[idx] = hr_heap_[child];
+        hr_heap_[idx]->heap_index_ = idx;
+        idx = child;
     }
+    hr_heap_[idx] = timer_node;
+    timer_node->heap_index_ = idx;
 }
 
 void TimerManager::list_init_head(TimerNode* head)
@@ -315,6 +570,10 @@ bool TimerManager::addTimer(TimerNode* timer_node, FROM from)
 
 void TimerManager::removeTimer(TimerNode* timer_node)
 {
+    if(timer_node->heap_index_ >= 0) {
+        heap_remove(timer_node);
+        return ;
+    }
     if(0 == timer_node->tv_index_
        && timer_node->next_ != timer_node
        && timer_node->next_ == timer_node->prev_
@@ -346,6 +605,24 @@ int TimerManager::cascadeTimer(int tv_idx, int tl_idx)
 
 #define INDEX(N) ((next_jiffies >> ((N+1) * TIMER_VECTOR_BITS)) & TIMER_VECTOR_MASK)
 int TimerManager::checkExpire(unsigned long* remain_ms)
+{
+    int count = runHighResTimers() + checkWheelExpire(remain_ms);
+    if(count > 0) {
+        fired_count_.store(fired_count_.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+    if(remain_ms && hr_fd_ == INVALID_FD && !hr_heap_.empty()) {
+        // no timerfd, poll wait time is rounded up to milliseconds
+        uint64_t now_us = get_tick_count_us();
+        uint64_t fire_us = hr_heap_[0]->fire_us_;
+        unsigned long hr_remain_ms = fire_us > now_us ? (unsigned long)((fire_us - now_us + 999) / 1000) : 0;
+        if(hr_remain_ms < *remain_ms) {
+            *remain_ms = hr_remain_ms;
+        }
+    }
+    return count;
+}
+
+int TimerManager::checkWheelExpire(unsigned long* remain_ms)
 {
     if(0 == timer_count_) {
         last_remain_ms_ = -1;
@@ -360,9 +637,7 @@ int TimerManager::checkExpire(unsigned long* remain_ms)
                 *remain_ms = last_remain_ms_;
             } else {
                 // calc remain time in ms
-                mutex_.lock();
                 int pos = find_first_set_in_bitmap(now_tick & TIMER_VECTOR_MASK);
-                mutex_.unlock();
                 *remain_ms = -1==pos?256:pos;
                 last_remain_ms_ = *remain_ms;
             }
@@ -375,7 +650,6 @@ int TimerManager::checkExpire(unsigned long* remain_ms)
     TICK_COUNT_TYPE last_tick = now_tick;
     TimerNode tmp_head;
     list_init_head(&tmp_head);
-    mutex_.lock();
     while(cur_jiffies >= next_jiffies)
     {
         int idx = next_jiffies & TIMER_VECTOR_MASK;
@@ -407,35 +681,32 @@ int TimerManager::checkExpire(unsigned long* remain_ms)
     
     while(!list_empty(&tmp_head))
     {
-        running_node_ = tmp_head.next_;
-        if(!running_node_->cancelled_ && running_node_->repeating_) {
-            reschedule_node_ = running_node_;
+        TimerNode* timer_node = tmp_head.next_;
+        running_node_ = timer_node;
+        if(timer_node->repeating_) {
+            reschedule_node_ = timer_node;
         }
-        list_remove_node(running_node_);
+        list_remove_node(timer_node);
         --timer_count_;
-        mutex_.unlock(); // sync nodes in tmp_list with cancel_timer.
         TICK_COUNT_TYPE now_ms = 0;
         if (reschedule_node_) {
             now_ms = get_tick_count_ms();
         }
-        running_mutex_.lock();
-        if(running_node_) {
-            if(running_node_->timer_) {
-                running_node_->timer_->cb_();
-                ++count;
-            }
-        } else { // this timer is cancelled
-            reschedule_node_ = nullptr;
+        if(timer_node->timer_) {
+            timer_node->timer_->cb_();
+            ++count;
+        }
+        // running_node_ is reset if the timer is cancelled or destroyed in callback
+        if(running_node_ && !timer_node->repeating_ && !isTimerPending(timer_node)) {
+            timer_node->armed_.store(false, std::memory_order_relaxed);
         }
         running_node_ = nullptr;
-        running_mutex_.unlock();
         
-        mutex_.lock();
         if(reschedule_node_ && !reschedule_node_->cancelled_ && !isTimerPending(reschedule_node_)) {
             reschedule_node_->start_tick_ = now_ms;//get_tick_count_ms();
             addTimer(reschedule_node_, FROM_RESCHEDULE);
-            reschedule_node_ = nullptr;
         }
+        reschedule_node_ = nullptr;
     }
 
     if(remain_ms) {
@@ -444,7 +715,6 @@ int TimerManager::checkExpire(unsigned long* remain_ms)
         *remain_ms = -1==pos?256:pos;
     }
 
-    mutex_.unlock();
     if(remain_ms) { // revise the remain time
         now_tick = get_tick_count_ms();
         delta_tick = calc_time_elapse_delta_ms(now_tick, last_tick);
@@ -27,7 +27,8 @@
 #include "util/util.h"
 
 #include <memory>
-#include <mutex>
+#include <atomic>
+#include <vector>
 
 #ifndef TICK_COUNT_TYPE
 # define TICK_COUNT_TYPE    uint64_t
@@ -35,21 +36,36 @@
 
 KUMA_NS_BEGIN
 
+class EventLoopToken;
+
 #define TIMER_VECTOR_BITS   8
 #define TIMER_VECTOR_SIZE   (1 << TIMER_VECTOR_BITS)
 #define TIMER_VECTOR_MASK   (TIMER_VECTOR_SIZE - 1)
 #define TV_COUNT            4
 
+/* the timer wheel is only accessed in loop thread, so there is no lock.
+ * scheduleTimer from other thread is posted to loop with the token of timer, cancelTimer
+ * from other thread waits until the timer is cancelled in loop thread, or cancels the
+ * posted task if loop is stopped.
+ * the high resolution timers are kept in a min heap ordered by fire time in
+ * microseconds, they are fired by a timerfd on linux
+ */
 class TimerManager
 {
 public:
+    using TimerCallback = Timer::TimerCallback;
+    
     TimerManager(EventLoop::Impl* loop);
     ~TimerManager();
 
-    bool scheduleTimer(Timer::Impl* timer, uint32_t delay_ms, TimerMode mode);
+    bool scheduleTimer(Timer::Impl* timer, uint32_t delay_ms, TimerMode mode, TimerCallback cb);
+    bool scheduleHighResTimer(Timer::Impl* timer, uint32_t delay_us, TimerMode mode, TimerCallback cb);
     void cancelTimer(Timer::Impl* timer);
+    KMError enableHighResTimer();
 
     int checkExpire(unsigned long* remain_ms = nullptr);
+    // number of the timers fired, it can be read in any thread
+    uint64_t getFiredCount() const { return fired_count_.load(std::memory_order_relaxed); }
 
 public:
     class TimerNode
@@ -69,16 +85,29 @@ public:
         uint32_t        delay_ms_{ 0 };
         TICK_COUNT_TYPE start_tick_{ 0 };
         Timer::Impl*    timer_{ nullptr };
+        bool            high_res_{ false };
+        uint32_t        delay_us_{ 0 };
+        uint64_t        fire_us_{ 0 };
+        // scheduled and not fired or cancelled yet, it can be read in any thread
+        std::atomic<bool> armed_{ false };
         
     protected:
         friend class TimerManager;
         int tv_index_{ -1 };
         int tl_index_{ -1 };
+        int heap_index_{ -1 }; // index in high resolution timer heap
         TimerNode* prev_{ nullptr };
         TimerNode* next_{ nullptr };
     };
     
 private:
+    bool scheduleTimer_i(Timer::Impl* timer, uint32_t delay_ms, TimerMode mode, TimerCallback &cb);
+    bool scheduleHighResTimer_i(Timer::Impl* timer, uint32_t delay_us, TimerMode mode, TimerCallback &cb);
+    void cancelTimer_i(Timer::Impl* timer);
+    void enableHighResTimer_i();
+    // the token that the tasks posted for timer are bound to
+    EventLoopToken* getLoopToken(Timer::Impl* timer);
+    
     typedef enum {
         FROM_SCHEDULE,
         FROM_CASCADE,
@@ -89,8 +118,17 @@ private:
     int cascadeTimer(int tv_idx, int tl_idx);
     bool isTimerPending(TimerNode* timer_node)
     {
-        return timer_node->next_ != nullptr;
+        return timer_node->next_ != nullptr || timer_node->heap_index_ >= 0;
     }
+    
+    int checkWheelExpire(unsigned long* remain_ms);
+    int runHighResTimers();
+    void updateHighResTimer();
+    void onHighResTimer();
+    void heap_push(TimerNode* timer_node);
+    void heap_remove(TimerNode* timer_node);
+    void heap_sift_up(int idx);
+    void heap_sift_down(int idx);
 
     void list_init_head(TimerNode* head);
     void list_add_node(TimerNode* head, TimerNode* timer_node);
@@ -104,12 +142,7 @@ private:
     int find_first_set_in_bitmap(int idx);
 
 private:
-    typedef std::recursive_mutex KM_Mutex;
-    typedef std::lock_guard<KM_Mutex> KM_Lock_Guard;
-    
     EventLoop::Impl* loop_;
-    KM_Mutex mutex_;
-    KM_Mutex running_mutex_;
     TimerNode*  running_node_{ nullptr };
     TimerNode*  reschedule_node_{ nullptr };
     unsigned long last_remain_ms_ = -1;
@@ -117,6 +150,13 @@ private:
     uint32_t timer_count_{ 0 };
     uint32_t tv0_bitmap_[8]; // 1 -- have timer in this slot
     TimerNode tv_[TV_COUNT][TIMER_VECTOR_SIZE]; // timer vectors
+    
+    bool hr_enabled_{ false };
+    SOCKET_FD hr_fd_{ INVALID_FD }; // timerfd, or INVALID_FD if loop wait time is used
+    uint64_t hr_armed_us_{ 0 }; // fire time the timerfd is armed to
+    std::vector<TimerNode*> hr_heap_;
+    
+    std::atomic<uint64_t> fired_count_{ 0 }; // written in loop thread only
 };
 typedef std::shared_ptr<TimerManager> TimerManagerPtr;
 
@@ -129,6 +169,7 @@ public:
     ~Impl();
     
     bool schedule(uint32_t delay_ms, TimerCallback cb, TimerMode mode);
+    bool scheduleUs(uint32_t delay_us, TimerCallback cb, TimerMode mode);
     void cancel();
     
 private:
@@ -136,6 +177,7 @@ private:
     TimerCallback cb_;
     std::weak_ptr<TimerManager> timer_mgr_;
     TimerManager::TimerNode timer_node_; // intrusive list node
+    std::unique_ptr<EventLoopToken> loop_token_; // created by cross thread schedule
 };
 
 KUMA_NS_END
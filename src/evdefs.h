@@ -29,6 +29,7 @@
 # include <sys/socket.h>
 #endif
 #include <functional>
+#include <stdint.h>
 
 KUMA_NS_BEGIN
 
@@ -59,7 +60,8 @@ enum class PollType {
     KQUEUE,
     SELECT,
     IOCP,
-    WIN
+    WIN,
+    IO_URING
 };
 
 KUMA_NS_END
@@ -148,7 +148,7 @@ bool Http1xRequest::processHttpCache()
 
 int Http1xRequest::sendData(const void* data, size_t len)
 {
-    if(!sendBufferEmpty() || getState() != State::SENDING_BODY) {
+    if(sendQueueFull() || getState() != State::SENDING_BODY) {
         return 0;
     }
     auto ret = req_message_.sendData(data, len);
@@ -164,7 +164,7 @@ int Http1xRequest::sendData(const void* data, size_t len)
 
 int Http1xRequest::sendData(const KMBuffer &buf)
 {
-    if(!sendBufferEmpty() || getState() != State::SENDING_BODY) {
+    if(sendQueueFull() || getState() != State::SENDING_BODY) {
         return 0;
     }
     auto ret = req_message_.sendData(buf);
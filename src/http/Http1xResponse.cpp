@@ -40,6 +40,9 @@ Http1xResponse::Http1xResponse(const EventLoopPtr &loop, std::string ver)
     });
     rsp_message_.setBSender([this] (const KMBuffer &buf) -> int {
         return TcpConnection::send(buf);
+    });
+    rsp_message_.setFSender([this] (int fd, int64_t offset, size_t len) -> int {
+        return TcpConnection::sendFile(fd, offset, len);
     });
     KM_SetObjKey("Http1xResponse");
 }
@@ -130,7 +133,7 @@ KMError Http1xResponse::sendResponse(int status_code, const std::string& desc, c
 
 int Http1xResponse::sendData(const void* data, size_t len)
 {
-    if(!sendBufferEmpty() || getState() != State::SENDING_BODY) {
+    if(sendQueueFull() || getState() != State::SENDING_BODY) {
         return 0;
     }
     int ret = rsp_message_.sendData(data, len);
@@ -147,7 +150,7 @@ int Http1xResponse::sendData(const void* data, size_t len)
 
 int Http1xResponse::sendData(const KMBuffer &buf)
 {
-    if(!sendBufferEmpty() || getState() != State::SENDING_BODY) {
+    if(sendQueueFull() || getState() != State::SENDING_BODY) {
         return 0;
     }
     int ret = rsp_message_.sendData(buf);
@@ -162,6 +165,23 @@ int Http1xResponse::sendData(const KMBuffer &buf)
     return ret;
 }
 
+int Http1xResponse::sendFile(int fd, int64_t offset, size_t len)
+{
+    if(sendQueueFull() || getState() != State::SENDING_BODY) {
+        return 0;
+    }
+    int ret = rsp_message_.sendFile(fd, offset, len);
+    if(ret < 0) {
+        setState(State::IN_ERROR);
+    } else if(ret >= 0) {
+        if (rsp_message_.isCompleted() && sendBufferEmpty()) {
+            setState(State::COMPLETE);
+            eventLoop()->post([this] { notifyComplete(); }, &loop_token_);
+        }
+    }
+    return ret;
+}
+
 void Http1xResponse::reset()
 {
     // reset TcpConnection
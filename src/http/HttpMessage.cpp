@@ -20,6 +20,7 @@
  */
 
 #include "HttpMessage.h"
+#include "util/util.h"
 #include <sstream>
 
 using namespace kuma;
@@ -61,6 +62,32 @@ int HttpMessage::sendData(const KMBuffer &buf)
     return ret;
 }
 
+int HttpMessage::sendFile(int fd, int64_t offset, size_t len)
+{
+    if(0 == len) {
+        return 0;
+    }
+    if(is_chunked_ || !fsender_) {
+        // the chunk header and trailer are sent with the mapping of file, one chunk per call
+        if(len > KM_FILE_CHUNK_SIZE) {
+            len = KM_FILE_CHUNK_SIZE;
+        }
+        KMBuffer::Ptr buf(km_map_file(fd, offset, len));
+        if(!buf) {
+            return -1;
+        }
+        return sendData(*buf);
+    }
+    int ret = fsender_(fd, offset, len);
+    if(ret > 0) {
+        body_bytes_sent_ += ret;
+        if (body_bytes_sent_ >= content_length_) {
+            completed_ = true;
+        }
+    }
+    return ret;
+}
+
 int HttpMessage::sendChunk(const void* data, size_t len)
 {
     if(nullptr == data && 0 == len) { // chunk end
@@ -71,6 +98,9 @@ int HttpMessage::sendChunk(const void* data, size_t len)
             return 0;
         }
         return ret;
+    } else if(len > INT_MAX) {
+        // the bytes sent cannot be returned
+        return -1;
     } else {
         std::stringstream ss;
         ss << std::hex << len;
@@ -104,6 +134,9 @@ int HttpMessage::sendChunk(const KMBuffer &buf)
             return 0;
         }
         return ret;
+    } else if(chain_len > INT_MAX) {
+        // the bytes sent cannot be returned
+        return -1;
     } else {
         std::stringstream ss;
         ss << std::hex << chain_len;
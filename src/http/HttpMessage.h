@@ -35,15 +35,18 @@ public:
     using MessageSender = std::function<int(const void*, size_t)>;
     using MessageVSender = std::function<int(const iovec*, int)>;
     using MessageBSender = std::function<int(const KMBuffer&)>;
+    using MessageFSender = std::function<int(int, int64_t, size_t)>;
     
     int sendData(const void* data, size_t len);
     int sendData(const KMBuffer &buf);
+    int sendFile(int fd, int64_t offset, size_t len);
     bool isCompleted() const { return !hasBody() || completed_; }
     void reset() override;
     
     void setSender(MessageSender sender) { sender_ = std::move(sender); }
     void setVSender(MessageVSender sender) { vsender_ = std::move(sender); }
     void setBSender(MessageBSender sender) { bsender_ = std::move(sender); }
+    void setFSender(MessageFSender sender) { fsender_ = std::move(sender); }
     
 protected:
     int sendChunk(const void* data, size_t len);
@@ -56,6 +59,7 @@ protected:
     MessageSender           sender_;
     MessageVSender          vsender_;
     MessageBSender          bsender_;
+    MessageFSender          fsender_;
 };
 
 KUMA_NS_END
@@ -22,6 +22,7 @@
 #include "HttpResponseImpl.h"
 #include "EventLoopImpl.h"
 #include "util/kmtrace.h"
+#include "util/util.h"
 
 #include <iterator>
 
@@ -73,6 +74,23 @@ int HttpResponse::Impl::sendData(const KMBuffer &buf)
     return bytes_sent;
 }
 */
+int HttpResponse::Impl::sendFile(int fd, int64_t offset, size_t len)
+{
+    if (0 == len) {
+        return 0;
+    }
+    // the mapping of one chunk is sent per call, the rest is sent again in write callback
+    if (len > KM_FILE_CHUNK_SIZE) {
+        len = KM_FILE_CHUNK_SIZE;
+    }
+    KMBuffer::Ptr buf(km_map_file(fd, offset, len));
+    if (!buf) {
+        KUMA_ERRTRACE("sendFile, failed to map file, fd=" << fd << ", offset=" << offset << ", len=" << len);
+        return -1;
+    }
+    return sendData(*buf);
+}
+
 void HttpResponse::Impl::reset()
 {
     
@@ -51,6 +51,8 @@ public:
     KMError sendResponse(int status_code, const std::string& desc);
     virtual int sendData(const void* data, size_t len) = 0;
     virtual int sendData(const KMBuffer &buf) = 0;
+    // the mapping of file is sent by sendData by default
+    virtual int sendFile(int fd, int64_t offset, size_t len);
     virtual void reset();
     virtual KMError close() = 0;
     
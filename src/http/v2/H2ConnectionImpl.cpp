@@ -184,6 +184,24 @@ KMError H2Connection::Impl::close()
     return KMError::NOERR;
 }
 
+KMError H2Connection::Impl::migrate(const EventLoopPtr &loop)
+{
+    // the streams are bound to HttpResponse or HttpRequest of current loop, and the
+    // connections managed by H2ConnectionMgr are shared by the requests of current loop
+    if (getState() != State::OPEN || !key_.empty() ||
+        !streams_.empty() || !promised_streams_.empty() || !push_clients_.empty()) {
+        return KMError::INVALID_STATE;
+    }
+    auto ret = tcp_.checkMigrate(loop);
+    if (ret != KMError::NOERR || loop == eventLoop()) {
+        return ret;
+    }
+    loop_token_.reset();
+    loop_token_.eventLoop(loop);
+    thread_id_ = loop->threadId();
+    return TcpConnection::migrate(loop);
+}
+
 KMError H2Connection::Impl::sendH2Frame(H2Frame *frame)
 {
     if (!sendBufferEmpty() && !isControlFrame(frame) && 
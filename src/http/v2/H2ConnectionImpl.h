@@ -60,6 +60,7 @@ public:
     KMError attachStream(uint32_t stream_id, HttpResponse::Impl* rsp);
     PushClient* getPushClient(const std::string &cache_key);
     KMError close();
+    KMError migrate(const EventLoopPtr &loop);
     void setAcceptCallback(AcceptCallback cb) { accept_cb_ = std::move(cb); }
     void setErrorCallback(ErrorCallback cb) { error_cb_ = std::move(cb); }
     void addConnectListener(long uid, ConnectCallback cb);
@@ -102,14 +102,14 @@ public:
         }
     }
 
-    bool registerFd(const EventLoopPtr &loop, SOCKET_FD fd)
+    bool registerFd(const EventLoopPtr &loop, SOCKET_FD fd, const KMObject *obj=nullptr)
     {
         if (!loop || fd == INVALID_FD) {
             return false;
         }
         if (loop->registerFd(fd, KUMA_EV_NETWORK, [this](KMEvent ev, void* ol, size_t io_size) {
             ioReady(ev, ol, io_size);
-        }) == KMError::NOERR)
+        }, obj) == KMError::NOERR)
         {
             return true;
         }
@@ -48,7 +48,7 @@ IocpAcceptor::~IocpAcceptor()
 
 bool IocpAcceptor::registerFd(SOCKET_FD fd)
 {
-    return IocpBase::registerFd(loop_.lock(), fd);
+    return IocpBase::registerFd(loop_.lock(), fd, this);
 }
 
 void IocpAcceptor::unregisterFd(SOCKET_FD fd, bool close_fd)
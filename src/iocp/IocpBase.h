@@ -36,9 +36,9 @@ public:
 
     virtual ~IocpBase() {}
 
-    bool registerFd(const EventLoopPtr &loop, SOCKET_FD fd)
+    bool registerFd(const EventLoopPtr &loop, SOCKET_FD fd, const KMObject *obj=nullptr)
     {
-        registered_ = iocp_ctx_->registerFd(loop, fd);
+        registered_ = iocp_ctx_->registerFd(loop, fd, obj);
         return registered_;
     }
 
@@ -48,12 +48,21 @@ SOCKET_FD IocpSocket::createFd(int addr_family)
 
 bool IocpSocket::registerFd(SOCKET_FD fd)
 {
-    return IocpBase::registerFd(loop_.lock(), fd);
+    auto loop = loop_.lock();
+    if (!IocpBase::registerFd(loop, fd, this)) {
+        return false;
+    }
+    loop->addConnection();
+    return true;
 }
 
 void IocpSocket::unregisterFd(SOCKET_FD fd, bool close_fd)
 {
-    IocpBase::unregisterFd(loop_.lock(), fd, close_fd);
+    auto loop = loop_.lock();
+    if (loop && IocpBase::registered_) {
+        loop->removeConnection();
+    }
+    IocpBase::unregisterFd(loop, fd, close_fd);
 }
 
 KMError IocpSocket::connect_i(const sockaddr_storage &ss_addr, uint32_t timeout_ms)
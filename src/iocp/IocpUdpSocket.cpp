@@ -80,7 +80,7 @@ IocpUdpSocket::~IocpUdpSocket()
 
 bool IocpUdpSocket::registerFd(SOCKET_FD fd)
 {
-    return IocpBase::registerFd(loop_.lock(), fd);
+    return IocpBase::registerFd(loop_.lock(), fd, this);
 }
 
 void IocpUdpSocket::unregisterFd(SOCKET_FD fd, bool close_fd)
@@ -15,6 +15,8 @@ LOCAL_MODULE := kuma
 
 LOCAL_SRC_FILES := \
     EventLoopImpl.cpp \
+    EventLoopGroupImpl.cpp \
+    ThreadPoolImpl.cpp \
     AcceptorBase.cpp \
     SocketBase.cpp \
     UdpSocketBase.cpp \
@@ -27,6 +29,9 @@ LOCAL_SRC_FILES := \
     poll/VPoll.cpp \
     poll/SelectPoll.cpp \
     poll/Notifier.cpp \
+    poll/UringPoll.cpp \
+    uring/UringSocket.cpp \
+    uring/UringAcceptor.cpp \
     http/Uri.cpp \
     http/HttpHeader.cpp \
     http/HttpMessage.cpp \
@@ -20,6 +20,8 @@
  */
 
 #include "EventLoopImpl.h"
+#include "EventLoopGroupImpl.h"
+#include "ThreadPoolImpl.h"
 #include "TcpSocketImpl.h"
 #include "UdpSocketImpl.h"
 #include "TcpListenerImpl.h"
@@ -139,6 +141,11 @@ bool EventLoop::isPollLT() const
     return  pimpl_->isPollLT();
 }
 
+bool EventLoop::inSameThread() const
+{
+    return pimpl_->inSameThread();
+}
+
 KMError EventLoop::registerFd(SOCKET_FD fd, uint32_t events, IOCallback cb)
 {
     return pimpl_->registerFd(fd, events, std::move(cb));
@@ -184,9 +191,59 @@ KMError EventLoop::async(Task task, Token *token)
     return pimpl_->async(std::move(task), token?token->pimpl():nullptr);
 }
 
-KMError EventLoop::post(Task task, Token *token)
+KMError EventLoop::post(Task task, Token *token, TaskPriority priority)
+{
+    return pimpl_->post(std::move(task), token?token->pimpl():nullptr, priority);
+}
+
+KMError EventLoop::postBatch(Task *tasks, size_t count, Token *token, TaskPriority priority)
+{
+    return pimpl_->postBatch(tasks, count, token?token->pimpl():nullptr, priority);
+}
+
+void EventLoop::setTaskTimeBudget(uint32_t budget_ms)
+{
+    pimpl_->setTaskTimeBudget(budget_ms);
+}
+
+KMError EventLoop::enableHighResTimer()
+{
+    return pimpl_->getTimerMgr()->enableHighResTimer();
+}
+
+KMError EventLoop::setPollBatchSize(uint32_t max_events)
+{
+    return pimpl_->setPollBatchSize(max_events);
+}
+
+KMError EventLoop::enablePollDirectItem()
+{
+    return pimpl_->enablePollDirectItem();
+}
+
+void EventLoop::setBusyPoll(uint32_t spin_us, bool sock_busy_poll)
 {
-    return pimpl_->post(std::move(task), token?token->pimpl():nullptr);
+    pimpl_->setBusyPoll(spin_us, sock_busy_poll);
+}
+
+uint64_t EventLoop::getSpinHitCount() const
+{
+    return pimpl_->getSpinHitCount();
+}
+
+uint64_t EventLoop::getBlockingWaitCount() const
+{
+    return pimpl_->getBlockingWaitCount();
+}
+
+EventLoop::Stats EventLoop::getStats() const
+{
+    return pimpl_->getStats();
+}
+
+KMError EventLoop::setWatchdog(uint32_t threshold_ms)
+{
+    return pimpl_->setWatchdog(threshold_ms);
 }
 
 void EventLoop::cancel(Token *token)
@@ -234,6 +291,123 @@ EventLoopToken* EventLoop::Token::pimpl()
     return pimpl_;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+EventLoopGroup::EventLoopGroup(PollType poll_type)
+: pimpl_(new Impl(this, poll_type))
+{
+    
+}
+
+EventLoopGroup::~EventLoopGroup()
+{
+    delete pimpl_;
+}
+
+KMError EventLoopGroup::start(size_t count, bool cpu_affinity)
+{
+    return pimpl_->start(count, cpu_affinity);
+}
+
+void EventLoopGroup::stop()
+{
+    pimpl_->stop();
+}
+
+size_t EventLoopGroup::size() const
+{
+    return pimpl_->size();
+}
+
+EventLoop* EventLoopGroup::getLoop(size_t index)
+{
+    return pimpl_->getLoop(index);
+}
+
+EventLoop* EventLoopGroup::selectLoop()
+{
+    return pimpl_->selectLoop();
+}
+
+void EventLoopGroup::setPolicy(Policy policy)
+{
+    pimpl_->setPolicy(policy);
+}
+
+KMError EventLoopGroup::setSelectCallback(SelectCallback cb)
+{
+    return pimpl_->setSelectCallback(std::move(cb));
+}
+
+size_t EventLoopGroup::getConnectionCount(size_t index) const
+{
+    return pimpl_->getConnectionCount(index);
+}
+
+size_t EventLoopGroup::getPendingTaskCount(size_t index) const
+{
+    return pimpl_->getPendingTaskCount(index);
+}
+
+EventLoopGroup::Impl* EventLoopGroup::pimpl()
+{
+    return pimpl_;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+ThreadPool::ThreadPool()
+: pimpl_(new Impl())
+{
+    
+}
+
+ThreadPool::~ThreadPool()
+{
+    delete pimpl_;
+}
+
+KMError ThreadPool::start(size_t count)
+{
+    return pimpl_->start(count);
+}
+
+void ThreadPool::stop()
+{
+    pimpl_->stop();
+}
+
+size_t ThreadPool::size() const
+{
+    return pimpl_->size();
+}
+
+KMError ThreadPool::post(Task task)
+{
+    return pimpl_->post(std::move(task));
+}
+
+KMError ThreadPool::offload(EventLoop *loop, Task work, Task done, EventLoop::Token *token)
+{
+    if (!loop) {
+        return KMError::INVALID_PARAM;
+    }
+    return pimpl_->offload(EventLoopHelper::implPtr(loop->pimpl()), std::move(work), std::move(done), token ? token->pimpl() : nullptr);
+}
+
+size_t ThreadPool::getPendingTaskCount() const
+{
+    return pimpl_->getPendingTaskCount();
+}
+
+uint64_t ThreadPool::getStolenTaskCount() const
+{
+    return pimpl_->getStolenTaskCount();
+}
+
+ThreadPool::Impl* ThreadPool::pimpl()
+{
+    return pimpl_;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 TcpSocket::TcpSocket(EventLoop* loop)
 : pimpl_(new Impl(EventLoopHelper::implPtr(loop->pimpl())))
@@ -299,6 +473,14 @@ KMError TcpSocket::detachFd(SOCKET_FD &fd)
     return pimpl_->detachFd(fd);
 }
 
+KMError TcpSocket::migrate(EventLoop *loop)
+{
+    if (!loop) {
+        return KMError::INVALID_PARAM;
+    }
+    return pimpl_->migrate(EventLoopHelper::implPtr(loop->pimpl()));
+}
+
 KMError TcpSocket::startSslHandshake(SslRole ssl_role)
 {
 #ifdef KUMA_HAS_OPENSSL
@@ -339,6 +521,11 @@ int TcpSocket::send(const iovec* iovs, int count)
 int TcpSocket::send(const KMBuffer &buf)
 {
     return pimpl_->send(buf);
+}
+
+int TcpSocket::sendFile(int fd, int64_t offset, size_t length)
+{
+    return pimpl_->sendFile(fd, offset, length);
 }
 
 int TcpSocket::receive(void* data, size_t length)
@@ -346,11 +533,26 @@ int TcpSocket::receive(void* data, size_t length)
     return pimpl_->receive(data, length);
 }
 
+int TcpSocket::receive(KMBuffer &buf)
+{
+    return pimpl_->receive(buf);
+}
+
 KMError TcpSocket::close()
 {
     return pimpl_->close();
 }
 
+KMError TcpSocket::setCork(bool enable)
+{
+    return pimpl_->setCork(enable);
+}
+
+bool TcpSocket::getCork() const
+{
+    return pimpl_->getCork();
+}
+
 KMError TcpSocket::pause()
 {
     return pimpl_->pause();
@@ -397,12 +599,12 @@ TcpListener::~TcpListener()
     delete pimpl_;
 }
 
-KMError TcpListener::startListen(const char* host, uint16_t port)
+KMError TcpListener::startListen(const char* host, uint16_t port, uint32_t listen_flags)
 {
     if (!host) {
         return KMError::INVALID_PARAM;
     }
-    return pimpl_->startListen(host, port);
+    return pimpl_->startListen(host, port, listen_flags);
 }
 
 KMError TcpListener::stopListen(const char* host, uint16_t port)
@@ -420,6 +622,26 @@ void TcpListener::setAcceptCallback(AcceptCallback cb)
     pimpl_->setAcceptCallback(std::move(cb));
 }
 
+void TcpListener::setAcceptCallback(EventLoopGroup *group, LoopAcceptCallback cb)
+{
+    pimpl_->setAcceptCallback(group ? group->pimpl() : nullptr, std::move(cb));
+}
+
+void TcpListener::setBacklog(int backlog)
+{
+    pimpl_->setBacklog(backlog);
+}
+
+void TcpListener::setDeferAccept(uint32_t timeout_s)
+{
+    pimpl_->setDeferAccept(timeout_s);
+}
+
+void TcpListener::setFastOpen(int queue_len)
+{
+    pimpl_->setFastOpen(queue_len);
+}
+
 void TcpListener::setErrorCallback(ErrorCallback cb)
 {
     pimpl_->setErrorCallback(std::move(cb));
@@ -430,6 +652,11 @@ TcpListener::Impl* TcpListener::pimpl()
     return pimpl_;
 }
 
+EventLoopPtr getEventLoopPtr(EventLoop::Impl *loop)
+{
+    return EventLoopHelper::implPtr(loop);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 UdpSocket::UdpSocket(EventLoop* loop)
 : pimpl_(new Impl(EventLoopHelper::implPtr(loop->pimpl())))
@@ -529,6 +756,11 @@ void Timer::cancel()
     pimpl_->cancel();
 }
 
+bool Timer::scheduleUs(uint32_t delay_us, TimerCallback cb, TimerMode mode)
+{
+    return pimpl_->scheduleUs(delay_us, std::move(cb), mode);
+}
+
 Timer::Impl* Timer::pimpl()
 {
     return pimpl_;
@@ -851,6 +1083,11 @@ int HttpResponse::sendData(const KMBuffer &buf)
     return pimpl_->sendData(buf);
 }
 
+int HttpResponse::sendFile(int fd, int64_t offset, size_t len)
+{
+    return pimpl_->sendFile(fd, offset, len);
+}
+
 void HttpResponse::reset()
 {
     pimpl_->reset();
@@ -1000,11 +1237,24 @@ int WebSocket::send(const KMBuffer &buf, bool is_text, bool fin)
     return pimpl_->send(buf, is_text, fin);
 }
 
+void WebSocket::setSendWatermarks(size_t high, size_t low)
+{
+    pimpl_->setSendWatermarks(high, low);
+}
+
 KMError WebSocket::close()
 {
     return pimpl_->close();
 }
 
+KMError WebSocket::migrate(EventLoop *loop)
+{
+    if (!loop) {
+        return KMError::INVALID_PARAM;
+    }
+    return pimpl_->migrate(EventLoopHelper::implPtr(loop->pimpl()));
+}
+
 void WebSocket::setDataCallback(DataCallback cb)
 {
     pimpl_->setDataCallback(std::move(cb));
@@ -1070,6 +1320,14 @@ KMError H2Connection::close()
     return pimpl_->close();
 }
 
+KMError H2Connection::migrate(EventLoop *loop)
+{
+    if (!loop) {
+        return KMError::INVALID_PARAM;
+    }
+    return pimpl_->migrate(EventLoopHelper::implPtr(loop->pimpl()));
+}
+
 void H2Connection::setAcceptCallback(AcceptCallback cb)
 {
     pimpl_->setAcceptCallback(std::move(cb));
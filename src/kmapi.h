@@ -25,8 +25,10 @@
 #include "kmdefs.h"
 #include "evdefs.h"
 #include "kmbuffer.h"
+#include "kmtask.h"
 
 #include <stdint.h>
+#include <vector>
 #ifdef KUMA_OS_WIN
 # include <Ws2tcpip.h>
 #else
@@ -41,7 +43,7 @@ class EventLoopToken;
 class KUMA_API EventLoop
 {
 public:
-    using Task = std::function<void(void)>;
+    using Task = KMTask; // move-only, small callable is stored inline
     
     class Token {
     public:
@@ -61,6 +63,27 @@ public:
         EventLoopToken* pimpl_;
     };
     
+    /* runtime statistics of the loop since it was created. the counters are updated
+     * by loop thread without lock, so a snapshot may be slightly inconsistent.
+     * histogram bucket 0 counts the value 0, and bucket i counts [2^(i-1), 2^i),
+     * the last bucket also counts the larger values
+     */
+    struct Stats {
+        enum { HISTOGRAM_BUCKETS = 16 };
+        uint64_t iterations = 0;        // loop iterations
+        uint64_t wait_us = 0;           // time blocked in poll wait, I/O callbacks excluded
+        uint64_t task_us = 0;           // time spent on tasks
+        uint64_t tasks_executed = 0;
+        uint64_t max_pending_tasks = 0; // high-water mark of the task queues
+        uint64_t timers_fired = 0;
+        uint64_t io_events = 0;         // I/O events returned by poll wait
+        uint64_t max_callback_us = 0;   // longest single task or I/O callback
+        uint64_t notifies = 0;          // notifications that woke up poll wait
+        uint64_t notifies_suppressed = 0; // notifications coalesced while loop is awake
+        uint64_t events_per_wait[HISTOGRAM_BUCKETS] = {0};
+        uint64_t callback_us[HISTOGRAM_BUCKETS] = {0}; // time of each task or I/O callback
+    };
+    
 public:
     EventLoop(PollType poll_type = PollType::NONE);
     ~EventLoop();
@@ -109,8 +132,27 @@ public:
      * @param task the task to be executed. it will always be executed when call success
      * @param token to be used to cancel the task. If token is null, the caller should
      *              make sure the resources referenced by task are valid when task running
+     * @param priority URGENT tasks run first in each loop iteration, IDLE tasks run only
+     *                 when there is no other task and no timer is due
+     */
+    KMError post(Task task, Token *token=nullptr, TaskPriority priority=TaskPriority::NORMAL);
+    
+    /* run the tasks in loop thread at next time. the tasks are queued in order
+     * with one wakeup of the loop, and are moved from the array when call success
+     *
+     * @param tasks the tasks to be executed. they will always be executed when call success
+     * @param count number of the tasks
+     * @param token to be used to cancel all the tasks of this batch. If token is null, the caller
+     *              should make sure the resources referenced by tasks are valid when tasks running
+     * @param priority priority of all the tasks of this batch
      */
-    KMError post(Task task, Token *token=nullptr);
+    KMError postBatch(Task *tasks, size_t count, Token *token=nullptr,
+                      TaskPriority priority=TaskPriority::NORMAL);
+    KMError postBatch(std::vector<Task> &tasks, Token *token=nullptr,
+                      TaskPriority priority=TaskPriority::NORMAL)
+    {
+        return postBatch(tasks.data(), tasks.size(), token, priority);
+    }
     
     /* cancel the tasks that are scheduled with token. you cannot cancel the task that is in running,
      * but will wait untill the task completion
@@ -119,6 +161,49 @@ public:
      */
     void cancel(Token *token);
     
+    /* max time spent on NORMAL and IDLE tasks in one loop iteration, the remaining
+     * tasks will be run after I/O is polled. 0 means no limit, default is 10 ms
+     */
+    void setTaskTimeBudget(uint32_t budget_ms);
+    
+    /* enable microsecond resolution for Timer::scheduleUs. on linux the high resolution
+     * timers are fired by a timerfd, on other platforms the poll wait time is rounded up
+     * to milliseconds. the timers scheduled by Timer::schedule are not affected
+     */
+    KMError enableHighResTimer();
+    
+    /* max number of I/O events handled in one poll wait, 0 means default (500). the batch
+     * doubles when a wait fills it and halves when a wait uses less than a quarter of it.
+     * call it before init or in loop thread. only epoll supports it now
+     */
+    KMError setPollBatchSize(uint32_t max_events);
+    
+    /* the poll item is stored in the kernel event, so the I/O events are dispatched without
+     * looking up the fd table. it must be called before init. only epoll supports it now
+     */
+    KMError enablePollDirectItem();
+    
+    /* spin with non-blocking poll for up to spin_us microseconds before blocking in poll,
+     * so the I/O events and tasks arrived in spin time are handled without the wakeup
+     * latency, at the cost of CPU. with sock_busy_poll, SO_BUSY_POLL is set to spin_us on
+     * the fds registered afterwards (linux only, may need CAP_NET_ADMIN). 0 disables it
+     */
+    void setBusyPoll(uint32_t spin_us, bool sock_busy_poll=false);
+    // the spins that got I/O events or tasks, and the waits that blocked in poll
+    uint64_t getSpinHitCount() const;
+    uint64_t getBlockingWaitCount() const;
+    
+    /* snapshot of the runtime statistics, can be called in any thread
+     */
+    Stats getStats() const;
+    
+    /* report the I/O callback, task or timer that runs longer than threshold_ms through
+     * the trace function, with the object id of the socket if it is I/O callback, which
+     * is the suffix of the socket key in the traces. the loops
+     * are checked by a watchdog thread shared by them. 0 disables it
+     */
+    KMError setWatchdog(uint32_t threshold_ms);
+    
     void loopOnce(uint32_t max_wait_ms);
     void loop(uint32_t max_wait_ms = -1);
     void stop();
@@ -130,6 +215,99 @@ private:
     Impl* pimpl_;
 };
 
+/* EventLoopGroup owns a number of EventLoops, each one runs in its own thread
+ */
+class KUMA_API EventLoopGroup
+{
+public:
+    enum class Policy {
+        ROUND_ROBIN,
+        LEAST_CONNECTIONS,      // least TCP connections registered in loop
+        LEAST_PENDING_TASKS,
+    };
+    // return the index of selected loop
+    using SelectCallback = std::function<size_t(EventLoopGroup*)>;
+    
+    EventLoopGroup(PollType poll_type = PollType::NONE);
+    ~EventLoopGroup();
+    
+    /* start the loops and wait untill all of them are initialized
+     *
+     * @param count number of loops, 0 means the number of CPUs
+     * @param cpu_affinity bind the thread of loop i to CPU (i % number of CPUs)
+     */
+    KMError start(size_t count, bool cpu_affinity=false);
+    void stop();
+    
+    size_t size() const;
+    EventLoop* getLoop(size_t index);
+    
+    /* select a loop by select callback if it is set, otherwise by policy
+     */
+    EventLoop* selectLoop();
+    void setPolicy(Policy policy);
+    /* the callback is read by the threads that select loop without lock, so it can
+     * only be set before start, otherwise INVALID_STATE is returned
+     */
+    KMError setSelectCallback(SelectCallback cb);
+    
+    size_t getConnectionCount(size_t index) const;
+    size_t getPendingTaskCount(size_t index) const;
+    
+    class Impl;
+    Impl* pimpl();
+    
+private:
+    Impl* pimpl_;
+};
+
+/* ThreadPool runs the CPU bound work out of EventLoop. each worker has its own task
+ * deque, and steals the tasks of other workers when it has no task
+ */
+class KUMA_API ThreadPool
+{
+public:
+    using Task = KMTask;
+    
+    ThreadPool();
+    ~ThreadPool();
+    
+    /* @param count number of workers, 0 means the number of CPUs
+     */
+    KMError start(size_t count);
+    /* wait for the running tasks, the tasks not run are discarded and their continuations
+     * are cancelled. it must not be called in worker thread
+     */
+    void stop();
+    size_t size() const;
+    
+    /* run the task in a worker thread. the task posted in worker thread is queued to the
+     * same worker
+     */
+    KMError post(Task task);
+    
+    /* run work in a worker thread, and then run done in the thread of loop.
+     * done is bound to token when it is called, if the token is cancelled before done runs,
+     * e.g. the connection is closed, done is dropped and work is skipped if not started.
+     * work should not reference the resources that are released on token cancelled
+     *
+     * @param loop the loop to run done
+     * @param work the work to be run in worker thread
+     * @param done the continuation, can be empty
+     * @param token the token of loop to cancel done
+     */
+    KMError offload(EventLoop *loop, Task work, Task done, EventLoop::Token *token=nullptr);
+    
+    size_t getPendingTaskCount() const;
+    uint64_t getStolenTaskCount() const;
+    
+    class Impl;
+    Impl* pimpl();
+    
+private:
+    Impl* pimpl_;
+};
+
 class KUMA_API TcpSocket
 {
 public:
@@ -154,10 +332,36 @@ public:
     int send(const void* data, size_t length);
     int send(const iovec* iovs, int count);
     int send(const KMBuffer &buf);
+    /**
+     * send length bytes of file fd from offset. it is sent by sendfile on plain TCP, and
+     * from the mapping of the file with SSL. return the bytes sent, it is less than length
+     * only if the socket is write blocked, and the write callback will be called.
+     * length is truncated to INT_MAX, -1 is returned on error or if the range is out of file.
+     * the file must not be truncated while it is being sent, the access to the mapping of
+     * the truncated range raises SIGBUS
+     */
+    int sendFile(int fd, int64_t offset, size_t length);
     int receive(void* data, size_t length);
+    /**
+     * receive data into buf, return the bytes received. with io_uring poll, buf references
+     * the buffer received by kernel without copy, and the buffer is returned to the loop
+     * once buf and its copies are released
+     */
+    int receive(KMBuffer &buf);
     
     KMError close();
     
+    /**
+     * cork mode, the small data sent in one loop iteration are copied to the cork buffer
+     * and written out by one send call before the loop waits for I/O or after the I/O
+     * events are dispatched. the corked data is written out immediately when it reaches
+     * 64KB, or when cork mode is disabled. send returns the length corked, and returns
+     * 0 when the corked data is write blocked, the write callback will be called after
+     * the corked data is sent out. it must be called in the thread of the loop
+     */
+    KMError setCork(bool enable);
+    bool getCork() const;
+    
     KMError pause();
     KMError resume();
     
@@ -169,6 +373,15 @@ public:
     
     SOCKET_FD getFd() const;
     
+    /* move the open socket to loop, e.g. to rebalance the loops of EventLoopGroup. the fd is
+     * unregistered from current loop and attached in the thread of target loop, the SSL state
+     * is kept. it must be called in the thread of current loop, and the socket must be used
+     * in the thread of target loop after it returns, where the callbacks will be called.
+     * the loops must have the same poll type. UNSUPPORT is returned on IOCP and io_uring,
+     * since their pending operations cannot be moved to another loop
+     */
+    KMError migrate(EventLoop *loop);
+    
     class Impl;
     Impl* pimpl();
     
@@ -180,16 +393,37 @@ class KUMA_API TcpListener
 {
 public:
     using AcceptCallback = std::function<bool(SOCKET_FD, const char*, uint16_t)>;
+    using LoopAcceptCallback = std::function<bool(EventLoop*, SOCKET_FD, const char*, uint16_t)>;
     using ErrorCallback = std::function<void(KMError)>;
     
     TcpListener(EventLoop* loop);
     ~TcpListener();
     
-    KMError startListen(const char* host, uint16_t port);
+    /* @param listen_flags LISTEN_FLAG_XXX. with LISTEN_FLAG_REUSEPORT and an EventLoopGroup set by
+     *                     setAcceptCallback, each loop of the group listens on its own socket and
+     *                     accepts in its own thread. LISTEN_FLAG_CPU_STEERING expects the group is
+     *                     started with one loop per CPU and CPU affinity
+     */
+    KMError startListen(const char* host, uint16_t port, uint32_t listen_flags=0);
     KMError stopListen(const char* host, uint16_t port);
     KMError close();
     
     void setAcceptCallback(AcceptCallback cb);
+    /* the accepted fd is handed to a loop selected from group, and cb is called
+     * in that loop thread. the fd will be closed if cb returns false
+     */
+    void setAcceptCallback(EventLoopGroup *group, LoopAcceptCallback cb);
+    /* set the listen backlog, it should be called before startListen. default is 128
+     */
+    void setBacklog(int backlog);
+    /* set TCP_DEFER_ACCEPT, the fd is not accepted until data arrives or timeout_s
+     * elapsed. it should be called before startListen, only supported on linux
+     */
+    void setDeferAccept(uint32_t timeout_s);
+    /* enable TCP_FASTOPEN with the max length of pending TFO requests,
+     * it should be called before startListen
+     */
+    void setFastOpen(int queue_len);
     void setErrorCallback(ErrorCallback cb);
     
     class Impl;
@@ -237,15 +471,25 @@ public:
     ~Timer();
     
     /**
-     * Schedule the timer. This API is thread-safe
+     * Schedule the timer. This API is thread-safe, it is lock free in loop thread,
+     * and is posted to loop thread if called from other thread
      */
     bool schedule(uint32_t delay_ms, TimerCallback cb, TimerMode mode=TimerMode::ONE_SHOT);
     
     /**
-     * Cancel the scheduled timer. This API is thread-safe
+     * Cancel the scheduled timer. This API is thread-safe, if called from other
+     * thread it waits until the timer is cancelled in loop thread, so the timer
+     * callback is not running after cancel returns
      */
     void cancel();
     
+    /**
+     * Schedule the timer in microseconds, it is for pacing that needs sub-millisecond
+     * resolution. delay_us is rounded up to milliseconds if EventLoop::enableHighResTimer
+     * is not called. This API is thread-safe
+     */
+    bool scheduleUs(uint32_t delay_us, TimerCallback cb, TimerMode mode=TimerMode::ONE_SHOT);
+    
     class Impl;
     Impl* pimpl();
     
@@ -363,6 +607,14 @@ public:
     KMError sendResponse(int status_code, const char* desc = nullptr);
     int sendData(const void* data, size_t len);
     int sendData(const KMBuffer &buf);
+    /**
+     * send len bytes of file fd from offset as body. with Content-Length on HTTP/1.x, the
+     * file is sent by TcpSocket::sendFile, otherwise the mapping of the file is sent as
+     * KMBuffer, one chunk of at most 256KB per call. return the bytes sent like sendData,
+     * the rest should be sent again in write callback. the file must not be truncated while
+     * it is being sent, the access to the mapping of the truncated range raises SIGBUS
+     */
+    int sendFile(int fd, int64_t offset, size_t len);
     void reset(); // reset for connection reuse
     
     KMError close();
@@ -408,8 +660,18 @@ public:
     int send(const void* data, size_t len, bool is_text, bool fin=true);
     int send(const KMBuffer &buf, bool is_text, bool fin=true);
     
+    /* the messages are queued when socket is write blocked, send returns 0 when the queued
+     * bytes reach high, and write callback is called when it drops to low. default high is
+     * 256KB and low is 0
+     */
+    void setSendWatermarks(size_t high, size_t low);
+    
     KMError close();
     
+    /* move the open WebSocket to loop, see TcpSocket::migrate
+     */
+    KMError migrate(EventLoop *loop);
+    
     void setDataCallback(DataCallback cb);
     void setWriteCallback(EventCallback cb);
     void setErrorCallback(EventCallback cb);
@@ -442,6 +704,10 @@ public:
     
     KMError close();
     
+    /* move the open connection to loop when it has no stream, see TcpSocket::migrate
+     */
+    KMError migrate(EventLoop *loop);
+    
     void setAcceptCallback(AcceptCallback cb);
     void setErrorCallback(ErrorCallback cb);
     
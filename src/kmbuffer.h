@@ -25,9 +25,12 @@
 #include <memory>
 #include <vector>
 #include <atomic>
+#include <iterator>
+#include <type_traits>
 
 #ifndef KUMA_OS_WIN
 #include <sys/uio.h> // for struct iovec
+#include <limits.h> // for IOV_MAX
 #include <string.h> // for memcpy
 #endif
 
@@ -41,6 +44,7 @@ namespace {
         virtual size_t size() const = 0;
         virtual long increment() = 0;
         virtual long decrement() = 0;
+        virtual long refCount() const = 0;
     };
     
     class _SharedBasePtr final
@@ -96,6 +100,10 @@ namespace {
         {
             return base_ptr_;
         }
+        long refCount() const
+        {
+            return base_ptr_ ? base_ptr_->refCount() : 0;
+        }
         
         void reset()
         {
@@ -155,6 +163,11 @@ namespace {
             return tmp;
         }
         
+        long refCount() const override
+        {
+            return ref_count_.load(std::memory_order_acquire);
+        }
+        
     private:
         void* data_ = nullptr;
         size_t size_ = 0;
@@ -169,7 +182,196 @@ namespace {
 
 KUMA_NS_BEGIN
 
+//////////////////////////////////////////////////////////////////////////
+// class KMBufferPool
+/**
+ * KMBufferPool caches the freed storage in size classes per thread, so the buffers of
+ * the protocol paths are reused without going to the heap. the classes are from 256 bytes
+ * to 64KB with half steps, 256, 384, 512, 768, 1K ... 48K, 64K. each class block has
+ * HEADER_SIZE bytes more than its nominal size for the shared header of KMBuffer, so the
+ * storage of KMBuffer(4096) is a block of 4096 class. a block can be freed in any thread,
+ * it is cached by the freeing thread. the bigger sizes are not pooled
+ */
+class KMBufferPool final
+{
+public:
+    enum : size_t {
+        MIN_CLASS_SIZE = 256,
+        MAX_CLASS_SIZE = 64 * 1024,
+        CLASS_COUNT = 17,
+        HEADER_SIZE = 64,
+        DEFAULT_CACHE_BYTES = 512 * 1024
+    };
+    
+    static void* allocate(size_t size)
+    {
+        auto index = classIndex(size);
+        if (index < CLASS_COUNT) {
+            auto *cache = threadCache();
+            if (cache) {
+                auto &cc = cache->classes[index];
+                if (cc.head) {
+                    auto *block = cc.head;
+                    cc.head = block->next;
+                    --cc.count;
+                    return block;
+                }
+            }
+            size = classSize(index);
+        }
+        return ::operator new(size);
+    }
+    
+    /**
+     * size must be the one passed to allocate
+     */
+    static void deallocate(void *ptr, size_t size)
+    {
+        if (!ptr) {
+            return;
+        }
+        auto index = classIndex(size);
+        if (index < CLASS_COUNT) {
+            auto *cache = threadCache();
+            if (cache) {
+                auto &cc = cache->classes[index];
+                if (cc.count < cacheLimit().load(std::memory_order_relaxed) / classSize(index)) {
+                    auto *block = static_cast<FreeBlock*>(ptr);
+                    block->next = cc.head;
+                    cc.head = block;
+                    ++cc.count;
+                    return;
+                }
+            }
+        }
+        ::operator delete(ptr);
+    }
+    
+    /**
+     * set the max bytes cached per size class by each thread, 0 disables the cache.
+     * the caches over the limit are trimmed when blocks are freed
+     */
+    static void setCacheLimit(size_t bytes)
+    {
+        cacheLimit().store(bytes, std::memory_order_relaxed);
+    }
+    static size_t getCacheLimit()
+    {
+        return cacheLimit().load(std::memory_order_relaxed);
+    }
+    
+    /**
+     * the class is chosen by size minus HEADER_SIZE,
+     * return CLASS_COUNT if size is bigger than MAX_CLASS_SIZE + HEADER_SIZE
+     */
+    static size_t classIndex(size_t size)
+    {
+        size = size > HEADER_SIZE ? size - HEADER_SIZE : 0;
+        if (size <= MIN_CLASS_SIZE) {
+            return 0;
+        } else if (size > MAX_CLASS_SIZE) {
+            return CLASS_COUNT;
+        }
+        // size is in (2^bit, 2^(bit+1)]
+        size_t bit = 8;
+        while ((size - 1) >> (bit + 1)) {
+            ++bit;
+        }
+        auto index = (bit - 8) * 2;
+        return size <= (size_t(3) << (bit - 1)) ? index + 1 : index + 2;
+    }
+    static size_t classSize(size_t index)
+    {
+        if (index & 1) {
+            return (size_t(3) << (7 + index / 2)) + HEADER_SIZE;
+        }
+        return (size_t(MIN_CLASS_SIZE) << (index / 2)) + HEADER_SIZE;
+    }
+    
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+    struct ClassCache
+    {
+        FreeBlock* head = nullptr;
+        size_t count = 0;
+    };
+    class ThreadCache
+    {
+    public:
+        ThreadCache(int &state) : state_(state) { state_ = 1; }
+        ~ThreadCache()
+        {
+            for (auto &cc : classes) {
+                while (cc.head) {
+                    auto *block = cc.head;
+                    cc.head = block->next;
+                    ::operator delete(block);
+                }
+                cc.count = 0;
+            }
+            state_ = 2;
+        }
+        
+        ClassCache classes[CLASS_COUNT];
+        
+    private:
+        int &state_;
+    };
+    
+    static ThreadCache* threadCache()
+    {
+        // 0: not created, 1: alive, 2: destroyed at thread exit
+        static thread_local int state = 0;
+        if (state == 2) {
+            return nullptr;
+        }
+        static thread_local ThreadCache cache(state);
+        return &cache;
+    }
+    static std::atomic<size_t>& cacheLimit()
+    {
+        static std::atomic<size_t> limit{ DEFAULT_CACHE_BYTES };
+        return limit;
+    }
+};
+
+template<typename T>
+class KMPoolAllocator
+{
+public:
+    using value_type = T;
+    
+    KMPoolAllocator() = default;
+    template<typename U>
+    KMPoolAllocator(const KMPoolAllocator<U> &) {}
+    
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(KMBufferPool::allocate(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t n)
+    {
+        KMBufferPool::deallocate(p, n * sizeof(T));
+    }
+    
+    template<typename U>
+    struct rebind { using other = KMPoolAllocator<U>; };
+};
+
+template<typename T, typename U>
+inline bool operator==(const KMPoolAllocator<T> &, const KMPoolAllocator<U> &) { return true; }
+template<typename T, typename U>
+inline bool operator!=(const KMPoolAllocator<T> &, const KMPoolAllocator<U> &) { return false; }
+
 using IOVEC = std::vector<iovec>;
+#ifdef IOV_MAX
+# define KM_IOV_MAX     IOV_MAX
+#else
+# define KM_IOV_MAX     1024
+#endif
 //////////////////////////////////////////////////////////////////////////
 // class KMBuffer
 class KMBuffer
@@ -207,7 +409,7 @@ public:
     template<typename DataDeleter> // DataDeleter = void(void*, size_t)
     KMBuffer(void *data, size_t capacity, size_t size, size_t offset, DataDeleter &dd)
     {
-        std::allocator<char> a;
+        KMPoolAllocator<char> a;
         auto deleter = [a](void *ptr, size_t size) mutable {
             a.deallocate((char*)ptr, size);
         };
@@ -262,9 +464,12 @@ public:
         shared_data_.reset();
         static auto null_deleter = [](void*, size_t){};
         auto deleter = [a](void *ptr, size_t size) mutable {
-            a.deallocate((typename Allocator::pointer)ptr, size);
+            a.deallocate((typename std::allocator_traits<Allocator>::pointer)ptr, size);
         };
         using _MySharedData = _SharedData<decltype(deleter), decltype(null_deleter)>;
+        static_assert(!std::is_same<Allocator, KMPoolAllocator<char>>::value ||
+                      sizeof(_MySharedData) <= KMBufferPool::HEADER_SIZE,
+                      "the shared header must fit in HEADER_SIZE of pool block");
         size_t shared_size = sizeof(_MySharedData);
         size_t alloc_size = size + shared_size;
         auto buf = a.allocate(alloc_size);
@@ -279,9 +484,12 @@ public:
         return true;
     }
     
+    /**
+     * the storage is allocated from KMBufferPool
+     */
     bool allocBuffer(size_t size)
     {
-        std::allocator<char> a;
+        KMPoolAllocator<char> a;
         return allocBuffer(size, a);
     }
     
@@ -338,6 +546,28 @@ public:
         return size();
     }
     
+    size_t capacity() const
+    {
+        return end_ptr_ - begin_ptr_;
+    }
+    
+    /**
+     * return true if the storage is referenced by other KMBuffer as well,
+     * e.g. by the subbuffer of this KMBuffer
+     */
+    bool isShared() const
+    {
+        return shared_data_.refCount() > 1;
+    }
+    
+    /**
+     * move read and write position to the beginning of storage, the data is dropped
+     */
+    void rewind()
+    {
+        rd_ptr_ = wr_ptr_ = begin_ptr_;
+    }
+    
     size_t size() const
     {
         if(rd_ptr_ > wr_ptr_) return 0;
@@ -507,8 +737,7 @@ public:
                 KMBuffer *dd = nullptr;
                 if(!shared_data_) {
                     dd = new KMBuffer();
-                    std::allocator<char> a;
-                    dd->allocBuffer(copy_len, a);
+                    dd->allocBuffer(copy_len);
                     dd->write(kmb->readPtr() + offset, copy_len);
                 } else {
                     dd = kmb->cloneSelf();
@@ -562,6 +791,44 @@ public:
         return cnt;
     }
     
+    /**
+     * fill at most count iovs with the buffers from pos in this chain, pos should be this
+     * KMBuffer at first. pos is moved to the next buffer to fill, it is nullptr if the
+     * whole chain is filled
+     */
+    int fillIov(iovec *iovs, int count, const KMBuffer* &pos) const
+    {
+        int cnt = 0;
+        auto *kmb = pos;
+        while (kmb && cnt < count) {
+            if (kmb->length() > 0) {
+                iovs[cnt].iov_base = (char*)kmb->readPtr();
+                iovs[cnt].iov_len = static_cast<decltype(iovs[cnt].iov_len)>(kmb->length());
+                ++cnt;
+            }
+            kmb = kmb->next_ != this ? kmb->next_ : nullptr;
+        }
+        pos = kmb;
+        return cnt;
+    }
+    
+    /**
+     * destroy the buffers that are read out at the front of this chain, return the new
+     * chain head, or nullptr if the whole chain is read out. this chain head should be
+     * created by new
+     */
+    KMBuffer* popFront()
+    {
+        KMBuffer *head = this;
+        while (head && head->length() == 0) {
+            auto *next = head->next_ != head ? head->next_ : nullptr;
+            head->unlink();
+            head->destroy();
+            head = next;
+        }
+        return head;
+    }
+    
     void unlink()
     {
         if (is_chain_head_ && next_ != this) {
@@ -655,9 +922,15 @@ private:
     KMBuffer* next_{ this };
     
 public:
-    class Iterator : public std::iterator<std::forward_iterator_tag, KMBuffer>
+    class Iterator
     {
     public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = KMBuffer;
+        using difference_type = std::ptrdiff_t;
+        using pointer = KMBuffer*;
+        using reference = KMBuffer&;
+        
         Iterator(const KMBuffer* pos, const KMBuffer* end)
         : pos_(pos), end_(end)
         {
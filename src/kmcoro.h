@@ -0,0 +1,497 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __KMCoro_H__
+#define __KMCoro_H__
+
+#include "kmapi.h"
+
+// the library itself is C++11, the coroutine wrappers are header only and enabled
+// when the application is built with C++20 coroutine support
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+# if __has_include(<coroutine>)
+#  define KUMA_HAS_COROUTINE
+# endif
+#endif
+
+#ifdef KUMA_HAS_COROUTINE
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+KUMA_NS_BEGIN
+
+/**
+ * coroutine wrappers of the callback API. the awaiters must be awaited in the thread
+ * of the owning EventLoop, the coroutine is resumed directly in the callback of the
+ * socket, timer or request, no task is posted to the loop.
+ * the callbacks installed by the wrappers capture one pointer only, they are stored
+ * inline by std::function and no allocation is needed per operation
+ */
+namespace coro {
+
+template<typename T = void> class Task;
+
+namespace detail {
+
+class PromiseBase
+{
+public:
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            auto &p = h.promise();
+            if (p.continuation_) {
+                return p.continuation_;
+            }
+            if (p.detached_) {
+                h.destroy();
+            }
+            return std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception()
+    {
+        if (detached_) {
+            // nobody can observe it
+            std::terminate();
+        }
+        exception_ = std::current_exception();
+    }
+
+    std::coroutine_handle<> continuation_;
+    std::exception_ptr      exception_;
+    bool                    detached_ = false;
+};
+
+template<typename T>
+class Promise : public PromiseBase
+{
+public:
+    template<typename U>
+    void return_value(U &&value) { value_.emplace(std::forward<U>(value)); }
+    T result()
+    {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+        return std::move(*value_);
+    }
+
+private:
+    std::optional<T> value_;
+};
+
+template<>
+class Promise<void> : public PromiseBase
+{
+public:
+    void return_void() const noexcept {}
+    void result()
+    {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+    }
+};
+
+} // namespace detail
+
+/**
+ * Task is a lazily started coroutine. it runs when it is awaited, the awaiting
+ * coroutine is resumed when it completes. start() runs it without awaiting, the
+ * coroutine frame is then released when it completes
+ */
+template<typename T>
+class Task
+{
+public:
+    struct promise_type : detail::Promise<T>
+    {
+        Task get_return_object() { return Task(handle_type::from_promise(*this)); }
+    };
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task(const Task &other) = delete;
+    ~Task()
+    {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+    Task& operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    Task& operator=(const Task &other) = delete;
+
+    bool valid() const { return !!handle_; }
+    bool done() const { return !handle_ || handle_.done(); }
+
+    /* run the coroutine until its first suspension, and detach it
+     */
+    void start()
+    {
+        if (!handle_) {
+            return;
+        }
+        auto h = std::exchange(handle_, nullptr);
+        h.promise().detached_ = true;
+        h.resume();
+    }
+
+    bool await_ready() const noexcept { return done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        handle_.promise().continuation_ = continuation;
+        return handle_;
+    }
+    T await_resume() { return handle_.promise().result(); }
+
+private:
+    explicit Task(handle_type h) : handle_(h) {}
+
+    handle_type handle_;
+};
+
+/**
+ * co_await sleep(timer, ms) suspends the coroutine for delay_ms. it is resumed in the
+ * timer callback, so cancelling or destroying the timer leaves the coroutine suspended.
+ * the result is false if the timer cannot be scheduled
+ */
+class SleepAwaiter
+{
+public:
+    SleepAwaiter(Timer &timer, uint32_t delay_ms) : timer_(timer), delay_ms_(delay_ms) {}
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        scheduled_ = timer_.schedule(delay_ms_, [h] { h.resume(); });
+        return scheduled_;
+    }
+    bool await_resume() const noexcept { return scheduled_; }
+
+private:
+    Timer&      timer_;
+    uint32_t    delay_ms_;
+    bool        scheduled_ = false;
+};
+
+inline SleepAwaiter sleep(Timer &timer, uint32_t delay_ms)
+{
+    return SleepAwaiter(timer, delay_ms);
+}
+
+/**
+ * TcpStream installs the read, write and error callbacks of socket once and resumes
+ * the pending read and write with them. the socket must outlive the stream, and the
+ * callbacks of socket must not be replaced while the stream is in use.
+ * one read and one write can be pending at the same time
+ */
+class TcpStream
+{
+public:
+    class ConnectAwaiter
+    {
+    public:
+        ConnectAwaiter(TcpStream &stream, const char *host, uint16_t port, uint32_t timeout_ms)
+        : stream_(stream), host_(host), port_(port), timeout_ms_(timeout_ms) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            handle_ = h;
+            auto err = stream_.socket_.connect(host_, port_, [this] (KMError err) {
+                err_ = err;
+                handle_.resume();
+            }, timeout_ms_);
+            if (err != KMError::NOERR) {
+                // resume now, connect failed synchronously
+                err_ = err;
+                return false;
+            }
+            return true;
+        }
+        KMError await_resume() const noexcept { return err_; }
+
+    private:
+        TcpStream&              stream_;
+        const char*             host_;
+        uint16_t                port_;
+        uint32_t                timeout_ms_;
+        KMError                 err_ = KMError::NOERR;
+        std::coroutine_handle<> handle_;
+    };
+
+    /* the result is the bytes received, it is less than 0 on error or peer closed
+     */
+    class ReadAwaiter
+    {
+    public:
+        ReadAwaiter(TcpStream &stream, void *data, size_t length)
+        : stream_(stream), data_(data), length_(length) {}
+
+        bool await_ready()
+        {
+            return tryRead();
+        }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            handle_ = h;
+            stream_.reader_ = this;
+        }
+        int await_resume() const noexcept { return ret_; }
+
+    private:
+        friend class TcpStream;
+        bool tryRead()
+        {
+            ret_ = length_ > 0 ? stream_.socket_.receive(data_, length_) : 0;
+            return ret_ != 0 || length_ == 0;
+        }
+
+        TcpStream&              stream_;
+        void*                   data_;
+        size_t                  length_;
+        int                     ret_ = 0;
+        std::coroutine_handle<> handle_;
+    };
+
+    /* the result is length when all data is sent, it is less than 0 on error
+     */
+    class WriteAwaiter
+    {
+    public:
+        WriteAwaiter(TcpStream &stream, const void *data, size_t length)
+        : stream_(stream), data_(static_cast<const uint8_t*>(data)), length_(length) {}
+
+        bool await_ready()
+        {
+            return tryWrite();
+        }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            handle_ = h;
+            stream_.writer_ = this;
+        }
+        int await_resume() const noexcept { return ret_; }
+
+    private:
+        friend class TcpStream;
+        bool tryWrite()
+        {
+            while (sent_ < length_) {
+                int ret = stream_.socket_.send(data_ + sent_, length_ - sent_);
+                if (ret < 0) {
+                    ret_ = ret;
+                    return true;
+                } else if (ret == 0) {
+                    return false;
+                }
+                sent_ += ret;
+            }
+            ret_ = static_cast<int>(sent_);
+            return true;
+        }
+
+        TcpStream&              stream_;
+        const uint8_t*          data_;
+        size_t                  length_;
+        size_t                  sent_ = 0;
+        int                     ret_ = 0;
+        std::coroutine_handle<> handle_;
+    };
+
+    explicit TcpStream(TcpSocket &socket) : socket_(socket)
+    {
+        socket_.setReadCallback([this] (KMError) { onRead(); });
+        socket_.setWriteCallback([this] (KMError) { onWrite(); });
+        socket_.setErrorCallback([this] (KMError) { onError(); });
+    }
+    TcpStream(const TcpStream &other) = delete;
+    TcpStream& operator=(const TcpStream &other) = delete;
+    ~TcpStream()
+    {
+        socket_.setReadCallback(nullptr);
+        socket_.setWriteCallback(nullptr);
+        socket_.setErrorCallback(nullptr);
+    }
+
+    ConnectAwaiter connect(const char *host, uint16_t port, uint32_t timeout_ms = 0)
+    {
+        return ConnectAwaiter(*this, host, port, timeout_ms);
+    }
+    ReadAwaiter read(void *data, size_t length)
+    {
+        return ReadAwaiter(*this, data, length);
+    }
+    WriteAwaiter write(const void *data, size_t length)
+    {
+        return WriteAwaiter(*this, data, length);
+    }
+
+    TcpSocket& socket() { return socket_; }
+
+private:
+    void onRead()
+    {
+        auto *reader = reader_;
+        if (reader && reader->tryRead()) {
+            reader_ = nullptr;
+            reader->handle_.resume();
+        }
+    }
+    void onWrite()
+    {
+        auto *writer = writer_;
+        if (writer && writer->tryWrite()) {
+            writer_ = nullptr;
+            writer->handle_.resume();
+        }
+    }
+    void onError()
+    {
+        // this stream may be destroyed by the resumed coroutine
+        auto *reader = std::exchange(reader_, nullptr);
+        auto *writer = std::exchange(writer_, nullptr);
+        if (reader) {
+            reader->ret_ = -1;
+            reader->handle_.resume();
+        }
+        if (writer) {
+            writer->ret_ = -1;
+            writer->handle_.resume();
+        }
+    }
+
+private:
+    TcpSocket&      socket_;
+    ReadAwaiter*    reader_ = nullptr;
+    WriteAwaiter*   writer_ = nullptr;
+};
+
+/**
+ * HttpClient installs the response complete and error callbacks of request once,
+ * co_await send(method, url) resumes when the response is complete or on error.
+ * the response body is delivered to the data callback of request as before
+ */
+class HttpClient
+{
+public:
+    class SendAwaiter
+    {
+    public:
+        SendAwaiter(HttpClient &client, const char *method, const char *url)
+        : client_(client), method_(method), url_(url) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            handle_ = h;
+            // the response complete or error callback may be called in sendRequest
+            client_.sender_ = this;
+            sending_ = true;
+            auto err = client_.request_.sendRequest(method_, url_);
+            sending_ = false;
+            if (err != KMError::NOERR) {
+                client_.sender_ = nullptr;
+                err_ = err;
+                return false;
+            }
+            // resume now if it is completed already
+            return client_.sender_ == this;
+        }
+        KMError await_resume() const noexcept { return err_; }
+
+    private:
+        friend class HttpClient;
+        HttpClient&             client_;
+        const char*             method_;
+        const char*             url_;
+        KMError                 err_ = KMError::NOERR;
+        bool                    sending_ = false;
+        std::coroutine_handle<> handle_;
+    };
+
+    explicit HttpClient(HttpRequest &request) : request_(request)
+    {
+        request_.setResponseCompleteCallback([this] { onComplete(KMError::NOERR); });
+        request_.setErrorCallback([this] (KMError err) { onComplete(err); });
+    }
+    HttpClient(const HttpClient &other) = delete;
+    HttpClient& operator=(const HttpClient &other) = delete;
+    ~HttpClient()
+    {
+        request_.setResponseCompleteCallback(nullptr);
+        request_.setErrorCallback(nullptr);
+    }
+
+    /* the request has no body, status and headers are read from request when resumed
+     */
+    SendAwaiter send(const char *method, const char *url)
+    {
+        return SendAwaiter(*this, method, url);
+    }
+
+    HttpRequest& request() { return request_; }
+
+private:
+    void onComplete(KMError err)
+    {
+        auto *sender = std::exchange(sender_, nullptr);
+        if (sender) {
+            sender->err_ = err;
+            if (!sender->sending_) {
+                sender->handle_.resume();
+            }
+        }
+    }
+
+private:
+    HttpRequest&    request_;
+    SendAwaiter*    sender_ = nullptr;
+};
+
+} // namespace coro
+
+KUMA_NS_END
+
+#endif // KUMA_HAS_COROUTINE
+
+#endif
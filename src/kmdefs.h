@@ -92,8 +92,17 @@ enum class TimerMode {
     REPEATING
 };
 
+enum class TaskPriority {
+    URGENT, // run before other tasks, not limited by task time budget
+    NORMAL,
+    IDLE,   // run only when the loop has nothing else to do
+};
+
 #define UDP_FLAG_MULTICAST  1
 
+#define LISTEN_FLAG_REUSEPORT       1 // SO_REUSEPORT, one listener per loop if EventLoopGroup is set
+#define LISTEN_FLAG_CPU_STEERING    2 // steer connections to the listener of loop i on CPU i (linux only)
+
 #ifdef KUMA_OS_WIN
 struct iovec {
     unsigned long   iov_len;
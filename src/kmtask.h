@@ -0,0 +1,211 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __KMTask_H__
+#define __KMTask_H__
+#include "kmdefs.h"
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <new>
+
+KUMA_NS_BEGIN
+
+/**
+ * KMTask is a move-only callable of void(void). the callable is stored inline
+ * if it fits in INLINE_SIZE bytes and is nothrow move constructible, otherwise
+ * it is allocated on heap.
+ */
+class KMTask final
+{
+    // the callable of void(void) other than KMTask itself
+    template<typename F, typename = void>
+    struct IsCallable : std::false_type {};
+    template<typename F>
+    struct IsCallable<F, decltype(void(std::declval<typename std::decay<F>::type&>()()))>
+    : std::integral_constant<bool, !std::is_same<typename std::decay<F>::type, KMTask>::value> {};
+
+public:
+    enum : size_t { INLINE_SIZE = 64 };
+
+    KMTask() = default;
+    KMTask(std::nullptr_t) {}
+
+    template<typename F, typename = typename std::enable_if<IsCallable<F>::value>::type>
+    KMTask(F &&f)
+    {
+        assign(std::forward<F>(f));
+    }
+    KMTask(KMTask &&other)
+    {
+        moveFrom(other);
+    }
+    KMTask(const KMTask &other) = delete;
+    ~KMTask()
+    {
+        reset();
+    }
+
+    KMTask& operator=(KMTask &&other)
+    {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+    KMTask& operator=(const KMTask &other) = delete;
+    KMTask& operator=(std::nullptr_t)
+    {
+        reset();
+        return *this;
+    }
+    template<typename F, typename = typename std::enable_if<IsCallable<F>::value>::type>
+    KMTask& operator=(F &&f)
+    {
+        reset();
+        assign(std::forward<F>(f));
+        return *this;
+    }
+
+    // throw std::bad_function_call if it is empty, the same as std::function
+    void operator()()
+    {
+        if (!ops_) {
+            throw std::bad_function_call();
+        }
+        ops_->invoke(&storage_);
+    }
+    explicit operator bool() const
+    {
+        return ops_ != nullptr;
+    }
+
+    void reset()
+    {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    // for test, whether the callable is stored inline
+    bool isInline() const
+    {
+        return ops_ && ops_->is_inline;
+    }
+
+private:
+    using Storage = typename std::aligned_storage<INLINE_SIZE>::type;
+    struct Ops
+    {
+        void (*invoke)(void *s);
+        void (*move)(void *dst, void *src); // move construct dst from src, and destroy src
+        void (*destroy)(void *s);
+        bool is_inline;
+    };
+
+    template<typename F>
+    struct InlineOps
+    {
+        static void invoke(void *s) { (*static_cast<F*>(s))(); }
+        static void move(void *dst, void *src)
+        {
+            new (dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        }
+        static void destroy(void *s) { static_cast<F*>(s)->~F(); }
+        static const Ops ops;
+    };
+
+    template<typename F>
+    struct HeapOps
+    {
+        static F*& ptr(void *s) { return *static_cast<F**>(s); }
+        static void invoke(void *s) { (*ptr(s))(); }
+        static void move(void *dst, void *src)
+        {
+            new (dst) F*(ptr(src));
+        }
+        static void destroy(void *s) { delete ptr(s); }
+        static const Ops ops;
+    };
+
+    template<typename F>
+    struct FitsInline : std::integral_constant<bool,
+        sizeof(F) <= sizeof(Storage) && alignof(Storage) % alignof(F) == 0 &&
+        std::is_nothrow_move_constructible<F>::value> {};
+
+    template<typename F>
+    static bool isNull(const F &) { return false; }
+    template<typename F>
+    static bool isNull(F *f) { return f == nullptr; }
+    template<typename F>
+    static bool isNull(const std::function<F> &f) { return !f; }
+
+    template<typename F>
+    void assign(F &&f)
+    {
+        using Fn = typename std::decay<F>::type;
+        if (isNull(f)) {
+            return;
+        }
+        construct<Fn>(std::forward<F>(f), FitsInline<Fn>());
+    }
+    template<typename Fn, typename F>
+    void construct(F &&f, std::true_type)
+    {
+        new (&storage_) Fn(std::forward<F>(f));
+        ops_ = &InlineOps<Fn>::ops;
+    }
+    template<typename Fn, typename F>
+    void construct(F &&f, std::false_type)
+    {
+        new (&storage_) Fn*(new Fn(std::forward<F>(f)));
+        ops_ = &HeapOps<Fn>::ops;
+    }
+
+    void moveFrom(KMTask &other)
+    {
+        if (other.ops_) {
+            other.ops_->move(&storage_, &other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    Storage     storage_;
+    const Ops*  ops_ = nullptr;
+};
+
+template<typename F>
+const KMTask::Ops KMTask::InlineOps<F>::ops = {
+    &KMTask::InlineOps<F>::invoke, &KMTask::InlineOps<F>::move, &KMTask::InlineOps<F>::destroy, true
+};
+
+template<typename F>
+const KMTask::Ops KMTask::HeapOps<F>::ops = {
+    &KMTask::HeapOps<F>::invoke, &KMTask::HeapOps<F>::move, &KMTask::HeapOps<F>::destroy, false
+};
+
+KUMA_NS_END
+
+#endif
@@ -24,11 +24,12 @@
 #include "util/kmtrace.h"
 
 #include <sys/epoll.h>
+#include <algorithm>
 
 KUMA_NS_BEGIN
 
-#define MAX_EPOLL_FDS   5000
 #define MAX_EVENT_NUM   500
+#define MIN_EVENT_NUM   16
 
 class EPoll : public IOPoll
 {
@@ -44,14 +45,25 @@ public:
     void notify();
     PollType getType() const { return PollType::EPOLL; }
     bool isLevelTriggered() const { return false; }
+    KMError setMaxEvents(uint32_t max_events);
+    KMError enableDirectItem();
 
 private:
     uint32_t get_events(KMEvent kuma_events);
     KMEvent get_kuma_events(uint32_t events);
+    void* get_event_data(PollItem &item);
+    void dispatch(PollItem &item, uint32_t events);
 
 private:
     int             epoll_fd_;
     NotifierPtr     notifier_ { std::move(Notifier::createNotifier()) };
+    
+    // the batch grows when a wait fills it, and shrinks when it is mostly empty
+    std::vector<epoll_event> events_;
+    uint32_t        max_events_ = MAX_EVENT_NUM;
+    uint32_t        batch_size_ = MIN_EVENT_NUM;
+    // epoll_event.data.ptr is the PollItem instead of fd
+    bool            direct_item_ = false;
 };
 
 EPoll::EPoll()
@@ -70,7 +82,7 @@ EPoll::~EPoll()
 
 bool EPoll::init()
 {
-    epoll_fd_ = epoll_create(MAX_EPOLL_FDS);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
     if(INVALID_FD == epoll_fd_) {
         return false;
     }
@@ -114,21 +126,47 @@ KMEvent EPoll::get_kuma_events(uint32_t events)
     return ev;
 }
 
+KMError EPoll::setMaxEvents(uint32_t max_events)
+{
+    max_events_ = max_events ? max_events : MAX_EVENT_NUM;
+    if (batch_size_ > max_events_) {
+        batch_size_ = max_events_;
+    }
+    return KMError::NOERR;
+}
+
+KMError EPoll::enableDirectItem()
+{
+    if (INVALID_FD != epoll_fd_) {
+        // the fds registered have fd in event data
+        return KMError::INVALID_STATE;
+    }
+    direct_item_ = true;
+    return KMError::NOERR;
+}
+
+void* EPoll::get_event_data(PollItem &item)
+{
+    if (direct_item_) {
+        return &item;
+    }
+    return (void*)(long)item.fd;
+}
+
 KMError EPoll::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
 {
     if (fd < 0) {
         return KMError::INVALID_PARAM;
     }
-    resizePollItems(fd);
     int epoll_op = EPOLL_CTL_ADD;
-    if (INVALID_FD != poll_items_[fd].fd) {
+    if (poll_items_.find(fd)) {
         epoll_op = EPOLL_CTL_MOD;
     }
-    poll_items_[fd].fd = fd;
-    poll_items_[fd].events = events;
-    poll_items_[fd].cb = std::move(cb);
+    auto &item = poll_items_.add(fd);
+    item.events = events;
+    item.cb = std::move(cb);
     struct epoll_event evt = {0};
-    evt.data.ptr = (void*)(long)fd;
+    evt.data.ptr = get_event_data(item);
     evt.events = get_events(events);//EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLET;
     if(epoll_ctl(epoll_fd_, epoll_op, fd, &evt) < 0) {
         KUMA_ERRTRACE("EPoll::registerFd error, fd=" << fd << ", ev=" << evt.events << ", errno=" << errno);
@@ -141,59 +179,76 @@ KMError EPoll::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
 
 KMError EPoll::unregisterFd(SOCKET_FD fd)
 {
-    int max_fd = int(poll_items_.size() - 1);
-    KUMA_INFOTRACE("EPoll::unregisterFd, fd="<<fd<<", max_fd="<<max_fd);
-    if (fd < 0 || fd > max_fd) {
-        KUMA_WARNTRACE("EPoll::unregisterFd, failed, max_fd=" << max_fd);
+    KUMA_INFOTRACE("EPoll::unregisterFd, fd="<<fd<<", count="<<poll_items_.count());
+    if (fd < 0 || !poll_items_.find(fd)) {
+        KUMA_WARNTRACE("EPoll::unregisterFd, failed, fd=" << fd);
         return KMError::INVALID_PARAM;
     }
     epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, NULL);
-    if(fd < max_fd) {
-        poll_items_[fd].reset();
-    } else if (fd == max_fd) {
-        poll_items_.pop_back();
-    }
+    poll_items_.remove(fd);
     return KMError::NOERR;
 }
 
 KMError EPoll::updateFd(SOCKET_FD fd, KMEvent events)
 {
-    if(fd < 0 || fd >= poll_items_.size() || INVALID_FD == poll_items_[fd].fd) {
+    auto *item = poll_items_.find(fd);
+    if(!item) {
         return KMError::FAILED;
     }
     struct epoll_event evt = {0};
-    evt.data.ptr = (void*)(long)fd;
+    evt.data.ptr = get_event_data(*item);
     evt.events = get_events(events);
     if(epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &evt) < 0) {
         KUMA_ERRTRACE("EPoll::updateFd error, fd="<<fd<<", errno="<<errno);
         return KMError::FAILED;
     }
-    poll_items_[fd].events = events;
+    item->events = events;
     return KMError::NOERR;
 }
 
+void EPoll::dispatch(PollItem &item, uint32_t events)
+{
+    auto revents = get_kuma_events(events);
+    revents &= item.events;
+    if (revents) {
+        invokeCallback(item, revents, nullptr, 0);
+    }
+}
+
 KMError EPoll::wait(uint32_t wait_ms)
 {
-    struct epoll_event events[MAX_EVENT_NUM];
-    int nfds = epoll_wait(epoll_fd_, events, MAX_EVENT_NUM , wait_ms);
+    if (events_.size() < batch_size_) {
+        events_.resize(batch_size_);
+    }
+    auto *events = &events_[0];
+    int nfds = epoll_wait(epoll_fd_, events, batch_size_, wait_ms);
+    last_event_count_ = nfds > 0 ? nfds : 0;
     if (nfds < 0) {
         if(errno != EINTR) {
             KUMA_ERRTRACE("EPoll::wait, errno="<<errno);
         }
         KUMA_INFOTRACE("EPoll::wait, nfds="<<nfds<<", errno="<<errno);
+    } else if (direct_item_) {
+        for (int i=0; i<nfds; ++i) {
+            // the item stays valid in this wait even if it is unregistered by a callback
+            auto *item = static_cast<PollItem*>(events[i].data.ptr);
+            dispatch(*item, events[i].events);
+        }
     } else {
         for (int i=0; i<nfds; ++i) {
             SOCKET_FD fd = (SOCKET_FD)(long)events[i].data.ptr;
-            if(fd < poll_items_.size()) {
-                auto revents = get_kuma_events(events[i].events);
-                revents &= poll_items_[fd].events;
-                if (revents) {
-                    auto &cb = poll_items_[fd].cb;
-                    if(cb) cb(revents, nullptr, 0);
-                }
+            auto *item = poll_items_.find(fd);
+            if(item) {
+                dispatch(*item, events[i].events);
             }
         }
     }
+    poll_items_.shrink();
+    if (nfds >= (int)batch_size_ && batch_size_ < max_events_) {
+        batch_size_ = std::min(batch_size_ * 2, max_events_);
+    } else if (nfds < (int)batch_size_ / 4 && batch_size_ > MIN_EVENT_NUM) {
+        batch_size_ = std::max<uint32_t>(batch_size_ / 2, MIN_EVENT_NUM);
+    }
     return KMError::NOERR;
 }
 
@@ -68,6 +68,7 @@
 #include <map>
 #include <list>
 #include <vector>
+#include <memory>
 
 KUMA_NS_BEGIN
 
@@ -78,16 +79,148 @@ struct PollItem
         idx = -1;
         events = 0;
         revents = 0;
+        observed = false;
+        obj_id = 0;
         cb = nullptr;
     }
     SOCKET_FD fd { INVALID_FD };
     int idx { -1 };
     KMEvent events { 0 }; // kuma events registered
     KMEvent revents { 0 }; // kuma events received
+    uint32_t gen { 0 }; // generation of the registration, for the stale events
+    bool observed { false }; // the callback is reported to IOObserver
+    long obj_id { 0 }; // owner of fd, reported to IOObserver
     IOCallback cb;
 };
 typedef std::vector<PollItem>   PollItemVector;
 
+/**
+ * PollItemTable maps fd to PollItem. the items are allocated in pages on demand, so the
+ * memory is proportional to the fd ranges registered instead of the max fd, and the item
+ * address is stable while the fd is registered. the empty pages are freed in shrink, which
+ * is called after the events of a wait are dispatched
+ */
+class PollItemTable
+{
+public:
+    enum : size_t { PAGE_SHIFT = 8, PAGE_SIZE = 1 << PAGE_SHIFT };
+    
+    // the item of a registered fd, nullptr if fd is not registered
+    PollItem* find(SOCKET_FD fd)
+    {
+        auto *page = getPage(fd);
+        if (!page) {
+            return nullptr;
+        }
+        auto &item = page->items[size_t(fd) & (PAGE_SIZE - 1)];
+        return item.fd == fd ? &item : nullptr;
+    }
+    
+    // the item of fd, it is added if fd is not registered
+    PollItem& add(SOCKET_FD fd)
+    {
+        size_t pi = size_t(fd) >> PAGE_SHIFT;
+        if (pi >= pages_.size()) {
+            pages_.resize(pi + 1);
+        }
+        if (!pages_[pi]) {
+            pages_[pi].reset(new Page);
+        }
+        auto &page = *pages_[pi];
+        auto &item = page.items[size_t(fd) & (PAGE_SIZE - 1)];
+        if (item.fd != fd) {
+            item.fd = fd;
+            ++page.used;
+            ++count_;
+        }
+        return item;
+    }
+    
+    void remove(SOCKET_FD fd)
+    {
+        auto *item = find(fd);
+        if (!item) {
+            return;
+        }
+        item->reset();
+        --count_;
+        size_t pi = size_t(fd) >> PAGE_SHIFT;
+        if (--pages_[pi]->used == 0) {
+            // the item may still be referenced by the events being dispatched
+            empty_pages_.push_back(pi);
+        }
+    }
+    
+    void shrink()
+    {
+        if (empty_pages_.empty()) {
+            return;
+        }
+        for (auto pi : empty_pages_) {
+            if (pi < pages_.size() && pages_[pi] && pages_[pi]->used == 0) {
+                pages_[pi].reset();
+            }
+        }
+        empty_pages_.clear();
+        while (!pages_.empty() && !pages_.back()) {
+            pages_.pop_back();
+        }
+    }
+    
+    void clear()
+    {
+        pages_.clear();
+        empty_pages_.clear();
+        count_ = 0;
+    }
+    
+    // number of the fds registered
+    size_t count() const { return count_; }
+    
+    // bytes allocated for the table
+    size_t memoryUsage() const
+    {
+        size_t bytes = pages_.capacity() * sizeof(PagePtr);
+        for (auto &page : pages_) {
+            if (page) {
+                bytes += sizeof(Page);
+            }
+        }
+        return bytes;
+    }
+    
+private:
+    struct Page
+    {
+        PollItem    items[PAGE_SIZE];
+        size_t      used = 0;
+    };
+    using PagePtr = std::unique_ptr<Page>;
+    
+    Page* getPage(SOCKET_FD fd)
+    {
+        size_t pi = size_t(fd) >> PAGE_SHIFT;
+        return fd >= 0 && pi < pages_.size() ? pages_[pi].get() : nullptr;
+    }
+    
+    std::vector<PagePtr>    pages_;
+    std::vector<size_t>     empty_pages_;
+    size_t                  count_ = 0;
+};
+
+/**
+ * IOObserver is notified around the callbacks of the fds observed, so the callbacks are
+ * timed in dispatch instead of wrapping each of them in another IOCallback
+ */
+class IOObserver
+{
+public:
+    virtual ~IOObserver() {}
+    // returns the start time, which is passed to onCallbackEnd
+    virtual uint64_t onCallbackBegin(long obj_id) = 0;
+    virtual void onCallbackEnd(uint64_t start_us) = 0;
+};
+
 class IOPoll
 {
 public:
@@ -101,19 +234,47 @@ public:
     virtual void notify() = 0;
     virtual PollType getType() const = 0;
     virtual bool isLevelTriggered() const = 0;
+    // max number of events handled in one wait, 0 means the default of poll
+    virtual KMError setMaxEvents(uint32_t /*max_events*/) { return KMError::UNSUPPORT; }
+    // dispatch by the PollItem stored in kernel event instead of fd lookup, before init
+    virtual KMError enableDirectItem() { return KMError::UNSUPPORT; }
+    // number of the events returned by last wait
+    uint32_t lastEventCount() const { return last_event_count_; }
+    
+    void setObserver(IOObserver *observer) { observer_ = observer; }
+    // the callbacks of the registered fd are reported to observer, obj_id is the owner of fd
+    void observeFd(SOCKET_FD fd, long obj_id)
+    {
+        auto *item = poll_items_.find(fd);
+        if (item) {
+            item->observed = true;
+            item->obj_id = obj_id;
+        }
+    }
     
 protected:
-    void resizePollItems(SOCKET_FD fd) {
-        auto count = poll_items_.size();
-        if (fd >= count) {
-            if(fd > count + 1024) {
-                poll_items_.resize(fd+1);
-            } else {
-                poll_items_.resize(count + 1024);
-            }
+    // run the callback of item in dispatch
+    void invokeCallback(PollItem &item, KMEvent events, void *op, size_t io_size)
+    {
+        auto &cb = item.cb;
+        if (!cb) {
+            return;
+        }
+        if (!item.observed || !observer_) {
+            cb(events, op, io_size);
+            return;
         }
+        // the callback may unregister the fd and reset the item
+        auto *observer = observer_;
+        auto start_us = observer->onCallbackBegin(item.obj_id);
+        cb(events, op, io_size);
+        observer->onCallbackEnd(start_us);
     }
-    PollItemVector  poll_items_;
+    
+protected:
+    PollItemTable   poll_items_;
+    uint32_t        last_event_count_ = 0;
+    IOObserver*     observer_ = nullptr;
 };
 
 KUMA_NS_END
@@ -74,26 +74,19 @@ KMError IocpPoll::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
     if (CreateIoCompletionPort((HANDLE)fd, hCompPort_, (ULONG_PTR)fd, 0) == NULL) {
         return KMError::POLL_ERROR;
     }
-    resizePollItems(fd);
-    poll_items_[fd].fd = fd;
-    poll_items_[fd].cb = std::move(cb);
+    auto &item = poll_items_.add(fd);
+    item.cb = std::move(cb);
     return KMError::NOERR;
 }
 
 KMError IocpPoll::unregisterFd(SOCKET_FD fd)
 {
     KUMA_INFOTRACE("IocpPoll::unregisterFd, fd="<<fd);
-    SOCKET_FD max_fd = poll_items_.size() - 1;
-    if (fd < 0 || -1 == max_fd || fd > max_fd) {
-        KUMA_WARNTRACE("IocpPoll::unregisterFd, failed, max_fd=" << max_fd);
+    if (!poll_items_.find(fd)) {
+        KUMA_WARNTRACE("IocpPoll::unregisterFd, failed, fd=" << fd);
         return KMError::INVALID_PARAM;
     }
-    if (fd == max_fd) {
-        poll_items_.pop_back();
-    } else {
-        poll_items_[fd].cb = nullptr;
-        poll_items_[fd].fd = INVALID_FD;
-    }
+    poll_items_.remove(fd);
     
     return KMError::NOERR;
 }
@@ -108,14 +101,15 @@ KMError IocpPoll::wait(uint32_t wait_ms)
     OVERLAPPED_ENTRY entries[128];
     ULONG count = 0;
     auto success = GetQueuedCompletionStatusEx(hCompPort_, entries, ARRAY_SIZE(entries), &count, wait_ms, FALSE);
+    last_event_count_ = success ? count : 0;
     if (success) {
         for (ULONG i = 0; i < count; ++i) {
             if (entries[i].lpOverlapped) {
                 SOCKET_FD fd = (SOCKET_FD)entries[i].lpCompletionKey;
-                if (fd < poll_items_.size()) {
-                    IOCallback &cb = poll_items_[fd].cb;
+                auto *item = poll_items_.find(fd);
+                if (item) {
                     size_t io_size = entries[i].dwNumberOfBytesTransferred;
-                    if (cb) cb(0, entries[i].lpOverlapped, io_size);
+                    invokeCallback(*item, 0, entries[i].lpOverlapped, io_size);
                 }
             }
         }
@@ -126,6 +120,7 @@ KMError IocpPoll::wait(uint32_t wait_ms)
             KUMA_ERRTRACE("IocpPoll::wait, err="<<err);
         }
     }
+    poll_items_.shrink();
     return KMError::NOERR;
 }
 
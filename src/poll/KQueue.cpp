@@ -92,21 +92,22 @@ KMError KQueue::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
     if (fd < 0) {
         return KMError::INVALID_PARAM;
     }
-    resizePollItems(fd);
     struct kevent kevents[2];
     int nchanges = 0;
-    if (INVALID_FD != poll_items_[fd].fd) {
-        if (!!(poll_items_[fd].events & KUMA_EV_READ) && !(events & KUMA_EV_READ)) {
+    bool registered = poll_items_.find(fd) != nullptr;
+    auto &item = poll_items_.add(fd);
+    if (registered) {
+        if (!!(item.events & KUMA_EV_READ) && !(events & KUMA_EV_READ)) {
             EV_SET(&kevents[nchanges++], fd, EVFILT_READ, EV_DELETE, 0, 0, 0);
-            poll_items_[fd].events &= ~KUMA_EV_READ;
+            item.events &= ~KUMA_EV_READ;
         }
-        if (!!(poll_items_[fd].events & KUMA_EV_WRITE) && !(events & KUMA_EV_WRITE)) {
+        if (!!(item.events & KUMA_EV_WRITE) && !(events & KUMA_EV_WRITE)) {
             EV_SET(&kevents[nchanges++], fd, EVFILT_WRITE, EV_DELETE, 0, 0, 0);
-            poll_items_[fd].events &= ~KUMA_EV_WRITE;
+            item.events &= ~KUMA_EV_WRITE;
         }
         ::kevent(kqueue_fd_, kevents, nchanges, 0, 0, 0);
-        if (poll_items_[fd].events == events) {
-            poll_items_[fd].cb = std::move(cb);
+        if (item.events == events) {
+            item.cb = std::move(cb);
             return KMError::NOERR;
         }
     }
@@ -121,9 +122,8 @@ KMError KQueue::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
     if (events & KUMA_EV_WRITE) {
         EV_SET(&kevents[nchanges++], fd, EVFILT_WRITE, op , 0, 0, 0);
     }
-    poll_items_[fd].fd = fd;
-    poll_items_[fd].events = events;
-    poll_items_[fd].cb = std::move(cb);
+    item.events = events;
+    item.cb = std::move(cb);
     
     if(::kevent(kqueue_fd_, kevents, nchanges, 0, 0, 0) == -1) {
         KUMA_ERRTRACE("KQueue::registerFd error, fd=" << fd << ", ev=" << events << ", errno=" << errno);
@@ -136,49 +136,46 @@ KMError KQueue::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
 
 KMError KQueue::unregisterFd(SOCKET_FD fd)
 {
-    int max_fd = int(poll_items_.size() - 1);
-    KUMA_INFOTRACE("KQueue::unregisterFd, fd="<<fd<<", max_fd="<<max_fd);
-    if (fd < 0 || fd > max_fd) {
-        KUMA_WARNTRACE("KQueue::unregisterFd, failed, max_fd=" << max_fd);
+    KUMA_INFOTRACE("KQueue::unregisterFd, fd="<<fd<<", count="<<poll_items_.count());
+    auto *item = poll_items_.find(fd);
+    if (!item) {
+        KUMA_WARNTRACE("KQueue::unregisterFd, failed, fd=" << fd);
         return KMError::INVALID_PARAM;
     }
     struct kevent kevents[2];
     int nchanges = 0;
-    if (poll_items_[fd].events & KUMA_EV_READ) {
+    if (item->events & KUMA_EV_READ) {
         EV_SET(&kevents[nchanges++], fd, EVFILT_READ, EV_DELETE, 0, 0, 0);
     }
-    if (poll_items_[fd].events & KUMA_EV_WRITE) {
+    if (item->events & KUMA_EV_WRITE) {
         EV_SET(&kevents[nchanges++], fd, EVFILT_WRITE, EV_DELETE, 0, 0, 0);
     }
     ::kevent(kqueue_fd_, kevents, nchanges, 0, 0, 0);
-    if(fd < max_fd) {
-        poll_items_[fd].reset();
-    } else if (fd == max_fd) {
-        poll_items_.pop_back();
-    }
+    poll_items_.remove(fd);
     return KMError::NOERR;
 }
 
 KMError KQueue::updateFd(SOCKET_FD fd, KMEvent events)
 {
-    if(fd < 0 || fd >= poll_items_.size() || INVALID_FD == poll_items_[fd].fd) {
+    auto *item = poll_items_.find(fd);
+    if(!item) {
         return KMError::FAILED;
     }
     
     struct kevent kevents[2];
     int nchanges = 0;
-    if (!!(poll_items_[fd].events & KUMA_EV_READ) && !(events & KUMA_EV_READ)) {
+    if (!!(item->events & KUMA_EV_READ) && !(events & KUMA_EV_READ)) {
         EV_SET(&kevents[nchanges++], fd, EVFILT_READ, EV_DELETE, 0, 0, 0);
-        poll_items_[fd].events &= ~KUMA_EV_READ;
+        item->events &= ~KUMA_EV_READ;
     }
-    if (!!(poll_items_[fd].events & KUMA_EV_WRITE) && !(events & KUMA_EV_WRITE)) {
+    if (!!(item->events & KUMA_EV_WRITE) && !(events & KUMA_EV_WRITE)) {
         EV_SET(&kevents[nchanges++], fd, EVFILT_WRITE, EV_DELETE, 0, 0, 0);
-        poll_items_[fd].events &= ~KUMA_EV_WRITE;
+        item->events &= ~KUMA_EV_WRITE;
     }
     if (nchanges) { // remove events
         ::kevent(kqueue_fd_, kevents, nchanges, 0, 0, 0);
     }
-    if (poll_items_[fd].events == events) {
+    if (item->events == events) {
         return KMError::NOERR;
     }
     nchanges = 0;
@@ -196,7 +193,7 @@ KMError KQueue::updateFd(SOCKET_FD fd, KMEvent events)
         KUMA_ERRTRACE("KQueue::updateFd error, fd="<<fd<<", errno="<<errno);
         return KMError::FAILED;
     }
-    poll_items_[fd].events = events;
+    item->events = events;
     //KUMA_INFOTRACE("KQueue::updateFd, fd="<<fd<<", ev="<<events);
     return KMError::NOERR;
 }
@@ -210,6 +207,7 @@ KMError KQueue::wait(uint32_t wait_ms)
     }
     struct kevent kevents[MAX_EVENT_NUM];
     int nevents = kevent(kqueue_fd_, 0, 0, kevents, MAX_EVENT_NUM, wait_ms == -1 ? NULL : &tval);
+    last_event_count_ = nevents > 0 ? nevents : 0;
     if (nevents < 0) {
         if(errno != EINTR) {
             KUMA_ERRTRACE("KQueue::wait, errno="<<errno);
@@ -218,10 +216,10 @@ KMError KQueue::wait(uint32_t wait_ms)
     } else {
         SOCKET_FD fds[MAX_EVENT_NUM] = { INVALID_FD };
         int nfds = 0;
-        int max_fd = int(poll_items_.size() - 1);
         for (int i=0; i<nevents; ++i) {
             SOCKET_FD fd = (SOCKET_FD)kevents[i].ident;
-            if(fd >= 0 && fd <= max_fd) {
+            auto *item = poll_items_.find(fd);
+            if(item) {
                 KMEvent revents = 0;
                 if (kevents[i].filter == EVFILT_READ) {
                     revents |= KUMA_EV_READ;
@@ -234,26 +232,27 @@ KMError KQueue::wait(uint32_t wait_ms)
                 if (!revents) {
                     continue;
                 }
-                if (poll_items_[fd].revents == 0) {
+                if (item->revents == 0) {
                     fds[nfds++] = fd;
                 }
-                poll_items_[fd].revents = revents;
+                item->revents = revents;
             }
         }
         for (int i=0; i<nfds; ++i) {
             SOCKET_FD fd = fds[i];
-            if (fd < poll_items_.size()) {
-                uint32_t revents = poll_items_[fd].revents;
-                poll_items_[fd].revents = 0;
+            auto *item = poll_items_.find(fd);
+            if (item) {
+                uint32_t revents = item->revents;
+                item->revents = 0;
                 // in case a processed event may modify this event
-                revents &= poll_items_[fd].events;
+                revents &= item->events;
                 if (revents) {
-                    auto &cb = poll_items_[fd].cb;
-                    if(cb) cb(revents, nullptr, 0);
+                    invokeCallback(*item, revents, nullptr, 0);
                 }
             }
         }
     }
+    poll_items_.shrink();
     return KMError::NOERR;
 }
 
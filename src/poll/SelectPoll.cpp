@@ -94,43 +94,41 @@ KMError SelectPoll::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
         return KMError::INVALID_PARAM;
     }
     KUMA_INFOTRACE("SelectPoll::registerFd, fd=" << fd);
-    resizePollItems(fd);
-    if (INVALID_FD == poll_items_[fd].fd || -1 == poll_items_[fd].idx) {
+    auto &item = poll_items_.add(fd);
+    if (-1 == item.idx) {
         PollFD pfd;
         pfd.fd = fd;
         pfd.events = events;
         poll_fds_.push_back(pfd);
-        poll_items_[fd].idx = int(poll_fds_.size() - 1);
+        item.idx = int(poll_fds_.size() - 1);
     }
-    poll_items_[fd].fd = fd;
-    poll_items_[fd].events = events;
-    poll_items_[fd].cb = std::move(cb);
+    item.events = events;
+    item.cb = std::move(cb);
     updateFdSet(fd, events);
     return KMError::NOERR;
 }
 
 KMError SelectPoll::unregisterFd(SOCKET_FD fd)
 {
-    int max_fd = int(poll_items_.size() - 1);
-    KUMA_INFOTRACE("SelectPoll::unregisterFd, fd="<<fd<<", max_fd="<<max_fd);
-    if (fd < 0 || fd > max_fd) {
-        KUMA_WARNTRACE("SelectPoll::unregisterFd, failed, max_fd=" << max_fd);
+    KUMA_INFOTRACE("SelectPoll::unregisterFd, fd="<<fd<<", count="<<poll_items_.count());
+    auto *item = poll_items_.find(fd);
+    if (!item) {
+        KUMA_WARNTRACE("SelectPoll::unregisterFd, failed, fd=" << fd);
         return KMError::INVALID_PARAM;
     }
     updateFdSet(fd, 0);
-    int idx = poll_items_[fd].idx;
-    if(fd < max_fd) {
-        poll_items_[fd].reset();
-    } else if (fd == max_fd) {
-        poll_items_.pop_back();
-    }
+    int idx = item->idx;
+    poll_items_.remove(fd);
     int last_idx = int(poll_fds_.size() - 1);
     if (idx > last_idx || -1 == idx) {
         return KMError::NOERR;
     }
     if (idx != last_idx) {
         std::iter_swap(poll_fds_.begin() + idx, poll_fds_.end() - 1);
-        poll_items_[poll_fds_[idx].fd].idx = idx;
+        auto *last_item = poll_items_.find(poll_fds_[idx].fd);
+        if (last_item) {
+            last_item->idx = idx;
+        }
     }
     poll_fds_.pop_back();
     return KMError::NOERR;
@@ -138,16 +136,12 @@ KMError SelectPoll::unregisterFd(SOCKET_FD fd)
 
 KMError SelectPoll::updateFd(SOCKET_FD fd, KMEvent events)
 {
-    int max_fd = int(poll_items_.size() - 1);
-    if (fd < 0 || -1 == max_fd || fd > max_fd) {
-        KUMA_WARNTRACE("SelectPoll::updateFd, failed, fd="<<fd<<", max_fd="<<max_fd);
-        return KMError::INVALID_PARAM;
-    }
-    if(poll_items_[fd].fd != fd) {
-        KUMA_WARNTRACE("SelectPoll::updateFd, failed, fd="<<fd<<", item_fd="<<poll_items_[fd].fd);
+    auto *item = poll_items_.find(fd);
+    if (!item) {
+        KUMA_WARNTRACE("SelectPoll::updateFd, failed, fd="<<fd);
         return KMError::INVALID_PARAM;
     }
-    int idx = poll_items_[fd].idx;
+    int idx = item->idx;
     if (idx < 0 || idx >= poll_fds_.size()) {
         KUMA_WARNTRACE("SelectPoll::updateFd, failed, index="<<idx);
         return KMError::INVALID_STATE;
@@ -157,7 +151,7 @@ KMError SelectPoll::updateFd(SOCKET_FD fd, KMEvent events)
         return KMError::INVALID_PARAM;
     }
     poll_fds_[idx].events = events;
-    poll_items_[fd].events = events;
+    item->events = events;
     updateFdSet(fd, events);
     return KMError::NOERR;
 }
@@ -206,6 +200,7 @@ KMError SelectPoll::wait(uint32_t wait_ms)
         tval.tv_usec = (wait_ms - tval.tv_sec*1000)*1000;
     }
     int nready = ::select(max_fd_ + 1, &readfds, &writefds, &exceptfds, wait_ms == -1 ? NULL : &tval);
+    last_event_count_ = nready > 0 ? nready : 0;
     if (nready <= 0) {
         return KMError::NOERR;
     }
@@ -227,14 +222,15 @@ KMError SelectPoll::wait(uint32_t wait_ms)
             revents |= KUMA_EV_ERROR;
             --nready;
         }
-        if (fd < poll_items_.size()) {
-            revents &= poll_items_[fd].events;
+        auto *item = poll_items_.find(fd);
+        if (item) {
+            revents &= item->events;
             if (revents) {
-                auto &cb = poll_items_[fd].cb;
-                if (cb) cb(revents, nullptr, 0);
+                invokeCallback(*item, revents, nullptr, 0);
             }
         }
     }
+    poll_items_.shrink();
     return KMError::NOERR;
 }
 
@@ -0,0 +1,639 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "UringPoll.h"
+
+#ifdef KUMA_HAS_IO_URING
+
+#include "util/kmtrace.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <signal.h>
+
+KUMA_NS_BEGIN
+
+#define URING_SQ_ENTRIES    1024
+#define URING_CQ_ENTRIES    (4 * URING_SQ_ENTRIES)
+#define URING_BUF_GROUP_ID  0
+#define URING_BUF_ENTRIES   256
+#define URING_BUF_SIZE      (16 * 1024)
+
+static int io_uring_setup(unsigned entries, io_uring_params *p)
+{
+    return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                          unsigned flags, const void *arg, size_t arg_sz)
+{
+    return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_sz);
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+    return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static uint32_t get_poll_events(KMEvent kuma_events)
+{
+    uint32_t ev = 0;
+    if(kuma_events & KUMA_EV_READ) {
+        ev |= POLLIN;
+    }
+    if(kuma_events & KUMA_EV_WRITE) {
+        ev |= POLLOUT;
+    }
+    if(kuma_events & KUMA_EV_ERROR) {
+        ev |= POLLERR | POLLHUP;
+    }
+    return ev;
+}
+
+static KMEvent get_kuma_events(uint32_t events)
+{
+    KMEvent ev = 0;
+    if(events & POLLIN) {
+        ev |= KUMA_EV_READ;
+    }
+    if(events & POLLOUT) {
+        ev |= KUMA_EV_WRITE;
+    }
+    if(events & (POLLERR | POLLHUP)) {
+        ev |= KUMA_EV_ERROR;
+    }
+    return ev;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UringBufferRing
+UringBufferRing::UringBufferRing(uint16_t bgid, uint32_t entries, uint32_t buf_size)
+: bgid_(bgid), entries_(entries), buf_size_(buf_size)
+{
+    
+}
+
+UringBufferRing::~UringBufferRing()
+{
+    if(ring_) {
+        munmap(ring_, ring_size_);
+        ring_ = nullptr;
+    }
+    if(bufs_) {
+        munmap(bufs_, bufs_size_);
+        bufs_ = nullptr;
+    }
+}
+
+bool UringBufferRing::init(int ring_fd, Notifier *notifier)
+{
+    notifier_ = notifier;
+    ring_size_ = entries_ * sizeof(io_uring_buf);
+    void *ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ring == MAP_FAILED) {
+        return false;
+    }
+    ring_ = (io_uring_buf_ring*)ring;
+    bufs_size_ = size_t(entries_) * buf_size_;
+    void *bufs = mmap(nullptr, bufs_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(bufs == MAP_FAILED) {
+        return false;
+    }
+    bufs_ = (uint8_t*)bufs;
+    
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring_;
+    reg.ring_entries = entries_;
+    reg.bgid = bgid_;
+    if(io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        KUMA_WARNTRACE("UringBufferRing::init, failed to register buffer ring, errno="<<errno);
+        return false;
+    }
+    thread_id_ = std::this_thread::get_id();
+    for(uint32_t i = 0; i < entries_; ++i) {
+        provide(uint16_t(i));
+    }
+    __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE);
+    return true;
+}
+
+void UringBufferRing::detach()
+{
+    std::lock_guard<std::mutex> g(mutex_);
+    detached_ = true;
+    notifier_ = nullptr;
+}
+
+void UringBufferRing::provide(uint16_t bid)
+{
+    // the tail overlays resv of the first entry, only addr, len and bid are written.
+    // index the entries directly, __DECLARE_FLEX_ARRAY puts bufs at offset 8 in C++
+    auto &buf = ((io_uring_buf*)ring_)[tail_ & (entries_ - 1)];
+    buf.addr = (uint64_t)(uintptr_t)(bufs_ + size_t(bid) * buf_size_);
+    buf.len = buf_size_;
+    buf.bid = bid;
+    ++tail_;
+}
+
+void UringBufferRing::release(uint16_t bid)
+{
+    if(detached_) {
+        return;
+    }
+    if(std::this_thread::get_id() == thread_id_) {
+        provide(bid);
+        __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE);
+    } else {
+        std::lock_guard<std::mutex> g(mutex_);
+        bool was_empty = released_.empty();
+        released_.push_back(bid);
+        has_released_.store(true, std::memory_order_release);
+        if(was_empty && notifier_) {
+            // the loop may be sleeping with no buffer left to receive
+            notifier_->notify();
+        }
+    }
+}
+
+void UringBufferRing::flushReleased()
+{
+    if(!has_released_.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::vector<uint16_t> released;
+    {
+        std::lock_guard<std::mutex> g(mutex_);
+        released.swap(released_);
+        has_released_.store(false, std::memory_order_relaxed);
+    }
+    for(auto bid : released) {
+        provide(bid);
+    }
+    __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE);
+}
+
+KMBuffer UringBufferRing::takeBuffer(const std::shared_ptr<UringBufferRing> &self, uint16_t bid, size_t offset, size_t len)
+{
+    auto dd = [self, bid](void*, size_t) {
+        self->release(bid);
+    };
+    return KMBuffer(buffer(bid), buf_size_, len, offset, dd);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UringPoll
+UringPoll::UringPoll()
+{
+    
+}
+
+UringPoll::~UringPoll()
+{
+    // close the ring first, the kernel may access the rings until it is released
+    if(INVALID_FD != ring_fd_) {
+        close(ring_fd_);
+        ring_fd_ = INVALID_FD;
+    }
+    if(buf_ring_) {
+        // the ring memory is freed when all the buffers taken are released
+        buf_ring_->detach();
+        buf_ring_.reset();
+    }
+    if(sqes_) {
+        munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if(cq_ring_ && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = nullptr;
+    if(sq_ring_) {
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = nullptr;
+    }
+}
+
+bool UringPoll::isSupported()
+{
+    static int supported = -1;
+    if(supported == -1) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = io_uring_setup(2, &p);
+        if(fd < 0) {
+            supported = 0;
+        } else {
+            uint32_t required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+            supported = (p.features & required) == required ? 1 : 0;
+            close(fd);
+        }
+    }
+    return supported == 1;
+}
+
+bool UringPoll::init()
+{
+    if(INVALID_FD != ring_fd_) {
+        return true;
+    }
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = URING_CQ_ENTRIES;
+    p.flags |= IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    ring_fd_ = io_uring_setup(URING_SQ_ENTRIES, &p);
+    if(ring_fd_ < 0 && errno == EINVAL) { // old kernel
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = URING_CQ_ENTRIES;
+        ring_fd_ = io_uring_setup(URING_SQ_ENTRIES, &p);
+    }
+    if(ring_fd_ < 0) {
+        KUMA_ERRTRACE("UringPoll::init, io_uring_setup failed, errno="<<errno);
+        ring_fd_ = INVALID_FD;
+        return false;
+    }
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        KUMA_ERRTRACE("UringPoll::init, unsupported kernel, features="<<p.features);
+        return false;
+    }
+    sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if(cq_ring_size_ > sq_ring_size_) {
+        sq_ring_size_ = cq_ring_size_;
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if(sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        KUMA_ERRTRACE("UringPoll::init, failed to mmap ring, errno="<<errno);
+        return false;
+    }
+    cq_ring_ = sq_ring_;
+    cq_ring_size_ = sq_ring_size_;
+    sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        KUMA_ERRTRACE("UringPoll::init, failed to mmap sqes, errno="<<errno);
+        return false;
+    }
+    sqes_ = (io_uring_sqe*)sqes;
+    auto *sq = (uint8_t*)sq_ring_;
+    sq_head_ = (uint32_t*)(sq + p.sq_off.head);
+    sq_tail_ = (uint32_t*)(sq + p.sq_off.tail);
+    sq_mask_ = (uint32_t*)(sq + p.sq_off.ring_mask);
+    sq_array_ = (uint32_t*)(sq + p.sq_off.array);
+    sq_entries_ = p.sq_entries;
+    auto *cq = (uint8_t*)cq_ring_;
+    cq_head_ = (uint32_t*)(cq + p.cq_off.head);
+    cq_tail_ = (uint32_t*)(cq + p.cq_off.tail);
+    cq_mask_ = (uint32_t*)(cq + p.cq_off.ring_mask);
+    cqes_ = (io_uring_cqe*)(cq + p.cq_off.cqes);
+    
+    buf_ring_ = std::make_shared<UringBufferRing>(URING_BUF_GROUP_ID, URING_BUF_ENTRIES, URING_BUF_SIZE);
+    if(!buf_ring_->init(ring_fd_, notifier_.get())) {
+        // kernel before 5.19, receive into the buffer of each socket
+        buf_ring_.reset();
+    }
+    
+    if (!notifier_->ready()) {
+        if(!notifier_->init()) {
+            return false;
+        }
+        IOCallback cb ([this](KMEvent ev, void*, size_t) { notifier_->onEvent(ev); });
+        registerFd(notifier_->getReadFD(), KUMA_EV_READ|KUMA_EV_ERROR, std::move(cb));
+    }
+    return true;
+}
+
+io_uring_sqe* UringPoll::getSqe()
+{
+    uint32_t tail = *sq_tail_;
+    uint32_t head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if(tail - head >= sq_entries_) {
+        // submission queue is full, submit them now
+        submitAndWait(0);
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if(tail - head >= sq_entries_) {
+            KUMA_ERRTRACE("UringPoll::getSqe, submission queue is full");
+            return nullptr;
+        }
+    }
+    uint32_t idx = tail & *sq_mask_;
+    io_uring_sqe *sqe = &sqes_[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[idx] = idx;
+    // kernel reads the SQEs only in io_uring_enter, it is safe to publish before filling
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++sq_pending_;
+    return sqe;
+}
+
+int UringPoll::submitAndWait(uint32_t wait_ms)
+{
+    unsigned flags = 0;
+    unsigned min_complete = 0;
+    io_uring_getevents_arg arg;
+    __kernel_timespec ts;
+    memset(&arg, 0, sizeof(arg));
+    if(wait_ms != 0) {
+        flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        min_complete = 1;
+        arg.sigmask_sz = _NSIG / 8;
+        if(wait_ms != (uint32_t)-1) {
+            ts.tv_sec = wait_ms / 1000;
+            ts.tv_nsec = (wait_ms % 1000) * 1000000;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+    } else if(sq_pending_ == 0) {
+        return 0;
+    }
+    int ret = io_uring_enter(ring_fd_, sq_pending_, min_complete, flags,
+                             flags ? &arg : nullptr, flags ? sizeof(arg) : 0);
+    if(ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+        KUMA_ERRTRACE("UringPoll::submitAndWait, errno="<<errno);
+    }
+    // the SQEs not consumed will be submitted next time
+    sq_pending_ = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    return ret;
+}
+
+void UringPoll::processCompletions()
+{
+    uint32_t head = *cq_head_;
+    uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    last_event_count_ = 0;
+    while(head != tail) {
+        ++last_event_count_;
+        io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+        uint64_t user_data = cqe->user_data;
+        int32_t res = cqe->res;
+        uint32_t cqe_flags = cqe->flags;
+        // release the CQE before callback, the callback may submit new SQEs
+        __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+        if(head == tail) {
+            tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        }
+        if(user_data == 0) {
+            continue; // cancel or poll remove
+        }
+        if(user_data & 1) { // poll request
+            SOCKET_FD fd = (SOCKET_FD)((user_data >> 1) & 0x7FFFFFFF);
+            uint32_t gen = (uint32_t)(user_data >> 32);
+            auto *item = poll_items_.find(fd);
+            if(!item || item->gen != gen) {
+                continue; // the poll is removed
+            }
+            if(!(cqe_flags & IORING_CQE_F_MORE)) {
+                // multishot poll is terminated, arm it again
+                submitPoll(*item);
+            }
+            if(res == -ECANCELED) {
+                continue;
+            }
+            KMEvent revents = res < 0 ? KUMA_EV_ERROR : get_kuma_events(uint32_t(res));
+            revents &= item->events;
+            if(revents) {
+                invokeCallback(*item, revents, nullptr, 0);
+            }
+        } else {
+            auto *op = (UringOp*)(uintptr_t)user_data;
+            op->res = res;
+            op->flags = cqe_flags;
+            SOCKET_FD fd = op->fd;
+            auto *item = poll_items_.find(fd);
+            if(item) {
+                if(res < 0) {
+                    invokeCallback(*item, KUMA_EV_ERROR, op, 0);
+                } else {
+                    invokeCallback(*item, 0, op, size_t(res));
+                }
+            }
+        }
+    }
+}
+
+uint64_t UringPoll::pollUserData(const PollItem &item) const
+{
+    return (uint64_t(item.gen) << 32) | (uint64_t(item.fd) << 1) | 1;
+}
+
+bool UringPoll::submitPoll(PollItem &item)
+{
+    auto *sqe = getSqe();
+    if(!sqe) {
+        return false;
+    }
+    // a new generation for each poll request, the completions of old ones are ignored
+    item.gen = ++poll_gen_;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = item.fd;
+    sqe->poll32_events = get_poll_events(item.events);
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = pollUserData(item);
+    return true;
+}
+
+void UringPoll::removePoll(PollItem &item)
+{
+    if(item.events != 0) {
+        auto *sqe = getSqe();
+        if(sqe) {
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = pollUserData(item);
+            sqe->user_data = 0;
+        }
+    }
+    item.gen = ++poll_gen_;
+}
+
+KMError UringPoll::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
+{
+    if (fd < 0) {
+        return KMError::INVALID_PARAM;
+    }
+    auto *old_item = poll_items_.find(fd);
+    if (old_item) {
+        removePoll(*old_item);
+    }
+    auto &item = poll_items_.add(fd);
+    item.events = events;
+    item.cb = std::move(cb);
+    // the fd of completion operations is registered with no event
+    if (events != 0 && !submitPoll(item)) {
+        poll_items_.remove(fd);
+        return KMError::FAILED;
+    }
+    KUMA_INFOTRACE("UringPoll::registerFd, fd=" << fd << ", ev=" << events);
+    return KMError::NOERR;
+}
+
+KMError UringPoll::unregisterFd(SOCKET_FD fd)
+{
+    KUMA_INFOTRACE("UringPoll::unregisterFd, fd="<<fd<<", count="<<poll_items_.count());
+    auto *item = poll_items_.find(fd);
+    if (!item) {
+        KUMA_WARNTRACE("UringPoll::unregisterFd, failed, fd=" << fd);
+        return KMError::INVALID_PARAM;
+    }
+    removePoll(*item);
+    poll_items_.remove(fd);
+    return KMError::NOERR;
+}
+
+KMError UringPoll::updateFd(SOCKET_FD fd, KMEvent events)
+{
+    auto *item = poll_items_.find(fd);
+    if(!item) {
+        return KMError::FAILED;
+    }
+    removePoll(*item);
+    item->events = events;
+    if (events != 0 && !submitPoll(*item)) {
+        return KMError::FAILED;
+    }
+    return KMError::NOERR;
+}
+
+KMError UringPoll::wait(uint32_t wait_ms)
+{
+    if(*cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        wait_ms = 0; // completions are ready
+    }
+    if(buf_ring_) {
+        buf_ring_->flushReleased();
+    }
+    submitAndWait(wait_ms);
+    processCompletions();
+    poll_items_.shrink();
+    return KMError::NOERR;
+}
+
+void UringPoll::notify()
+{
+    notifier_->notify();
+}
+
+bool UringPoll::submitRecv(UringOp *op, void *buf, size_t len)
+{
+    auto *sqe = getSqe();
+    if(!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = op->fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+    return true;
+}
+
+bool UringPoll::submitRecvFromRing(UringOp *op)
+{
+    if(!buf_ring_) {
+        return false;
+    }
+    auto *sqe = getSqe();
+    if(!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = op->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buf_ring_->groupId();
+    sqe->len = buf_ring_->bufferSize();
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+    return true;
+}
+
+bool UringPoll::takeRingBuffer(const UringOp *op, size_t len, UringRingBuffer &rb)
+{
+    if(!buf_ring_ || !(op->flags & IORING_CQE_F_BUFFER)) {
+        return false;
+    }
+    uint16_t bid = uint16_t(op->flags >> IORING_CQE_BUFFER_SHIFT);
+    rb.attach(buf_ring_, bid, len);
+    return true;
+}
+
+bool UringPoll::submitSend(UringOp *op, const void *buf, size_t len)
+{
+    auto *sqe = getSqe();
+    if(!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = op->fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+    return true;
+}
+
+bool UringPoll::submitConnect(UringOp *op, const sockaddr *addr, socklen_t addr_len)
+{
+    auto *sqe = getSqe();
+    if(!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = op->fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->off = addr_len;
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+    return true;
+}
+
+bool UringPoll::submitAccept(UringOp *op, sockaddr *addr, socklen_t *addr_len)
+{
+    auto *sqe = getSqe();
+    if(!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = op->fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->addr2 = (uint64_t)(uintptr_t)addr_len;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+    return true;
+}
+
+bool UringPoll::submitCancel(UringOp *op)
+{
+    auto *sqe = getSqe();
+    if(!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)op;
+    sqe->user_data = 0;
+    return true;
+}
+
+IOPoll* createUringPoll() {
+    if (!UringPoll::isSupported()) {
+        return nullptr;
+    }
+    return new UringPoll();
+}
+
+KUMA_NS_END
+
+#endif // KUMA_HAS_IO_URING
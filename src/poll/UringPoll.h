@@ -0,0 +1,247 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __UringPoll_H__
+#define __UringPoll_H__
+
+#include "IOPoll.h"
+
+#if defined(KUMA_OS_LINUX) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+// built with linux 5.19+ uapi for provided buffer ring, multishot poll and ext arg
+// of io_uring_enter are required at runtime, linux 5.13+
+#  if defined(IORING_POLL_ADD_MULTI) && defined(IORING_SETUP_COOP_TASKRUN)
+#   define KUMA_HAS_IO_URING
+#  endif
+# endif
+#endif
+
+#ifdef KUMA_HAS_IO_URING
+
+#include "Notifier.h"
+#include "kmbuffer.h"
+
+#include <string.h>
+#include <mutex>
+#include <thread>
+
+KUMA_NS_BEGIN
+
+/**
+ * UringOp is the user data of a completion operation, like OVERLAPPED of IOCP.
+ * the completion is delivered to the IOCallback of op->fd as cb(events, op, io_size),
+ * events is KUMA_EV_ERROR if the operation failed. res and flags are the ones of the CQE
+ */
+struct UringOp
+{
+    SOCKET_FD   fd = INVALID_FD;
+    int32_t     res = 0;
+    uint32_t    flags = 0;
+};
+
+/**
+ * UringBufferRing is the provided buffer ring shared by all sockets of a loop. the kernel
+ * picks a buffer only when data arrives, so the idle sockets hold no receive memory.
+ * the buffer is delivered as KMBuffer and returned to the ring when the KMBuffer is
+ * released, it can be released in any thread
+ */
+class UringBufferRing
+{
+public:
+    UringBufferRing(uint16_t bgid, uint32_t entries, uint32_t buf_size);
+    ~UringBufferRing();
+    
+    // the notifier wakes up the loop when a buffer is released in other thread
+    bool init(int ring_fd, Notifier *notifier);
+    // the io_uring is closing, the released buffers are not returned any more
+    void detach();
+    // return the buffers released in other threads, called in loop thread
+    void flushReleased();
+    // the KMBuffer references the buffer and returns it when released
+    KMBuffer takeBuffer(const std::shared_ptr<UringBufferRing> &self, uint16_t bid, size_t offset, size_t len);
+    // return the buffer to ring, can be called in any thread
+    void release(uint16_t bid);
+    
+    uint8_t* buffer(uint16_t bid) const { return bufs_ + size_t(bid) * buf_size_; }
+    uint16_t groupId() const { return bgid_; }
+    uint32_t bufferSize() const { return buf_size_; }
+    
+private:
+    void provide(uint16_t bid);
+    
+private:
+    uint16_t            bgid_;
+    uint32_t            entries_;
+    uint32_t            buf_size_;
+    io_uring_buf_ring*  ring_ = nullptr;
+    size_t              ring_size_ = 0;
+    uint8_t*            bufs_ = nullptr;
+    size_t              bufs_size_ = 0;
+    uint16_t            tail_ = 0;
+    std::thread::id     thread_id_;
+    Notifier*           notifier_ = nullptr; // protected by mutex_
+    
+    std::atomic<bool>   detached_{ false };
+    std::atomic<bool>   has_released_{ false };
+    std::mutex          mutex_;
+    std::vector<uint16_t> released_; // released in other threads
+};
+using UringBufferRingPtr = std::shared_ptr<UringBufferRing>;
+
+/**
+ * UringRingBuffer holds the data received in a buffer of buffer ring. the buffer is
+ * returned to ring once the data is drained, or handed over by take without copy
+ */
+class UringRingBuffer
+{
+public:
+    UringRingBuffer() = default;
+    UringRingBuffer(const UringRingBuffer &) = delete;
+    UringRingBuffer& operator=(const UringRingBuffer &) = delete;
+    ~UringRingBuffer() { reset(); }
+    
+    void attach(const UringBufferRingPtr &ring, uint16_t bid, size_t len)
+    {
+        reset();
+        if (ring_ != ring) {
+            ring_ = ring;
+        }
+        bid_ = bid;
+        offset_ = 0;
+        len_ = len;
+        held_ = true;
+        if (len_ == 0) {
+            reset();
+        }
+    }
+    size_t read(void *data, size_t len)
+    {
+        if (!held_) {
+            return 0;
+        }
+        if (len > len_ - offset_) {
+            len = len_ - offset_;
+        }
+        memcpy(data, ring_->buffer(bid_) + offset_, len);
+        offset_ += len;
+        if (offset_ == len_) {
+            reset();
+        }
+        return len;
+    }
+    KMBuffer take()
+    {
+        if (!held_) {
+            return KMBuffer();
+        }
+        held_ = false;
+        return ring_->takeBuffer(ring_, bid_, offset_, len_ - offset_);
+    }
+    void reset()
+    {
+        if (held_) {
+            held_ = false;
+            ring_->release(bid_);
+        }
+    }
+    bool empty() const { return !held_; }
+    size_t size() const { return held_ ? len_ - offset_ : 0; }
+    
+private:
+    UringBufferRingPtr  ring_;
+    uint16_t            bid_ = 0;
+    size_t              offset_ = 0;
+    size_t              len_ = 0;
+    bool                held_ = false;
+};
+
+/**
+ * UringPoll is the io_uring backend. the fds registered by registerFd are polled with
+ * multishot POLL_ADD, so the readiness based sockets still work, and UringSocket and
+ * UringAcceptor submit recv/send/accept/connect as completion operations.
+ * the SQEs are submitted with the wait of loop
+ */
+class UringPoll : public IOPoll
+{
+public:
+    UringPoll();
+    ~UringPoll();
+    
+    bool init() override;
+    KMError registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb) override;
+    KMError unregisterFd(SOCKET_FD fd) override;
+    KMError updateFd(SOCKET_FD fd, KMEvent events) override;
+    KMError wait(uint32_t wait_time_ms) override;
+    void notify() override;
+    PollType getType() const override { return PollType::IO_URING; }
+    bool isLevelTriggered() const override { return false; }
+    
+    bool submitRecv(UringOp *op, void *buf, size_t len);
+    // receive into a buffer picked from the provided buffer ring
+    bool submitRecvFromRing(UringOp *op);
+    bool hasBufferRing() const { return !!buf_ring_; }
+    uint32_t ringBufferSize() const { return buf_ring_ ? buf_ring_->bufferSize() : 0; }
+    // attach the buffer of a completed ring receive, op->flags has IORING_CQE_F_BUFFER
+    bool takeRingBuffer(const UringOp *op, size_t len, UringRingBuffer &rb);
+    bool submitSend(UringOp *op, const void *buf, size_t len);
+    bool submitConnect(UringOp *op, const sockaddr *addr, socklen_t addr_len);
+    bool submitAccept(UringOp *op, sockaddr *addr, socklen_t *addr_len);
+    // the cancelled operation is completed with -ECANCELED
+    bool submitCancel(UringOp *op);
+    
+    // whether io_uring is available in this kernel
+    static bool isSupported();
+    
+private:
+    io_uring_sqe* getSqe();
+    int submitAndWait(uint32_t wait_ms);
+    void processCompletions();
+    bool submitPoll(PollItem &item);
+    void removePoll(PollItem &item);
+    uint64_t pollUserData(const PollItem &item) const;
+    
+private:
+    int             ring_fd_ = INVALID_FD;
+    // submission queue
+    void*           sq_ring_ = nullptr;
+    size_t          sq_ring_size_ = 0;
+    uint32_t*       sq_head_ = nullptr;
+    uint32_t*       sq_tail_ = nullptr;
+    uint32_t*       sq_mask_ = nullptr;
+    uint32_t*       sq_array_ = nullptr;
+    io_uring_sqe*   sqes_ = nullptr;
+    size_t          sqes_size_ = 0;
+    uint32_t        sq_entries_ = 0;
+    uint32_t        sq_pending_ = 0; // SQEs queued but not submitted
+    // completion queue
+    void*           cq_ring_ = nullptr;
+    size_t          cq_ring_size_ = 0;
+    uint32_t*       cq_head_ = nullptr;
+    uint32_t*       cq_tail_ = nullptr;
+    uint32_t*       cq_mask_ = nullptr;
+    io_uring_cqe*   cqes_ = nullptr;
+    
+    // generation of poll requests, the completions of removed polls are ignored
+    uint32_t        poll_gen_ = 0;
+    NotifierPtr     notifier_ { Notifier::createNotifier() };
+    UringBufferRingPtr buf_ring_;
+};
+
+KUMA_NS_END
+
+#endif // KUMA_HAS_IO_URING
+
+#endif
@@ -122,19 +122,18 @@ KMError VPoll::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
     if (fd < 0) {
         return KMError::INVALID_PARAM;
     }
-    resizePollItems(fd);
     int idx = -1;
-    if (INVALID_FD == poll_items_[fd].fd || -1 == poll_items_[fd].idx) { // new
+    auto &item = poll_items_.add(fd);
+    if (-1 == item.idx) { // new
         pollfd pfd;
         pfd.fd = fd;
         pfd.events = get_events(events);
         poll_fds_.push_back(pfd);
         idx = int(poll_fds_.size() - 1);
-        poll_items_[fd].idx = idx;
+        item.idx = idx;
     }
-    poll_items_[fd].fd = fd;
-    poll_items_[fd].events = events;
-    poll_items_[fd].cb = std::move(cb);
+    item.events = events;
+    item.cb = std::move(cb);
     KUMA_INFOTRACE("VPoll::registerFd, fd="<<fd<<", events="<<events<<", index="<<idx);
     
     return KMError::NOERR;
@@ -142,18 +141,14 @@ KMError VPoll::registerFd(SOCKET_FD fd, KMEvent events, IOCallback cb)
 
 KMError VPoll::unregisterFd(SOCKET_FD fd)
 {
-    int max_fd = int(poll_items_.size() - 1);
-    KUMA_INFOTRACE("VPoll::unregisterFd, fd="<<fd<<", max_fd="<<max_fd);
-    if (fd < 0 || -1 == max_fd || fd > max_fd) {
-        KUMA_WARNTRACE("VPoll::unregisterFd, failed, max_fd="<<max_fd);
+    KUMA_INFOTRACE("VPoll::unregisterFd, fd="<<fd<<", count="<<poll_items_.count());
+    auto *item = poll_items_.find(fd);
+    if (!item) {
+        KUMA_WARNTRACE("VPoll::unregisterFd, failed, fd="<<fd);
         return KMError::INVALID_PARAM;
     }
-    int idx = poll_items_[fd].idx;
-    if(fd < max_fd) {
-        poll_items_[fd].reset();
-    } else if (fd == max_fd) {
-        poll_items_.pop_back();
-    }
+    int idx = item->idx;
+    poll_items_.remove(fd);
     
     int last_idx = int(poll_fds_.size() - 1);
     if (idx > last_idx || -1 == idx) {
@@ -161,7 +156,10 @@ KMError VPoll::unregisterFd(SOCKET_FD fd)
     }
     if (idx != last_idx) {
         std::iter_swap(poll_fds_.begin()+idx, poll_fds_.end()-1);
-        poll_items_[poll_fds_[idx].fd].idx = idx;
+        auto *last_item = poll_items_.find(poll_fds_[idx].fd);
+        if (last_item) {
+            last_item->idx = idx;
+        }
     }
     poll_fds_.pop_back();
     return KMError::NOERR;
@@ -169,16 +167,12 @@ KMError VPoll::unregisterFd(SOCKET_FD fd)
 
 KMError VPoll::updateFd(SOCKET_FD fd, KMEvent events)
 {
-    int max_fd = int(poll_items_.size() - 1);
-    if (fd < 0 || -1 == max_fd || fd > max_fd) {
-        KUMA_WARNTRACE("VPoll::updateFd, failed, fd="<<fd<<", max_fd="<<max_fd);
-        return KMError::INVALID_PARAM;
-    }
-    if(poll_items_[fd].fd != fd) {
-        KUMA_WARNTRACE("VPoll::updateFd, failed, fd="<<fd<<", item_fd="<<poll_items_[fd].fd);
+    auto *item = poll_items_.find(fd);
+    if (!item) {
+        KUMA_WARNTRACE("VPoll::updateFd, failed, fd="<<fd);
         return KMError::INVALID_PARAM;
     }
-    int idx = poll_items_[fd].idx;
+    int idx = item->idx;
     if (idx < 0 || idx >= poll_fds_.size()) {
         KUMA_WARNTRACE("VPoll::updateFd, failed, index="<<idx);
         return KMError::INVALID_STATE;
@@ -188,7 +182,7 @@ KMError VPoll::updateFd(SOCKET_FD fd, KMEvent events)
         return KMError::INVALID_PARAM;
     }
     poll_fds_[idx].events = get_events(events);
-    poll_items_[fd].events = events;
+    item->events = events;
     return KMError::NOERR;
 }
 
@@ -199,6 +193,7 @@ KMError VPoll::wait(uint32_t wait_ms)
 #else
     int num_revts = poll(&poll_fds_[0], (nfds_t)poll_fds_.size(), wait_ms);
 #endif
+    last_event_count_ = num_revts > 0 ? num_revts : 0;
     if (-1 == num_revts) {
         if(EINTR == errno) {
             errno = 0;
@@ -216,17 +211,18 @@ KMError VPoll::wait(uint32_t wait_ms)
     while(num_revts > 0 && idx <= last_idx) {
         if(poll_fds[idx].revents) {
             --num_revts;
-            if(poll_fds[idx].fd < poll_items_.size()) {
-                auto &item = poll_items_[poll_fds[idx].fd];
+            auto *item = poll_items_.find(poll_fds[idx].fd);
+            if(item) {
                 auto revents = get_kuma_events(poll_fds[idx].revents);
-                revents &= item.events;
-                if (revents && item.cb) {
-                    item.cb(revents, nullptr, 0);
+                revents &= item->events;
+                if (revents) {
+                    invokeCallback(*item, revents, nullptr, 0);
                 }
             }
         }
         ++idx;
     }
+    poll_items_.shrink();
     return KMError::NOERR;
 }
 
@@ -176,7 +176,9 @@ KMError WinPoll::updateFd(SOCKET_FD fd, uint32_t events)
 KMError WinPoll::wait(uint32_t wait_ms)
 {
     MSG msg;
+    last_event_count_ = 0;
     if (GetMessage(&msg, NULL, 0, 0)) {
+        last_event_count_ = 1;
         TranslateMessage(&msg);
         DispatchMessage(&msg);
     }
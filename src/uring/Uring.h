@@ -0,0 +1,464 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __URING_H__
+#define __URING_H__
+
+#include "kmdefs.h"
+#include "util/kmtrace.h"
+#include "util/skbuffer.h"
+#include "EventLoopImpl.h"
+#include "poll/UringPoll.h"
+
+#ifdef KUMA_HAS_IO_URING
+
+KUMA_NS_BEGIN
+
+const size_t UringRecvPacketSize = 16 * 1024;
+
+struct UringContext : public UringOp
+{
+    enum class Op
+    {
+        NONE,
+        CONNECT,
+        ACCEPT,
+        SEND,
+        RECV
+    };
+
+    Op                  op = Op::NONE;
+    SKBuffer            buf;
+    UringRingBuffer     ring_buf; // the received buffer of provided buffer ring
+    sockaddr_storage    ss_addr;
+    socklen_t           addr_len = 0;
+
+    bool bufferEmpty() const
+    {
+        return buf.empty() && ring_buf.empty();
+    }
+
+    void prepare(SOCKET_FD fd, Op op)
+    {
+        this->fd = fd;
+        this->op = op;
+    }
+};
+using UringContextPtr = std::unique_ptr < UringContext >;
+
+// UringWrapper holds the contexts and buffers used by the submitted operations, it can
+// only be deleted after all pending operations are completed, or event loop is stopped
+class UringWrapper : public PendingObject
+{
+public:
+    using UringCallback = std::function<void(UringContext::Op op, KMError err, size_t io_size)>;
+
+    bool isPending() const override
+    {
+        return send_pending_ || recv_pending_;
+    }
+
+    void onLoopExit() override
+    {
+        // loop exited, there are no more IO events
+        loop_.reset();
+        poll_ = nullptr;
+        resetPending();
+    }
+
+    void cancel()
+    {
+        if (!poll_) {
+            return;
+        }
+        if (recv_pending_) {
+            poll_->submitCancel(recv_ctx_.get());
+        }
+        if (send_pending_) {
+            poll_->submitCancel(send_ctx_.get());
+        }
+    }
+
+    bool registerFd(const EventLoopPtr &loop, SOCKET_FD fd, const KMObject *obj=nullptr)
+    {
+        if (!loop || fd == INVALID_FD) {
+            return false;
+        }
+        // no readiness event, the operations are completed through the registered callback
+        if (loop->registerFd(fd, 0, [this](KMEvent ev, void* op, size_t io_size) {
+            ioReady(ev, op, io_size);
+        }, obj) == KMError::NOERR)
+        {
+            loop_ = loop;
+            poll_ = getPoll(loop);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * return false if there are pending operations
+     */
+    bool unregisterFd(const EventLoopPtr &loop, SOCKET_FD fd, bool close_fd)
+    {
+        if (fd == INVALID_FD) {
+            return true;
+        }
+        if (loop) {
+            if (isPending()) {
+                // wait until all pending operations are completed, or loop exit
+                shutdown(fd, SHUT_RDWR);
+
+                closing_ = true;
+                pending_fd_ = fd;
+                loop_ = loop;
+                loop->appendPendingObject(this);
+
+                cancel();
+                return false;
+            }
+            loop->unregisterFd(fd, close_fd);
+        }
+        else if (close_fd) {
+            closeFd(fd);
+            resetPending();
+        }
+        return true;
+    }
+
+    bool postConnectOperation(SOCKET_FD fd, const sockaddr_storage &ss_addr)
+    {
+        if (!poll_) {
+            return false;
+        }
+        if (!recv_ctx_) {
+            recv_ctx_.reset(new UringContext);
+        }
+        recv_ctx_->prepare(fd, UringContext::Op::CONNECT);
+        recv_ctx_->ss_addr = ss_addr;
+        recv_ctx_->addr_len = km_get_addr_length(ss_addr);
+        if (!poll_->submitConnect(recv_ctx_.get(), (const sockaddr*)&recv_ctx_->ss_addr, recv_ctx_->addr_len)) {
+            KUMA_ERRTRACE("postConnectOperation, error, fd=" << fd);
+            return false;
+        }
+        recv_pending_ = true;
+        increment();
+        return true;
+    }
+
+    bool postAcceptOperation(SOCKET_FD fd)
+    {
+        if (!poll_) {
+            return false;
+        }
+        if (!recv_ctx_) {
+            recv_ctx_.reset(new UringContext);
+        }
+        recv_ctx_->prepare(fd, UringContext::Op::ACCEPT);
+        recv_ctx_->addr_len = sizeof(recv_ctx_->ss_addr);
+        if (!poll_->submitAccept(recv_ctx_.get(), (sockaddr*)&recv_ctx_->ss_addr, &recv_ctx_->addr_len)) {
+            KUMA_ERRTRACE("postAcceptOperation, fd=" << fd);
+            return false;
+        }
+        recv_pending_ = true;
+        increment();
+        return true;
+    }
+
+    int postSendOperation(SOCKET_FD fd)
+    {
+        if (!send_ctx_) {
+            send_ctx_.reset(new UringContext);
+        }
+        if (send_ctx_->bufferEmpty() || send_pending_) {
+            return 0;
+        }
+        if (!poll_) {
+            return -1;
+        }
+        send_ctx_->prepare(fd, UringContext::Op::SEND);
+        if (!poll_->submitSend(send_ctx_.get(), send_ctx_->buf.ptr(), send_ctx_->buf.size())) {
+            return -1;
+        }
+        send_pending_ = true;
+        increment();
+        return 0;
+    }
+
+    /**
+     * the data is received into a buffer of the provided buffer ring if available,
+     * so no receive buffer is held while waiting for data
+     */
+    int postRecvOperation(SOCKET_FD fd, bool from_ring = true)
+    {
+        if (!recv_ctx_) {
+            recv_ctx_.reset(new UringContext);
+        }
+        if (recv_pending_) {
+            return 0;
+        }
+        if (!poll_) {
+            return -1;
+        }
+        if (!recv_ctx_->bufferEmpty()) {
+            KUMA_WARNTRACE("postRecvOperation, fd=" << fd << ", buf=" << recv_ctx_->buf.size());
+        }
+        recv_ctx_->prepare(fd, UringContext::Op::RECV);
+        if (from_ring && poll_->hasBufferRing() && recv_ctx_->buf.empty()) {
+            if (!poll_->submitRecvFromRing(recv_ctx_.get())) {
+                return -1;
+            }
+        } else {
+            recv_ctx_->buf.expand(UringRecvPacketSize);
+            if (!poll_->submitRecv(recv_ctx_.get(), recv_ctx_->buf.wr_ptr(), recv_ctx_->buf.space())) {
+                return -1;
+            }
+        }
+        recv_pending_ = true;
+        increment();
+        return 0;
+    }
+
+    void ioReady(KMEvent events, void* op, size_t io_size)
+    {
+        KMError err = (events & KUMA_EV_ERROR) ? KMError::SOCK_ERROR : KMError::NOERR;
+        if (recv_ctx_ && op == static_cast<UringOp*>(recv_ctx_.get())) {
+            recv_pending_ = false;
+            if (decrement() || closing_) {
+                return;
+            }
+            if (recv_ctx_->op == UringContext::Op::RECV) {
+                if (recv_ctx_->res == -ENOBUFS) {
+                    // the buffer ring is exhausted, receive into own buffer this time
+                    postRecvOperation(recv_ctx_->fd, false);
+                    return;
+                }
+                if (recv_ctx_->flags & IORING_CQE_F_BUFFER) {
+                    poll_->takeRingBuffer(recv_ctx_.get(), io_size, recv_ctx_->ring_buf);
+                    recv_full_ = io_size == poll_->ringBufferSize();
+                } else {
+                    if (io_size > recvBuffer().space()) {
+                        KUMA_ERRTRACE("ioReady, recv error, io_size=" << io_size << ", space=" << recvBuffer().space());
+                    }
+                    recvBuffer().bytes_written(io_size);
+                    recv_full_ = recvBuffer().space() == 0;
+                }
+            }
+            if (callback_) callback_(recv_ctx_->op, err, io_size);
+        }
+        else if (send_ctx_ && op == static_cast<UringOp*>(send_ctx_.get())) {
+            send_pending_ = false;
+            if (decrement() || closing_) {
+                return;
+            }
+            sendBuffer().bytes_read(io_size);
+            if (callback_) callback_(send_ctx_->op, err, io_size);
+        }
+        else {
+            KUMA_WARNTRACE("ioReady, invalid operation");
+        }
+    }
+
+    SKBuffer& sendBuffer()
+    {
+        if (!send_ctx_) {
+            send_ctx_.reset(new UringContext);
+        }
+        return send_ctx_->buf;
+    }
+
+    SKBuffer& recvBuffer()
+    {
+        if (!recv_ctx_) {
+            recv_ctx_.reset(new UringContext);
+        }
+        return recv_ctx_->buf;
+    }
+
+    /**
+     * read the received data, the buffer of buffer ring is returned once it is drained
+     */
+    size_t readReceived(void *data, size_t len)
+    {
+        if (!recv_ctx_) {
+            return 0;
+        }
+        size_t bytes_read = 0;
+        if (!recv_ctx_->ring_buf.empty()) {
+            bytes_read = recv_ctx_->ring_buf.read(data, len);
+        }
+        if (bytes_read < len && !recv_ctx_->buf.empty()) {
+            bytes_read += recv_ctx_->buf.read((uint8_t*)data + bytes_read, len - bytes_read);
+        }
+        return bytes_read;
+    }
+
+    /**
+     * take the received data without copy if it is in the buffer of buffer ring
+     */
+    size_t takeReceived(KMBuffer &buf)
+    {
+        if (!recv_ctx_) {
+            return 0;
+        }
+        if (!recv_ctx_->ring_buf.empty()) {
+            buf = recv_ctx_->ring_buf.take();
+            return buf.size();
+        }
+        if (!recv_ctx_->buf.empty()) {
+            KMBuffer kmb(recv_ctx_->buf.size());
+            kmb.bytesWritten(recv_ctx_->buf.read(kmb.writePtr(), kmb.space()));
+            buf = std::move(kmb);
+            return buf.size();
+        }
+        return 0;
+    }
+
+    bool receivedEmpty() const
+    {
+        return !recv_ctx_ || recv_ctx_->bufferEmpty();
+    }
+
+    // whether the last receive filled the whole buffer, there may be more data
+    bool recvFull() const
+    {
+        return recv_full_;
+    }
+
+    const sockaddr_storage& peerAddress() const
+    {
+        return recv_ctx_->ss_addr;
+    }
+
+    socklen_t peerAddressLength() const
+    {
+        return recv_ctx_->addr_len;
+    }
+
+    bool sendPending() const
+    {
+        return send_pending_;
+    }
+
+    bool recvPending() const
+    {
+        return recv_pending_;
+    }
+
+    void setCallback(UringCallback cb)
+    {
+        callback_ = std::move(cb);
+    }
+
+    void increment()
+    {
+        ++refcount_;
+    }
+
+    bool decrement()
+    {
+        if (--refcount_ == 0) {
+            onDestroy();
+            return true;
+        }
+        return false;
+    }
+
+public:
+    struct Deleter
+    {
+        void operator()(UringWrapper* ptr) {
+            if (ptr) {
+                ptr->decrement();
+            }
+        }
+    };
+    using Ptr = std::unique_ptr<UringWrapper, Deleter>;
+    static Ptr create()
+    {
+        auto *p = new UringWrapper();
+        p->increment();
+        return Ptr(p);
+    }
+
+protected:
+    UringWrapper() = default;
+    virtual ~UringWrapper() {
+        if (pending_fd_ != INVALID_FD) {
+            closeFd(pending_fd_);
+            pending_fd_ = INVALID_FD;
+        }
+    }
+
+    static UringPoll* getPoll(const EventLoopPtr &loop)
+    {
+        if (!loop || loop->getPollType() != PollType::IO_URING) {
+            return nullptr;
+        }
+        return static_cast<UringPoll*>(loop->getPoll());
+    }
+
+    void resetPending()
+    {
+        if (send_pending_) {
+            send_pending_ = false;
+            if (decrement()) return;
+        }
+        if (recv_pending_) {
+            recv_pending_ = false;
+            if (decrement()) return;
+        }
+    }
+
+    void onDestroy()
+    {
+        auto loop = loop_.lock();
+        if (loop && closing_) {
+            if (pending_fd_ != INVALID_FD) {
+                loop->unregisterFd(pending_fd_, true);
+                pending_fd_ = INVALID_FD;
+            }
+            loop->removePendingObject(this);
+        }
+        else {
+            if (pending_fd_ != INVALID_FD) {
+                closeFd(pending_fd_);
+                pending_fd_ = INVALID_FD;
+            }
+        }
+        delete this;
+    }
+
+protected:
+    bool                send_pending_ = false;
+    bool                recv_pending_ = false;
+    bool                recv_full_ = false;
+    UringPoll*          poll_ = nullptr;
+    UringContextPtr     send_ctx_;
+    UringContextPtr     recv_ctx_;
+    UringCallback       callback_;
+
+    std::atomic_long    refcount_{ 0 };
+
+    EventLoopWeakPtr    loop_;
+    bool                closing_ = false;
+    SOCKET_FD           pending_fd_ = INVALID_FD;
+};
+
+KUMA_NS_END
+
+#endif // KUMA_HAS_IO_URING
+
+#endif
@@ -0,0 +1,80 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "UringAcceptor.h"
+
+#ifdef KUMA_HAS_IO_URING
+
+#include "util/kmtrace.h"
+
+using namespace kuma;
+
+UringAcceptor::UringAcceptor(const EventLoopPtr &loop)
+: AcceptorBase(loop), UringBase(UringWrapper::create())
+{
+    KM_SetObjKey("UringAcceptor");
+}
+
+UringAcceptor::~UringAcceptor()
+{
+    
+}
+
+bool UringAcceptor::registerFd(SOCKET_FD fd)
+{
+    return UringBase::registerFd(loop_.lock(), fd, this);
+}
+
+void UringAcceptor::unregisterFd(SOCKET_FD fd, bool close_fd)
+{
+    UringBase::unregisterFd(loop_.lock(), fd, close_fd);
+}
+
+KMError UringAcceptor::listen(const std::string &host, uint16_t port)
+{
+    auto ret = AcceptorBase::listen(host, port);
+    if (ret != KMError::NOERR) {
+        return ret;
+    }
+    if (!postAcceptOperation(fd_)) {
+        cleanup();
+        return KMError::FAILED;
+    }
+    return KMError::NOERR;
+}
+
+void UringAcceptor::ioReady(UringContext::Op, KMError err, size_t io_size)
+{
+    if (closed_) {
+        if (err == KMError::NOERR) {
+            closeFd((SOCKET_FD)io_size);
+        }
+        cleanup();
+        return;
+    }
+    if (err == KMError::NOERR) {
+        // the accepted fd is returned as io_size
+        auto &ss_addr = uring_ctx_->peerAddress();
+        AcceptorBase::onAccept((SOCKET_FD)io_size, (const sockaddr*)&ss_addr, uring_ctx_->peerAddressLength());
+    }
+    else {
+        KUMA_WARNXTRACE("ioReady, accept failed, err=" << int(err));
+    }
+    if (!closed_ && fd_ != INVALID_FD) {
+        postAcceptOperation(fd_);
+    }
+}
+
+#endif // KUMA_HAS_IO_URING
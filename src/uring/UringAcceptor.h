@@ -0,0 +1,46 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __UringAcceptor_H__
+#define __UringAcceptor_H__
+
+#include "kmdefs.h"
+#include "kmapi.h"
+#include "evdefs.h"
+#include "AcceptorBase.h"
+#include "UringBase.h"
+
+#ifdef KUMA_HAS_IO_URING
+
+KUMA_NS_BEGIN
+
+class UringAcceptor : public AcceptorBase, public UringBase
+{
+public:
+    UringAcceptor(const EventLoopPtr &loop);
+    ~UringAcceptor();
+    KMError listen(const std::string &host, uint16_t port) override;
+    
+protected:
+    bool registerFd(SOCKET_FD fd) override;
+    void unregisterFd(SOCKET_FD fd, bool close_fd) override;
+    void ioReady(UringContext::Op op, KMError err, size_t io_size) override;
+};
+
+KUMA_NS_END
+
+#endif // KUMA_HAS_IO_URING
+
+#endif
@@ -0,0 +1,136 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __UringBase_H__
+#define __UringBase_H__
+
+#include "kmdefs.h"
+#include "util/kmtrace.h"
+#include "EventLoopImpl.h"
+#include "Uring.h"
+
+#ifdef KUMA_HAS_IO_URING
+
+KUMA_NS_BEGIN
+
+class UringBase
+{
+public:
+    UringBase(UringWrapper::Ptr && ctx)
+        : uring_ctx_(std::move(ctx))
+    {
+        uring_ctx_->setCallback([this](UringContext::Op op, KMError err, size_t io_size) {
+            ioReady(op, err, io_size);
+        });
+    }
+
+    virtual ~UringBase() {}
+
+    bool registerFd(const EventLoopPtr &loop, SOCKET_FD fd, const KMObject *obj=nullptr)
+    {
+        registered_ = uring_ctx_->registerFd(loop, fd, obj);
+        return registered_;
+    }
+
+    void unregisterFd(const EventLoopPtr &loop, SOCKET_FD fd, bool close_fd)
+    {
+        if (registered_) {
+            registered_ = false;
+            uring_ctx_->setCallback(nullptr);
+            uring_ctx_->unregisterFd(loop, fd, close_fd);
+            uring_ctx_.reset();
+        }
+        else if (close_fd && fd != INVALID_FD) {
+            closeFd(fd);
+        }
+    }
+
+    virtual void ioReady(UringContext::Op op, KMError err, size_t io_size) = 0;
+
+    SKBuffer& sendBuffer()
+    {
+        return uring_ctx_->sendBuffer();
+    }
+
+    SKBuffer& recvBuffer()
+    {
+        return uring_ctx_->recvBuffer();
+    }
+
+    size_t readReceived(void *data, size_t len)
+    {
+        return uring_ctx_->readReceived(data, len);
+    }
+
+    size_t takeReceived(KMBuffer &buf)
+    {
+        return uring_ctx_->takeReceived(buf);
+    }
+
+    bool receivedEmpty() const
+    {
+        return !uring_ctx_ || uring_ctx_->receivedEmpty();
+    }
+
+    bool recvFull() const
+    {
+        return uring_ctx_ && uring_ctx_->recvFull();
+    }
+
+    bool sendPending() const
+    {
+        return uring_ctx_ && uring_ctx_->sendPending();
+    }
+
+    bool recvPending() const
+    {
+        return uring_ctx_ && uring_ctx_->recvPending();
+    }
+
+    bool postConnectOperation(SOCKET_FD fd, const sockaddr_storage &ss_addr)
+    {
+        return uring_ctx_->postConnectOperation(fd, ss_addr);
+    }
+
+    bool postAcceptOperation(SOCKET_FD fd)
+    {
+        return uring_ctx_->postAcceptOperation(fd);
+    }
+
+    int postSendOperation(SOCKET_FD fd)
+    {
+        return uring_ctx_->postSendOperation(fd);
+    }
+
+    int postRecvOperation(SOCKET_FD fd)
+    {
+        return uring_ctx_->postRecvOperation(fd);
+    }
+
+    bool hasPendingOperation() const
+    {
+        return uring_ctx_ && uring_ctx_->isPending();
+    }
+
+protected:
+    bool                registered_ = false;
+    UringWrapper::Ptr   uring_ctx_;
+};
+
+KUMA_NS_END
+
+#endif // KUMA_HAS_IO_URING
+
+#endif
@@ -0,0 +1,295 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "UringSocket.h"
+
+#ifdef KUMA_HAS_IO_URING
+
+#include "util/kmtrace.h"
+
+#include <sys/uio.h>
+
+using namespace kuma;
+
+UringSocket::UringSocket(const EventLoopPtr &loop)
+    : SocketBase(loop), UringBase(UringWrapper::create())
+{
+    loop_token_.eventLoop(loop);
+    KM_SetObjKey("UringSocket");
+}
+
+UringSocket::~UringSocket()
+{
+    loop_token_.reset();
+    cleanup();
+}
+
+bool UringSocket::registerFd(SOCKET_FD fd)
+{
+    auto loop = loop_.lock();
+    if (!UringBase::registerFd(loop, fd, this)) {
+        return false;
+    }
+    loop->addConnection();
+    return true;
+}
+
+void UringSocket::unregisterFd(SOCKET_FD fd, bool close_fd)
+{
+    auto loop = loop_.lock();
+    if (loop && UringBase::registered_) {
+        loop->removeConnection();
+    }
+    UringBase::unregisterFd(loop, fd, close_fd);
+}
+
+KMError UringSocket::connect_i(const sockaddr_storage &ss_addr, uint32_t)
+{
+    if (INVALID_FD == fd_) {
+        fd_ = createFd(ss_addr.ss_family);
+        if (INVALID_FD == fd_) {
+            KUMA_ERRXTRACE("connect_i, socket failed, err=" << getLastError());
+            return KMError::FAILED;
+        }
+    }
+    setSocketOption();
+    registerFd(fd_);
+
+    if (!postConnectOperation(fd_, ss_addr)) {
+        cleanup();
+        setState(State::CLOSED);
+        return KMError::FAILED;
+    }
+    setState(State::CONNECTING);
+
+    KUMA_INFOXTRACE("connect_i, fd=" << fd_ << ", state=" << getState());
+
+    return KMError::NOERR;
+}
+
+KMError UringSocket::attachFd(SOCKET_FD fd)
+{
+    SocketBase::attachFd(fd);
+    postRecvOperation(fd_);
+    return KMError::NOERR;
+}
+
+KMError UringSocket::detachFd(SOCKET_FD &)
+{
+    // the pending operations cannot be cancelled synchronously
+    return KMError::UNSUPPORT;
+}
+
+int UringSocket::send(const void* data, size_t length)
+{
+    iovec iov;
+    iov.iov_base = (char*)data;
+    iov.iov_len = length;
+    return send(&iov, 1);
+}
+
+int UringSocket::send(const iovec* iovs, int count)
+{
+    if (!isReady()) {
+        KUMA_WARNXTRACE("send, invalid state=" << getState());
+        return 0;
+    }
+    if (sendPending()) {
+        return 0;
+    }
+
+    size_t bytes_total = 0;
+    for (int i = 0; i < count; ++i) {
+        bytes_total += iovs[i].iov_len;
+    }
+    if (bytes_total == 0) {
+        return 0;
+    }
+
+    // try to send directly, only the remaining data is submitted to io_uring
+    auto ret = (int)::writev(fd_, iovs, count);
+    if (0 == ret) {
+        KUMA_WARNXTRACE("send, peer closed");
+        ret = -1;
+    }
+    else if (ret < 0) {
+        if (EAGAIN == getLastError() || EWOULDBLOCK == getLastError()) {
+            ret = 0;
+        }
+        else {
+            KUMA_ERRXTRACE("send, fail, err=" << getLastError());
+        }
+    }
+
+    if (ret < 0) {
+        cleanup();
+        setState(State::CLOSED);
+    }
+    else if (static_cast<size_t>(ret) < bytes_total) {
+        for (int i = 0; i < count; ++i) {
+            const uint8_t* first = ((uint8_t*)iovs[i].iov_base) + ret;
+            const uint8_t* last = ((uint8_t*)iovs[i].iov_base) + iovs[i].iov_len;
+            if (first < last) {
+                sendBuffer().write(first, last - first);
+                ret = 0;
+            }
+            else {
+                ret -= iovs[i].iov_len;
+            }
+        }
+        postSendOperation(fd_);
+    }
+
+    return ret < 0 ? ret : static_cast<int>(bytes_total);
+}
+
+int UringSocket::receive(void* data, size_t length)
+{
+    if (!isReady()) {
+        return 0;
+    }
+    if (recvPending()) {
+        return 0;
+    }
+    char *ptr = (char*)data;
+    size_t bytes_recv = readReceived(ptr, length);
+    if (bytes_recv == length || !readable_) {
+        if (!readable_ && receivedEmpty()) {
+            postRecvOperation(fd_);
+        }
+        return static_cast<int>(bytes_recv);
+    }
+    auto ret = SocketBase::receive(ptr + bytes_recv, length - bytes_recv);
+    if (ret >= 0) {
+        bytes_recv += ret;
+        if (bytes_recv < length) {
+            readable_ = false;
+            postRecvOperation(fd_);
+        }
+    }
+    else {
+        return ret;
+    }
+
+    return static_cast<int>(bytes_recv);
+}
+
+int UringSocket::receive(KMBuffer &buf)
+{
+    if (!isReady()) {
+        return 0;
+    }
+    if (recvPending()) {
+        return 0;
+    }
+    if (!receivedEmpty()) {
+        return static_cast<int>(takeReceived(buf));
+    }
+    if (readable_) {
+        auto ret = SocketBase::receive(buf);
+        if (ret != 0) {
+            return ret;
+        }
+        readable_ = false;
+    }
+    postRecvOperation(fd_);
+    return 0;
+}
+
+KMError UringSocket::pause()
+{
+    paused_ = true;
+    return KMError::NOERR;
+}
+
+KMError UringSocket::resume()
+{
+    paused_ = false;
+    if (!receivedEmpty() || !recvPending()) {
+        auto loop = eventLoop();
+        if (loop) {
+            loop->post([this] {
+                SocketBase::onReceive(KMError::NOERR);
+            }, &loop_token_);
+        }
+    }
+    return KMError::NOERR;
+}
+
+void UringSocket::onConnect(KMError err)
+{
+    if (err == KMError::NOERR) {
+        postRecvOperation(fd_);
+    }
+    SocketBase::onConnect(err);
+}
+
+void UringSocket::onSend(KMError err, size_t io_size)
+{
+    if (err != KMError::NOERR || io_size == 0) {
+        KUMA_WARNXTRACE("onSend, err=" << int(err) << ", io_size=" << io_size << ", state=" << getState());
+        if (getState() == State::OPEN) {
+            onClose(KMError::SOCK_ERROR);
+        }
+        else {
+            cleanup();
+        }
+        return;
+    }
+    if (!sendBuffer().empty()) {
+        // partially sent, submit the remaining data
+        postSendOperation(fd_);
+        return;
+    }
+    SocketBase::onSend(KMError::NOERR);
+}
+
+void UringSocket::onReceive(KMError err, size_t io_size)
+{
+    if (err != KMError::NOERR || io_size == 0) {
+        KUMA_WARNXTRACE("onReceive, err=" << int(err) << ", io_size=" << io_size << ", state=" << getState());
+        if (getState() == State::OPEN) {
+            onClose(KMError::SOCK_ERROR);
+        }
+        else {
+            cleanup();
+        }
+        return;
+    }
+    readable_ = recvFull();
+    if (!paused_) {
+        SocketBase::onReceive(KMError::NOERR);
+    }
+}
+
+void UringSocket::ioReady(UringContext::Op op, KMError err, size_t io_size)
+{
+    if (op == UringContext::Op::CONNECT) {
+        if (getState() == State::CONNECTING) {
+            onConnect(err);
+        }
+    }
+    else if (op == UringContext::Op::RECV) {
+        onReceive(err, io_size);
+    }
+    else if (op == UringContext::Op::SEND) {
+        onSend(err, io_size);
+    }
+    else {
+        KUMA_WARNXTRACE("ioReady, invalid op: "<<int(op));
+    }
+}
+
+#endif // KUMA_HAS_IO_URING
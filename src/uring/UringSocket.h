@@ -0,0 +1,73 @@
+/* Copyright (c) 2014-2017, Fengping Bao <jamol@live.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef __UringSocket_H__
+#define __UringSocket_H__
+
+#include "kmdefs.h"
+#include "evdefs.h"
+#include "EventLoopImpl.h"
+#include "SocketBase.h"
+#include "UringBase.h"
+
+#ifdef KUMA_HAS_IO_URING
+
+KUMA_NS_BEGIN
+
+/**
+ * UringSocket sends directly with writev and submits the remaining data as SEND operation,
+ * the data is received by RECV operation into the provided buffer ring of loop, or into
+ * the receive buffer of socket if buffer ring is unavailable, like IocpSocket
+ */
+class UringSocket : public SocketBase, public UringBase
+{
+public:
+    UringSocket(const EventLoopPtr &loop);
+    ~UringSocket();
+
+    KMError attachFd(SOCKET_FD fd) override;
+    KMError detachFd(SOCKET_FD &fd) override;
+    int send(const void* data, size_t length) override;
+    int send(const iovec* iovs, int count) override;
+    int receive(void* data, size_t length) override;
+    int receive(KMBuffer &buf) override;
+    KMError pause() override;
+    KMError resume() override;
+    
+protected:
+    KMError connect_i(const sockaddr_storage &ss_addr, uint32_t timeout_ms) override;
+    bool registerFd(SOCKET_FD fd) override;
+    void unregisterFd(SOCKET_FD fd, bool close_fd) override;
+
+protected:
+    void ioReady(UringContext::Op op, KMError err, size_t io_size) override;
+    void onConnect(KMError err) override;
+    void onSend(KMError err, size_t io_size);
+    void onReceive(KMError err, size_t io_size);
+
+    void notifySendBlocked() override {}
+    void notifySendReady() override {}
+
+protected:
+    bool readable_ = false;
+    bool paused_ = false;
+    EventLoopToken loop_token_;
+};
+
+KUMA_NS_END
+
+#endif // KUMA_HAS_IO_URING
+
+#endif
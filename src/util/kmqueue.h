@@ -19,6 +19,9 @@
 #include "kmdefs.h"
 #include <type_traits>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
 
 KUMA_NS_BEGIN
 
@@ -334,6 +337,190 @@ protected:
     NodePtr head_;
     NodePtr tail_;
 };
+
+///
+// intrusive multi-producer/single-consumer queue, enqueue is wait-free and
+// dequeue is lock-free. E must have a member std::atomic<E*> mpsc_next_ and
+// be default constructible (for the stub node).
+// dequeue may return nullptr while a producer is in the middle of enqueue,
+// the producer is responsible to wake up the consumer after enqueue.
+///
+template <class E>
+class MPSCQueue final
+{
+public:
+    MPSCQueue()
+    : head_(&stub_), tail_(&stub_)
+    {
+        stub_.mpsc_next_.store(nullptr, std::memory_order_relaxed);
+    }
+    MPSCQueue(const MPSCQueue &other) = delete;
+    MPSCQueue& operator=(const MPSCQueue &other) = delete;
+    
+    void enqueue(E *e)
+    {
+        e->mpsc_next_.store(nullptr, std::memory_order_relaxed);
+        E *prev = head_.exchange(e, std::memory_order_acq_rel);
+        prev->mpsc_next_.store(e, std::memory_order_release);
+    }
+    
+    /**
+     * enqueue a pre-linked list [first, last] with one exchange
+     */
+    void enqueue(E *first, E *last)
+    {
+        last->mpsc_next_.store(nullptr, std::memory_order_relaxed);
+        E *prev = head_.exchange(last, std::memory_order_acq_rel);
+        prev->mpsc_next_.store(first, std::memory_order_release);
+    }
+    
+    // consumer only
+    E* dequeue()
+    {
+        E *tail = tail_;
+        E *next = tail->mpsc_next_.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->mpsc_next_.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        E *head = head_.load(std::memory_order_acquire);
+        if (tail != head) {
+            return nullptr; // producer is in progress
+        }
+        enqueue(&stub_);
+        next = tail->mpsc_next_.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+    
+    // consumer only
+    bool empty() const
+    {
+        return tail_ == &stub_ && !stub_.mpsc_next_.load(std::memory_order_acquire);
+    }
+    
+private:
+    std::atomic<E*> head_;
+    E*              tail_;
+    E               stub_;
+};
+
+///
+// lock-free pool of E, the nodes are allocated in chunks and never freed
+// before the pool is destroyed. free list is an index based stack with an
+// ABA tag. E must have members uint32_t pool_index_ and
+// std::atomic<uint32_t> pool_next_, and be default constructible.
+// nodes over the pool capacity are allocated by new and deleted on release.
+///
+template <class E, uint32_t CHUNK_SIZE = 256, uint32_t MAX_CHUNKS = 4096>
+class NodePool final
+{
+public:
+    NodePool()
+    {
+        for (auto &c : chunks_) {
+            c.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    ~NodePool()
+    {
+        for (auto &c : chunks_) {
+            delete [] c.load(std::memory_order_relaxed);
+        }
+    }
+    NodePool(const NodePool &other) = delete;
+    NodePool& operator=(const NodePool &other) = delete;
+    
+    E* acquire()
+    {
+        while (true) {
+            auto head = free_head_.load(std::memory_order_acquire);
+            while (index(head) != kInvalidIndex) {
+                E *e = node(index(head));
+                uint64_t next = make(e->pool_next_.load(std::memory_order_relaxed), tag(head) + 1);
+                if (free_head_.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    return e;
+                }
+            }
+            E *e = grow();
+            if (e) {
+                return e;
+            }
+        }
+    }
+    
+    void release(E *e)
+    {
+        if (e->pool_index_ == kInvalidIndex) {
+            delete e;
+            return;
+        }
+        auto head = free_head_.load(std::memory_order_relaxed);
+        uint64_t new_head;
+        do {
+            e->pool_next_.store(index(head), std::memory_order_relaxed);
+            new_head = make(e->pool_index_, tag(head) + 1);
+        } while (!free_head_.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed));
+    }
+    
+    uint32_t capacity() const
+    {
+        return num_chunks_.load(std::memory_order_relaxed) * CHUNK_SIZE;
+    }
+    
+    enum : uint32_t { kInvalidIndex = uint32_t(-1) };
+    
+private:
+    static uint32_t index(uint64_t v) { return uint32_t(v); }
+    static uint32_t tag(uint64_t v) { return uint32_t(v >> 32); }
+    static uint64_t make(uint32_t idx, uint32_t tag) { return (uint64_t(tag) << 32) | idx; }
+    E* node(uint32_t idx)
+    {
+        return &chunks_[idx / CHUNK_SIZE].load(std::memory_order_acquire)[idx % CHUNK_SIZE];
+    }
+    
+    E* grow()
+    {
+        std::lock_guard<std::mutex> g(grow_mutex_);
+        auto head = free_head_.load(std::memory_order_acquire);
+        if (index(head) != kInvalidIndex) {
+            return nullptr; // other thread has refilled the free list
+        }
+        auto n = num_chunks_.load(std::memory_order_relaxed);
+        if (n >= MAX_CHUNKS) {
+            E *e = new E();
+            e->pool_index_ = kInvalidIndex;
+            return e;
+        }
+        E *chunk = new E[CHUNK_SIZE];
+        for (uint32_t i = 0; i < CHUNK_SIZE; ++i) {
+            chunk[i].pool_index_ = n * CHUNK_SIZE + i;
+        }
+        chunks_[n].store(chunk, std::memory_order_release);
+        num_chunks_.store(n + 1, std::memory_order_relaxed);
+        for (uint32_t i = 1; i < CHUNK_SIZE; ++i) {
+            release(&chunk[i]);
+        }
+        return &chunk[0];
+    }
+    
+private:
+    std::atomic<uint64_t>   free_head_{ make(kInvalidIndex, 0) };
+    std::atomic<E*>         chunks_[MAX_CHUNKS];
+    std::atomic<uint32_t>   num_chunks_{ 0 };
+    std::mutex              grow_mutex_;
+};
     
 KUMA_NS_END
 
@@ -29,6 +29,8 @@
 # include <MSWSock.h>
 # include <Ws2tcpip.h>
 # include <windows.h>
+# include <io.h>
+# include <sys/stat.h>
 #else
 # include <string.h>
 # include <netdb.h>
@@ -37,12 +39,20 @@
 # include <errno.h>
 # include <sys/types.h>
 # include <sys/time.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
 # include <dlfcn.h>
 # include <unistd.h>
 # include <netinet/tcp.h>
+# include <pthread.h>
+# ifdef KUMA_OS_LINUX
+#  include <sched.h>
+# endif
 # ifdef KUMA_OS_MAC
 #  include "CoreFoundation/CoreFoundation.h"
 #  include <mach-o/dyld.h>
+#  include <mach/mach.h>
+#  include <mach/thread_policy.h>
 #  ifndef KUMA_OS_IOS
 #   include <libproc.h>
 #  endif
@@ -56,6 +66,7 @@
 
 #include "kmobject.h"
 #include "kmtrace.h"
+#include "kmbuffer.h"
 
 KUMA_NS_BEGIN
 
@@ -382,6 +393,52 @@ int km_get_addr_length(const sockaddr_storage &addr)
     return addr_len;
 }
 
+KMBuffer* km_map_file(int fd, int64_t offset, size_t length)
+{
+    if (fd < 0 || offset < 0 || length == 0) {
+        return nullptr;
+    }
+#ifdef KUMA_OS_WIN
+    struct _stat64 st;
+    if (_fstat64(fd, &st) != 0 || offset + int64_t(length) > st.st_size) {
+        return nullptr;
+    }
+    // read into buffer, the file mapping of Windows works on HANDLE
+    auto *kmb = new KMBuffer(length);
+    if (_lseeki64(fd, offset, SEEK_SET) != offset) {
+        kmb->destroy();
+        return nullptr;
+    }
+    while (kmb->space() > 0) {
+        auto chunk = kmb->space() > INT_MAX ? INT_MAX : unsigned(kmb->space());
+        int ret = _read(fd, kmb->writePtr(), chunk);
+        if (ret <= 0) {
+            kmb->destroy();
+            return nullptr;
+        }
+        kmb->bytesWritten(ret);
+    }
+    return kmb;
+#else
+    struct stat st;
+    if (fstat(fd, &st) != 0 || offset + int64_t(length) > st.st_size) {
+        // the pages beyond the end of file cannot be accessed
+        return nullptr;
+    }
+    static const int64_t page_size = sysconf(_SC_PAGESIZE);
+    auto map_offset = offset - offset % page_size;
+    auto delta = size_t(offset - map_offset);
+    auto map_len = delta + length;
+    auto *addr = ::mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd, map_offset);
+    if (MAP_FAILED == addr) {
+        KUMA_ERRTRACE("km_map_file, mmap failed, fd=" << fd << ", err=" << errno);
+        return nullptr;
+    }
+    auto unmap = [](void *ptr, size_t size) { ::munmap(ptr, size); };
+    return new KMBuffer(addr, map_len, length, delta, unmap);
+#endif
+}
+
 extern "C" bool km_is_ipv6_address(const char* addr)
 {
     sockaddr_storage ss_addr = {0};
@@ -555,6 +612,14 @@ TICK_COUNT_TYPE get_tick_count_ms()
 	return (TICK_COUNT_TYPE)_now_ms.count();
 }
 
+uint64_t get_tick_count_us()
+{
+    using namespace std::chrono;
+    steady_clock::time_point _now = steady_clock::now();
+    microseconds _now_us = duration_cast<microseconds>(_now.time_since_epoch());
+    return (uint64_t)_now_us.count();
+}
+
 TICK_COUNT_TYPE calc_time_elapse_delta_ms(TICK_COUNT_TYPE now_tick, TICK_COUNT_TYPE& start_tick)
 {
     if(now_tick - start_tick > (((TICK_COUNT_TYPE)-1)>>1)) {
@@ -758,6 +823,31 @@ std::string getCurrentModulePath()
     return str_path;
 }
 
+bool set_thread_affinity(int cpu)
+{
+    if (cpu < 0) {
+        return false;
+    }
+#if defined(KUMA_OS_WIN)
+    if (size_t(cpu) >= sizeof(DWORD_PTR) * 8) {
+        return false;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(KUMA_OS_LINUX)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#elif defined(KUMA_OS_MAC)
+    // mac has no API to bind thread to a cpu, the affinity tag is only a hint
+    thread_affinity_policy_data_t policy = { cpu + 1 };
+    auto thread = pthread_mach_thread_np(pthread_self());
+    return thread_policy_set(thread, THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS;
+#else
+    return false;
+#endif
+}
+
 #ifndef KUMA_OS_MAC
 /**
  * strlcpy - Copy a C-string into a sized buffer
@@ -69,6 +69,7 @@ int set_tcpnodelay(SOCKET_FD fd);
 int find_first_set(uint32_t b);
 int find_first_set(uint64_t b);
 TICK_COUNT_TYPE get_tick_count_ms();
+uint64_t get_tick_count_us();
 TICK_COUNT_TYPE calc_time_elapse_delta_ms(TICK_COUNT_TYPE now_tick, TICK_COUNT_TYPE& start_tick);
 
 bool is_equal(const char* str1, const char* str2);
@@ -87,6 +88,7 @@ std::string& trim_right(std::string& str);
 bool contains_token(const std::string& str, const std::string& token, char delim);
 std::string getExecutablePath();
 std::string getCurrentModulePath();
+bool set_thread_affinity(int cpu); // bind current thread to cpu
 
 template<typename LAMBDA> // (std::string &token) -> bool
 void for_each_token(const std::string &tokens, char delim, LAMBDA &&func)
@@ -197,6 +199,15 @@ int km_get_sock_addr(const sockaddr_storage &addr, std::string &ip, uint16_t *po
 int km_set_addr_port(uint16_t port, sockaddr_storage &addr);
 int km_get_addr_length(const sockaddr_storage &addr);
 
+class KMBuffer;
+// the file is mapped and sent in chunks of this size if sendfile is not usable
+#define KM_FILE_CHUNK_SIZE  (256 * 1024)
+/* map the range of file fd into a KMBuffer without copy, the mapping is released with the
+ * last reference of the buffer. return nullptr if the range is out of the file. accessing
+ * the mapping raises SIGBUS if the file is truncated while it is mapped
+ */
+KMBuffer* km_map_file(int fd, int64_t offset, size_t length);
+
 inline bool km_is_fatal_error(KMError err)
 {
     return err != KMError::NOERR && err != KMError::AGAIN;
@@ -25,6 +25,7 @@
 #include "util/base64.h"
 
 #include <sstream>
+#include <algorithm>
 #ifdef KUMA_HAS_OPENSSL
 #include <openssl/sha.h>
 #else
@@ -189,19 +190,41 @@ void WSHandler::handleResponse()
 }
 
 WSHandler::WSError WSHandler::handleData(uint8_t* data, size_t len)
+{
+    KMBuffer buf(data, len, len);
+    return handleData(buf);
+}
+
+WSHandler::WSError WSHandler::handleData(KMBuffer &buf)
+{
+    WSError err = WSError::NOERR;
+    for (auto &kmb : buf) {
+        if (kmb.length() == 0) {
+            continue;
+        }
+        err = handleBlock(kmb);
+        if (err != WSError::NOERR && err != WSError::NEED_MORE_DATA) {
+            break;
+        }
+    }
+    return err;
+}
+
+WSHandler::WSError WSHandler::handleBlock(const KMBuffer &kmb)
 {
     if(state_ == STATE_OPEN) {
-        return decodeFrame(data, len);
+        return decodeFrame(kmb, 0);
     }
     if(state_ == STATE_HANDSHAKE) {
+        auto len = kmb.length();
         DESTROY_DETECTOR_SETUP();
-        int bytes_used = http_parser_.parse((char*)data, len);
+        int bytes_used = http_parser_.parse(kmb.readPtr(), len);
         DESTROY_DETECTOR_CHECK(WSError::DESTROYED);
         if(state_ == STATE_ERROR) {
             return WSError::HANDSHAKE;
         }
         if(bytes_used < (int)len && state_ == STATE_OPEN) {
-            return decodeFrame(data + bytes_used, len - bytes_used);
+            return decodeFrame(kmb, bytes_used);
         }
     } else {
         return WSError::INVALID_STATE;
@@ -256,11 +279,13 @@ int WSHandler::encodeFrameHeader(WSOpcode opcode, bool fin, uint8_t (*mask_key)[
     return hdr_len;
 }
 
-WSHandler::WSError WSHandler::decodeFrame(uint8_t* data, size_t len)
+WSHandler::WSError WSHandler::decodeFrame(const KMBuffer &kmb, size_t offset)
 {
 #define WS_MAX_FRAME_DATA_LENGTH	10*1024*1024
     
-    size_t pos = 0;
+    auto *data = (uint8_t*)kmb.readPtr();
+    size_t len = kmb.length();
+    size_t pos = offset;
     uint8_t b = 0;
     while(pos < len)
     {
@@ -291,7 +316,8 @@ WSHandler::WSError WSHandler::decodeFrame(uint8_t* data, size_t len)
                 ctx_.hdr.plen = b & 0x7F;
                 ctx_.hdr.xpl.xpl64 = 0;
                 ctx_.pos = 0;
-                ctx_.buf.clear();
+                ctx_.buf.reset();
+                ctx_.buf_len = 0;
                 if (isControlFrame(ctx_.hdr.opcode) && ctx_.hdr.plen > 125) {
                     // the payload length of control frames MUST <= 125
                     ctx_.state = DecodeState::IN_ERROR;
@@ -377,37 +403,35 @@ WSHandler::WSError WSHandler::decodeFrame(uint8_t* data, size_t len)
                     ctx_.state = DecodeState::IN_ERROR;
                     return WSError::PROTOCOL_ERROR;
                 }
-                ctx_.buf.clear();
+                ctx_.buf.reset();
+                ctx_.buf_len = 0;
                 ctx_.state = DecodeState::DATA;
                 break;
             }
             case DecodeState::DATA:
             {
-                if (len-pos+ctx_.buf.size() < ctx_.hdr.length) {
-                    auto buf_size = ctx_.buf.size();
-                    auto read_len = len - pos;
-                    ctx_.buf.reserve(buf_size + read_len);
-                    ctx_.buf.insert(ctx_.buf.end(), data + pos, data + len);
+                if (len-pos+ctx_.buf_len < ctx_.hdr.length) {
+                    ctx_.saveData(kmb, pos, len - pos);
                     return WSError::NEED_MORE_DATA;
                 }
 
-                uint8_t* notify_data = nullptr;
-                uint32_t notify_len = 0;
-                if(ctx_.buf.empty()) {
-                    notify_data = data + pos;
-                    notify_len = ctx_.hdr.length;
+                WSError err = WSError::NOERR;
+                if(!ctx_.buf) {
+                    uint8_t* notify_data = data + pos;
+                    uint32_t notify_len = ctx_.hdr.length;
                     pos += notify_len;
+                    handleDataMask(ctx_.hdr, notify_data, notify_len);
+                    err = handleFrame(ctx_.hdr, notify_data, notify_len);
                 } else {
-                    auto buf_size = ctx_.buf.size();
-                    auto read_len = ctx_.hdr.length - buf_size;
-                    ctx_.buf.reserve(ctx_.hdr.length);
-                    ctx_.buf.insert(ctx_.buf.end(), data + pos, data + pos + read_len);
-                    notify_data = &ctx_.buf[0];
-                    notify_len = ctx_.hdr.length;
-                    pos += read_len;
+                    // the payload is across the reads, notify the slices as a buffer chain
+                    auto read_len = ctx_.hdr.length - ctx_.buf_len;
+                    if (read_len > 0) {
+                        ctx_.saveData(kmb, pos, read_len);
+                        pos += read_len;
+                    }
+                    handleDataMask(ctx_.hdr, *ctx_.buf);
+                    err = handleFrame(ctx_.hdr, *ctx_.buf);
                 }
-                handleDataMask(ctx_.hdr, notify_data, notify_len);
-                auto err = handleFrame(ctx_.hdr, notify_data, notify_len);
                 if (err != WSError::NOERR) {
                     return err;
                 }
@@ -434,6 +458,56 @@ WSHandler::WSError WSHandler::handleFrame(const FrameHeader &hdr, void* payload,
     return WSError::NOERR;
 }
 
+WSHandler::WSError WSHandler::handleFrame(const FrameHeader &hdr, KMBuffer &payload)
+{
+    DESTROY_DETECTOR_SETUP();
+    if(frame_cb_) frame_cb_(hdr.opcode, hdr.fin, payload);
+    DESTROY_DETECTOR_CHECK(WSError::DESTROYED);
+    return WSError::NOERR;
+}
+
+void WSHandler::DecodeContext::saveData(const KMBuffer &kmb, size_t offset, size_t len)
+{
+    // the copy buffer is at least this size, so that the slices of tiny reads share it
+#define WS_COPY_BLOCK_SIZE  4096
+    
+    if (len >= kmb.capacity() / 4) {
+        // the slice is referenced without copy
+        auto *sub = kmb.subbuffer(offset, len);
+        if (buf) {
+            buf->append(sub);
+        } else {
+            buf.reset(sub);
+        }
+        copy_tail = nullptr;
+        buf_len += uint32_t(len);
+        return;
+    }
+    // a small slice would keep the whole read block, it is copied into own buffer
+    if (!buf) {
+        copy_tail = nullptr;
+    }
+    auto *data = (const uint8_t*)kmb.readPtr() + offset;
+    buf_len += uint32_t(len);
+    while (len > 0) {
+        if (!copy_tail || copy_tail->space() == 0) {
+            // buf_len includes this slice, the rest of payload is after it
+            size_t remain = hdr.length - buf_len + len;
+            auto *kmb_copy = new KMBuffer();
+            kmb_copy->allocBuffer(std::max(len, std::min<size_t>(remain, WS_COPY_BLOCK_SIZE)));
+            if (buf) {
+                buf->append(kmb_copy);
+            } else {
+                buf.reset(kmb_copy);
+            }
+            copy_tail = kmb_copy;
+        }
+        auto ret = copy_tail->write(data, len);
+        data += ret;
+        len -= ret;
+    }
+}
+
 void WSHandler::handleDataMask(const FrameHeader& hdr, uint8_t* data, size_t len)
 {
     if(0 == hdr.mask) return ;
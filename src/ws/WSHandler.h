@@ -72,6 +72,9 @@ public:
     std::string buildUpgradeResponse();
     
     WSError handleData(uint8_t* data, size_t len);
+    // the partial payload is kept as slice of buf, the slice smaller than 1/4 of the block
+    // is copied so that the block is not kept by it
+    WSError handleData(KMBuffer &buf);
     static int encodeFrameHeader(WSOpcode opcode, bool fin, uint8_t (*mask_key)[WS_MASK_KEY_SIZE], size_t plen, uint8_t hdr_buf[14]);
     
     const std::string getProtocol();
@@ -117,19 +120,26 @@ private:
         {
             memset(&hdr, 0, sizeof(hdr));
             state = DecodeState::HDR1;
-            buf.clear();
+            buf.reset();
+            copy_tail = nullptr;
+            buf_len = 0;
             pos = 0;
         }
+        // save the partial payload of the read block kmb, the small slices are copied
+        void saveData(const KMBuffer &kmb, size_t offset, size_t len);
         FrameHeader hdr;
         DecodeState state{ DecodeState::HDR1 };
-        std::vector<uint8_t> buf;
+        KMBuffer::Ptr buf; // the partial payload
+        KMBuffer* copy_tail = nullptr; // the last buffer of buf that slices are copied into
+        uint32_t buf_len = 0;
         uint8_t pos = 0;
     }DecodeContext;
     void cleanup();
     
     void handleDataMask(const FrameHeader& hdr, uint8_t* data, size_t len);
     void handleDataMask(const FrameHeader& hdr, KMBuffer &buf);
-    WSError decodeFrame(uint8_t* data, size_t len);
+    WSError handleBlock(const KMBuffer &kmb);
+    WSError decodeFrame(const KMBuffer &kmb, size_t offset);
     
     void onHttpData(KMBuffer &buf);
     void onHttpEvent(HttpEvent ev);
@@ -137,6 +147,7 @@ private:
     void handleRequest();
     void handleResponse();
     WSError handleFrame(const FrameHeader &hdr, void* payload, size_t len);
+    WSError handleFrame(const FrameHeader &hdr, KMBuffer &payload);
     
 private:
     typedef enum {
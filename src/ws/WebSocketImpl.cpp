@@ -27,6 +27,8 @@
 
 using namespace kuma;
 
+#define WS_IOV_BATCH    16
+
 //////////////////////////////////////////////////////////////////////////
 WebSocket::Impl::Impl(const EventLoopPtr &loop)
 : TcpConnection(loop)
@@ -119,7 +121,7 @@ int WebSocket::Impl::send(const void* data, size_t len, bool is_text, bool fin)
     if(getState() != State::OPEN) {
         return -1;
     }
-    if(!sendBufferEmpty()) {
+    if(sendQueueFull()) {
         return 0;
     }
     WSHandler::WSOpcode opcode = WSHandler::WSOpcode::WS_OPCODE_BINARY;
@@ -146,7 +148,7 @@ int WebSocket::Impl::send(const KMBuffer &buf, bool is_text, bool fin)
     if(getState() != State::OPEN) {
         return -1;
     }
-    if(!sendBufferEmpty()) {
+    if(sendQueueFull()) {
         return 0;
     }
     WSHandler::WSOpcode opcode = WSHandler::WSOpcode::WS_OPCODE_BINARY;
@@ -180,11 +182,25 @@ KMError WebSocket::Impl::close()
     return KMError::NOERR;
 }
 
+KMError WebSocket::Impl::migrate(const EventLoopPtr &loop)
+{
+    if (getState() != State::OPEN) {
+        return KMError::INVALID_STATE;
+    }
+    return TcpConnection::migrate(loop);
+}
+
 KMError WebSocket::Impl::handleInputData(uint8_t *src, size_t len)
+{
+    KMBuffer buf(src, len, len);
+    return handleInputData(buf);
+}
+
+KMError WebSocket::Impl::handleInputData(KMBuffer &buf)
 {
     if (getState() == State::OPEN || getState() == State::UPGRADING) {
         DESTROY_DETECTOR_SETUP();
-        WSHandler::WSError err = ws_handler_.handleData(src, len);
+        WSHandler::WSError err = ws_handler_.handleData(buf);
         DESTROY_DETECTOR_CHECK(KMError::DESTROYED);
         if(getState() == State::IN_ERROR || getState() == State::CLOSED) {
             return KMError::INVALID_STATE;
@@ -339,13 +355,25 @@ KMError WebSocket::Impl::sendWsFrame(WSHandler::WSOpcode opcode, bool fin, const
     } else {
         hdr_len = ws_handler_.encodeFrameHeader(opcode, fin, nullptr, plen, hdr_buf);
     }
-    IOVEC iovs;
-    iovec iov;
-    iov.iov_base = (char*)hdr_buf;
-    iov.iov_len = hdr_len;
-    iovs.emplace_back(iov);
-    buf.fillIov(iovs);
-    auto ret = TcpConnection::send(&iovs[0], static_cast<int>(iovs.size()));
+    iovec iovs[WS_IOV_BATCH];
+    iovs[0].iov_base = (char*)hdr_buf;
+    iovs[0].iov_len = hdr_len;
+    const KMBuffer *pos = &buf;
+    int cnt = 1 + buf.fillIov(iovs + 1, WS_IOV_BATCH - 1, pos);
+    int ret = 0;
+    if (!pos) {
+        ret = TcpConnection::send(iovs, cnt);
+    } else {
+        // long buffer chain
+        IOVEC v_iovs(iovs, iovs + cnt);
+        while (pos) {
+            iovec iov;
+            if (buf.fillIov(&iov, 1, pos) == 1) {
+                v_iovs.emplace_back(iov);
+            }
+        }
+        ret = TcpConnection::send(&v_iovs[0], static_cast<int>(v_iovs.size()));
+    }
     return ret < 0 ? KMError::SOCK_ERROR : KMError::NOERR;
 }
 
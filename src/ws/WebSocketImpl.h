@@ -50,6 +50,7 @@ public:
     int send(const void* data, size_t len, bool is_text, bool fin);
     int send(const KMBuffer &buf, bool is_text, bool fin);
     KMError close();
+    KMError migrate(const EventLoopPtr &loop);
     
     void setDataCallback(DataCallback cb) { data_cb_ = std::move(cb); }
     void setWriteCallback(EventCallback cb) { write_cb_ = std::move(cb); }
@@ -83,6 +84,7 @@ private:
     
     void onConnect(KMError err) override;
     KMError handleInputData(uint8_t *src, size_t len) override;
+    KMError handleInputData(KMBuffer &buf) override;
     void onWrite() override;
     void onError(KMError err) override;
     
@@ -0,0 +1,73 @@
+#ifndef __BenchUtil_H__
+#define __BenchUtil_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <functional>
+
+class StopWatch
+{
+public:
+    StopWatch() { start(); }
+
+    void start() { start_ = std::chrono::steady_clock::now(); }
+
+    uint64_t elapsedNs() const
+    {
+        auto d = std::chrono::steady_clock::now() - start_;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    }
+
+    double elapsedMs() const { return elapsedNs() / 1000000.0; }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+inline void printResult(const char* name, uint64_t ops, uint64_t elapsed_ns)
+{
+    double ns_per_op = ops ? double(elapsed_ns) / ops : 0;
+    double ops_per_sec = elapsed_ns ? ops * 1e9 / elapsed_ns : 0;
+    printf("  %-32s ops=%-10llu time=%8.2fms  %8.1f ns/op  %12.0f ops/s\n",
+           name, (unsigned long long)ops, elapsed_ns / 1e6, ns_per_op, ops_per_sec);
+}
+
+inline int getIntArg(int argc, char *argv[], int idx, int def_val)
+{
+    if (idx < argc) {
+        return atoi(argv[idx]);
+    }
+    return def_val;
+}
+
+// number of operator new calls in this process, see main.cpp
+uint64_t allocCount();
+
+// bench entry, argv[0] is the bench name
+using BenchFunc = std::function<int(int, char**)>;
+
+struct BenchEntry
+{
+    const char* name;
+    const char* usage;
+    BenchFunc   func;
+};
+
+std::vector<BenchEntry>& benchRegistry();
+
+struct BenchRegister
+{
+    BenchRegister(const char* name, const char* usage, BenchFunc func)
+    {
+        benchRegistry().push_back({name, usage, std::move(func)});
+    }
+};
+
+#define BENCH_REGISTER(name, usage, func) \
+    static BenchRegister s_bench_register_##func(name, usage, func)
+
+#endif
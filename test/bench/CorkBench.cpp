@@ -0,0 +1,195 @@
+#include "kmapi.h"
+#include "BenchUtil.h"
+
+#include <string.h>
+#include <string>
+#include <thread>
+#include <atomic>
+
+#ifdef KUMA_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <linux/tcp.h>
+#endif
+
+using namespace kuma;
+
+namespace {
+
+// WebSocket and H2 control messages of 50 to 200 bytes
+const size_t kMessageSizes[] = { 64, 120, 200, 50, 180, 96, 150, 80 };
+
+#ifdef KUMA_OS_LINUX
+// the write syscalls of this process, it counts writev but not send
+uint64_t writeSyscalls()
+{
+    uint64_t syscw = 0;
+    auto *fp = fopen("/proc/self/io", "r");
+    if (!fp) {
+        return 0;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "syscw:", 6) == 0) {
+            syscw = strtoull(line + 6, nullptr, 10);
+            break;
+        }
+    }
+    fclose(fp);
+    return syscw;
+}
+
+uint64_t segmentsOut(int fd)
+{
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    memset(&info, 0, sizeof(info));
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) {
+        return 0;
+    }
+    return info.tcpi_segs_out;
+}
+
+bool connectLoopback(int &client_fd, int &server_fd)
+{
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (lfd < 0 || bind(lfd, (sockaddr*)&addr, addr_len) != 0 || listen(lfd, 1) != 0 ||
+        getsockname(lfd, (sockaddr*)&addr, &addr_len) != 0) {
+        if (lfd >= 0) ::close(lfd);
+        return false;
+    }
+    client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (client_fd < 0 || connect(client_fd, (sockaddr*)&addr, addr_len) != 0) {
+        ::close(lfd);
+        return false;
+    }
+    server_fd = accept(lfd, nullptr, nullptr);
+    ::close(lfd);
+    return server_fd >= 0;
+}
+
+struct Result
+{
+    uint64_t messages = 0;
+    uint64_t syscalls = 0;
+    uint64_t segments = 0;
+    uint64_t elapsed_ns = 0;
+};
+
+// burst messages are sent in each loop iteration, the messages are sent by iovec
+// so that both modes are counted by syscw
+bool runCork(bool cork, int rounds, int burst, Result &result)
+{
+    EventLoop loop;
+    if (!loop.init()) {
+        return false;
+    }
+    int client_fd = -1, server_fd = -1;
+    if (!connectLoopback(client_fd, server_fd)) {
+        return false;
+    }
+    uint64_t total_bytes = 0;
+    const size_t n = sizeof(kMessageSizes) / sizeof(kMessageSizes[0]);
+    for (int i = 0; i < rounds * burst; ++i) {
+        total_bytes += kMessageSizes[i % n];
+    }
+    std::thread reader([server_fd, total_bytes] {
+        char buf[64 * 1024];
+        uint64_t received = 0;
+        while (received < total_bytes) {
+            auto ret = ::read(server_fd, buf, sizeof(buf));
+            if (ret <= 0) {
+                break;
+            }
+            received += ret;
+        }
+    });
+
+    bool writable = true;
+    TcpSocket tcp(&loop);
+    tcp.setWriteCallback([&] (KMError) { writable = true; });
+    tcp.attachFd(client_fd);
+    tcp.setCork(cork);
+
+    char payload[256] = { 0 };
+    int index = 0;
+    auto segments = segmentsOut(client_fd);
+    auto syscalls = writeSyscalls();
+    StopWatch sw;
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < burst; ++i) {
+            auto len = kMessageSizes[index++ % n];
+            size_t offset = 0;
+            while (offset < len) {
+                while (!writable) {
+                    loop.loopOnce(10);
+                }
+                iovec iov;
+                iov.iov_base = payload + offset;
+                iov.iov_len = len - offset;
+                auto ret = tcp.send(&iov, 1);
+                if (ret < 0) {
+                    break;
+                }
+                offset += ret;
+                if (offset < len) {
+                    writable = false;
+                }
+            }
+        }
+        loop.loopOnce(0);
+    }
+    // the last burst is flushed by the loop
+    loop.loopOnce(0);
+    result.elapsed_ns = sw.elapsedNs();
+    result.syscalls = writeSyscalls() - syscalls;
+    result.segments = segmentsOut(client_fd) - segments;
+    result.messages = uint64_t(rounds) * burst;
+    reader.join();
+    tcp.close();
+    ::close(server_fd);
+    return true;
+}
+
+void printCork(const char* name, const Result &result)
+{
+    printResult(name, result.messages, result.elapsed_ns);
+    auto messages = result.messages ? double(result.messages) : 1.0;
+    printf("  %-32s syscalls/msg=%.3f, packets/msg=%.3f\n", "",
+           result.syscalls / messages, result.segments / messages);
+}
+#endif
+
+int corkBench(int argc, char *argv[])
+{
+#ifdef KUMA_OS_LINUX
+    int rounds = getIntArg(argc, argv, 1, 20000);
+    int burst = getIntArg(argc, argv, 2, 16);
+    printf("  rounds=%d, burst=%d\n", rounds, burst);
+
+    Result result;
+    if (!runCork(false, rounds, burst, result)) {
+        printf("failed to run TcpSocket bench\n");
+        return -1;
+    }
+    printCork("TcpSocket, no cork", result);
+    result = Result();
+    if (!runCork(true, rounds, burst, result)) {
+        printf("failed to run TcpSocket bench\n");
+        return -1;
+    }
+    printCork("TcpSocket, cork", result);
+#endif
+    return 0;
+}
+
+} // namespace
+
+BENCH_REGISTER("cork", "[rounds] [burst]", corkBench);
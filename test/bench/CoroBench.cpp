@@ -0,0 +1,204 @@
+#include "kmcoro.h"
+#include "BenchUtil.h"
+
+#ifdef KUMA_HAS_COROUTINE
+
+#include <memory>
+#include <functional>
+
+#ifndef KUMA_OS_WIN
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace kuma;
+
+namespace {
+
+const size_t kMsgSize = 32;
+
+// the echo side, it is driven by callbacks in both cases
+class Echoer
+{
+public:
+    Echoer(EventLoop *loop) : socket_(loop)
+    {
+        socket_.setReadCallback([this] (KMError) {
+            char buf[1024];
+            int ret = 0;
+            while ((ret = socket_.receive(buf, sizeof(buf))) > 0) {
+                socket_.send(buf, ret);
+            }
+        });
+        socket_.setWriteCallback([] (KMError) {});
+        socket_.setErrorCallback([] (KMError) {});
+    }
+
+    TcpSocket socket_;
+};
+
+struct PingPong
+{
+    PingPong(EventLoop *loop) : echoer(loop), socket(loop) {}
+
+    bool attach()
+    {
+#ifndef KUMA_OS_WIN
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            return false;
+        }
+        return echoer.socket_.attachFd(fds[0]) == KMError::NOERR &&
+            socket.attachFd(fds[1]) == KMError::NOERR;
+#else
+        return false;
+#endif
+    }
+
+    Echoer      echoer;
+    TcpSocket   socket;
+    char        msg[kMsgSize] = { 0 };
+    size_t      received = 0;
+    int         rounds = 0;
+    bool        done = false;
+};
+
+// the callback chain, send the next message in read callback
+void pingPongCallback(PingPong &pp, int rounds)
+{
+    auto *p = &pp;
+    p->socket.setReadCallback([p, rounds] (KMError) {
+        char buf[kMsgSize];
+        int ret = 0;
+        while ((ret = p->socket.receive(buf, sizeof(buf))) > 0) {
+            p->received += ret;
+            if (p->received == kMsgSize) {
+                p->received = 0;
+                if (++p->rounds == rounds) {
+                    p->done = true;
+                    return;
+                }
+                p->socket.send(p->msg, sizeof(p->msg));
+            }
+        }
+    });
+    p->socket.setWriteCallback([] (KMError) {});
+    p->socket.setErrorCallback([p] (KMError) { p->done = true; });
+    p->socket.send(p->msg, sizeof(p->msg));
+}
+
+coro::Task<> pingPongCoroutine(PingPong *pp, coro::TcpStream *stream, int rounds)
+{
+    char buf[kMsgSize];
+    while (pp->rounds < rounds) {
+        if (co_await stream->write(pp->msg, sizeof(pp->msg)) < 0) {
+            break;
+        }
+        size_t received = 0;
+        while (received < kMsgSize) {
+            int ret = co_await stream->read(buf, kMsgSize - received);
+            if (ret < 0) {
+                pp->done = true;
+                co_return;
+            }
+            received += ret;
+        }
+        ++pp->rounds;
+    }
+    pp->done = true;
+}
+
+void runLoop(EventLoop &loop, PingPong &pp)
+{
+    while (!pp.done) {
+        loop.loopOnce(10);
+    }
+}
+
+coro::Task<int> add(int a, int b)
+{
+    co_return a + b;
+}
+
+coro::Task<> sumCoroutine(int n, int *result)
+{
+    for (int i = 0; i < n; ++i) {
+        *result = co_await add(*result, i);
+    }
+}
+
+int coroBench(int argc, char *argv[])
+{
+    int rounds = getIntArg(argc, argv, 1, 100000);
+    EventLoop loop;
+    if (!loop.init()) {
+        printf("failed to init EventLoop\n");
+        return -1;
+    }
+    printf("  rounds=%d, message=%d bytes\n", rounds, int(kMsgSize));
+
+    {
+        PingPong pp(&loop);
+        if (!pp.attach()) {
+            printf("failed to create socket pair\n");
+            return -1;
+        }
+        auto allocs = allocCount();
+        StopWatch sw;
+        pingPongCallback(pp, rounds);
+        runLoop(loop, pp);
+        auto elapsed = sw.elapsedNs();
+        printResult("ping-pong callback", pp.rounds, elapsed);
+        printf("  %-32s allocs/round=%.3f\n", "", double(allocCount() - allocs) / rounds);
+    }
+    {
+        PingPong pp(&loop);
+        if (!pp.attach()) {
+            printf("failed to create socket pair\n");
+            return -1;
+        }
+        coro::TcpStream stream(pp.socket);
+        auto allocs = allocCount();
+        StopWatch sw;
+        pingPongCoroutine(&pp, &stream, rounds).start();
+        runLoop(loop, pp);
+        auto elapsed = sw.elapsedNs();
+        printResult("ping-pong coroutine", pp.rounds, elapsed);
+        printf("  %-32s allocs/round=%.3f\n", "", double(allocCount() - allocs) / rounds);
+    }
+
+    // the cost of a nested coroutine call against a std::function call
+    int calls = rounds * 10;
+    int result = 0;
+    std::function<int(int, int)> func = [] (int a, int b) { return a + b; };
+    StopWatch sw;
+    for (int i = 0; i < calls; ++i) {
+        result = func(result, i);
+    }
+    printResult("std::function call", calls, sw.elapsedNs());
+    result = 0;
+    auto allocs = allocCount();
+    sw.start();
+    sumCoroutine(calls, &result).start();
+    printResult("co_await Task<int>", calls, sw.elapsedNs());
+    printf("  %-32s allocs/call=%.3f\n", "", double(allocCount() - allocs) / calls);
+    return 0;
+}
+
+} // namespace
+
+#else
+
+namespace {
+
+int coroBench(int, char **)
+{
+    printf("  coroutine is not enabled, build CoroBench.cpp with C++20\n");
+    return 0;
+}
+
+} // namespace
+
+#endif // KUMA_HAS_COROUTINE
+
+BENCH_REGISTER("coro", "[rounds]", coroBench);
@@ -0,0 +1,158 @@
+#include "kmbuffer.h"
+#include "BenchUtil.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace kuma;
+
+namespace {
+
+// the frame sizes of a H2 connection under load, it is the frameSize of H2Connection::Impl::sendH2Frame
+// and sendHeadersFrame, DATA frames dominate the bytes, HEADERS and WINDOW_UPDATE dominate the count
+const size_t kH2FrameSizes[] = {
+    9 + 16384, 9 + 16384, 9 + 16384, 9 + 4096,  // DATA
+    9 + 180, 9 + 260,                           // HEADERS
+    9 + 4, 9 + 4,                               // WINDOW_UPDATE
+};
+
+// WebSocket messages of 50 to 2K bytes, the unsent part is copied to send buffer by
+// TcpConnection::send when the socket is write blocked
+const size_t kWsMessageSizes[] = { 64, 120, 200, 50, 512, 180, 2048, 96 };
+
+// the frames queued in send buffer before they are written out
+const size_t kInflight = 32;
+
+struct Result
+{
+    uint64_t ops = 0;
+    uint64_t allocs = 0; // process wide, see runThreads
+    uint64_t bytes = 0; // storage of the buffers, see CountingAllocator
+    uint64_t payload = 0;
+    uint64_t elapsed_ns = 0;
+};
+
+// counts the storage bytes taken by buffers, a pooled buffer takes the whole block
+// of its size class
+template<typename Base>
+class CountingAllocator : public Base
+{
+public:
+    using value_type = char;
+
+    explicit CountingAllocator(uint64_t &bytes) : bytes_(&bytes) {}
+
+    char* allocate(size_t n)
+    {
+        *bytes_ += blockSize(n, static_cast<Base*>(nullptr));
+        return Base::allocate(n);
+    }
+
+private:
+    static size_t blockSize(size_t n, std::allocator<char>*) { return n; }
+    static size_t blockSize(size_t n, KMPoolAllocator<char>*)
+    {
+        auto index = KMBufferPool::classIndex(n);
+        return index < KMBufferPool::CLASS_COUNT ? KMBufferPool::classSize(index) : n;
+    }
+
+    uint64_t* bytes_;
+};
+
+template<typename MakeBuffer>
+void runH2(int frames, MakeBuffer &&make, Result &result)
+{
+    std::vector<std::unique_ptr<KMBuffer>> inflight(kInflight);
+    const size_t n = sizeof(kH2FrameSizes) / sizeof(kH2FrameSizes[0]);
+    StopWatch sw;
+    for (int i = 0; i < frames; ++i) {
+        auto *buf = make(kH2FrameSizes[i % n], result.bytes);
+        result.payload += kH2FrameSizes[i % n];
+        memset(buf->writePtr(), 0, 9); // frame header
+        buf->bytesWritten(buf->space());
+        inflight[i % kInflight].reset(buf);
+    }
+    inflight.clear();
+    result.elapsed_ns += sw.elapsedNs();
+    result.ops += frames;
+}
+
+template<typename MakeBuffer>
+void runWs(int messages, MakeBuffer &&make, Result &result)
+{
+    std::vector<std::unique_ptr<KMBuffer>> inflight(kInflight);
+    const size_t n = sizeof(kWsMessageSizes) / sizeof(kWsMessageSizes[0]);
+    char payload[2048] = { 0 };
+    StopWatch sw;
+    for (int i = 0; i < messages; ++i) {
+        auto len = kWsMessageSizes[i % n];
+        // the frame header is sent, the payload is kept in send buffer
+        auto *buf = make(len, result.bytes);
+        result.payload += len;
+        buf->write(payload, len);
+        inflight[i % kInflight].reset(buf);
+    }
+    inflight.clear();
+    result.elapsed_ns += sw.elapsedNs();
+    result.ops += messages;
+}
+
+template<typename Func>
+Result runThreads(int threads, Func &&func)
+{
+    std::vector<Result> results(threads);
+    std::vector<std::thread> workers;
+    auto allocs = allocCount();
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&func, &results, i] { func(results[i]); });
+    }
+    for (auto &t : workers) {
+        t.join();
+    }
+    Result total;
+    total.allocs = allocCount() - allocs;
+    for (auto &r : results) {
+        total.ops += r.ops;
+        total.bytes += r.bytes;
+        total.payload += r.payload;
+        total.elapsed_ns = std::max(total.elapsed_ns, r.elapsed_ns);
+    }
+    return total;
+}
+
+void printAllocs(const char* name, const Result &result)
+{
+    printResult(name, result.ops, result.elapsed_ns);
+    // new KMBuffer is counted as well
+    auto ops = result.ops ? double(result.ops) : 1.0;
+    printf("  %-32s allocs/op=%.3f, bytes/op=%.1f, payload/op=%.1f\n", "",
+           result.allocs / ops, result.bytes / ops, result.payload / ops);
+}
+
+int kmbufferBench(int argc, char *argv[])
+{
+    int ops = getIntArg(argc, argv, 1, 1000000);
+    int threads = getIntArg(argc, argv, 2, 4);
+    printf("  ops=%d, threads=%d, inflight=%d\n", ops, threads, int(kInflight));
+
+    auto makeHeap = [] (size_t size, uint64_t &bytes) {
+        CountingAllocator<std::allocator<char>> a(bytes);
+        return new KMBuffer(size, a);
+    };
+    auto makePool = [] (size_t size, uint64_t &bytes) {
+        CountingAllocator<KMPoolAllocator<char>> a(bytes);
+        return new KMBuffer(size, a);
+    };
+
+    printAllocs("H2 frame, std::allocator", runThreads(threads, [&] (Result &r) { runH2(ops, makeHeap, r); }));
+    printAllocs("H2 frame, KMBufferPool", runThreads(threads, [&] (Result &r) { runH2(ops, makePool, r); }));
+    printAllocs("WS message, std::allocator", runThreads(threads, [&] (Result &r) { runWs(ops, makeHeap, r); }));
+    printAllocs("WS message, KMBufferPool", runThreads(threads, [&] (Result &r) { runWs(ops, makePool, r); }));
+
+    return 0;
+}
+
+} // namespace
+
+BENCH_REGISTER("kmbuffer", "[ops] [threads]", kmbufferBench);
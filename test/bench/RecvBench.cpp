@@ -0,0 +1,135 @@
+#include "kmapi.h"
+#include "BenchUtil.h"
+
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef KUMA_OS_WIN
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace kuma;
+
+namespace {
+
+const char* kUpgradeRequest =
+    "GET / HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "\r\n";
+
+// masked binary frame with zero mask key, so the payload is not changed by unmasking
+std::vector<uint8_t> buildFrame(size_t plen)
+{
+    std::vector<uint8_t> frame;
+    frame.push_back(0x82);
+    if (plen <= 125) {
+        frame.push_back(0x80 | uint8_t(plen));
+    } else if (plen <= 0xFFFF) {
+        frame.push_back(0x80 | 126);
+        frame.push_back(uint8_t(plen >> 8));
+        frame.push_back(uint8_t(plen));
+    } else {
+        frame.push_back(0x80 | 127);
+        for (int i = 7; i >= 0; --i) {
+            frame.push_back(uint8_t(plen >> (i * 8)));
+        }
+    }
+    frame.insert(frame.end(), 4, 0); // mask key
+    frame.insert(frame.end(), plen, 'x');
+    return frame;
+}
+
+bool writeAll(int fd, const void *data, size_t len)
+{
+    auto *ptr = static_cast<const char*>(data);
+    while (len > 0) {
+        auto ret = ::write(fd, ptr, len);
+        if (ret <= 0) {
+            return false;
+        }
+        ptr += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+// the WebSocket frames are written by another thread, and are received by WebSocket in
+// server mode. the frames across the reads used to be copied to the decode context
+int recvBench(int argc, char *argv[])
+{
+#ifndef KUMA_OS_WIN
+    int frames = getIntArg(argc, argv, 1, 100000);
+    int frame_size = getIntArg(argc, argv, 2, 4096);
+    EventLoop loop;
+    if (!loop.init()) {
+        printf("failed to init EventLoop\n");
+        return -1;
+    }
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        printf("failed to create socket pair\n");
+        return -1;
+    }
+    printf("  frames=%d, frame_size=%d\n", frames, frame_size);
+
+    uint64_t total_bytes = uint64_t(frames) * frame_size;
+    uint64_t received = 0;
+    uint64_t chained_bytes = 0;
+    uint64_t messages = 0;
+    bool done = false;
+    WebSocket ws(&loop);
+    ws.setDataCallback([&] (KMBuffer &buf, bool, bool) {
+        auto len = buf.chainLength();
+        received += len;
+        if (buf.isChained()) {
+            chained_bytes += len;
+        }
+        ++messages;
+        if (received >= total_bytes) {
+            done = true;
+        }
+    });
+    ws.setErrorCallback([&] (KMError) { done = true; });
+
+    auto frame = buildFrame(frame_size);
+    std::thread writer([&] {
+        writeAll(fds[1], kUpgradeRequest, strlen(kUpgradeRequest));
+        for (int i = 0; i < frames; ++i) {
+            if (!writeAll(fds[1], &frame[0], frame.size())) {
+                break;
+            }
+        }
+    });
+    // the upgrade response is small, it stays in socket buffer
+    ws.attachFd(fds[0]);
+
+    auto allocs = allocCount();
+    StopWatch sw;
+    while (!done) {
+        loop.loopOnce(10);
+    }
+    auto elapsed = sw.elapsedNs();
+    allocs = allocCount() - allocs;
+    writer.join();
+
+    printResult("WebSocket receive", messages, elapsed);
+    printf("  %-32s %.1f MB/s, allocs/MB=%.1f\n", "",
+           elapsed ? received * 1000.0 / elapsed : 0, received ? allocs * 1048576.0 / received : 0);
+    printf("  %-32s bytes received as slices=%.3f/byte\n", "",
+           received ? double(chained_bytes) / received : 0);
+    ws.close();
+    ::close(fds[1]);
+#endif
+    return 0;
+}
+
+} // namespace
+
+BENCH_REGISTER("recv", "[frames] [frame_size]", recvBench);
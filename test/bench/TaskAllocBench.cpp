@@ -0,0 +1,122 @@
+#include "kmapi.h"
+#include "util/kmqueue.h"
+#include "BenchUtil.h"
+
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+
+using namespace kuma;
+
+namespace {
+
+// a capture like the ones in SocketBase and H2Connection, a shared_ptr plus several fields
+struct Capture
+{
+    std::shared_ptr<int> ptr;
+    void* obj;
+    uint32_t events;
+    size_t len;
+    void* ctx;
+};
+
+struct Sink
+{
+    std::atomic<uint64_t> executed{ 0 };
+};
+
+void printAllocs(const char* name, uint64_t tasks, uint64_t allocs, uint64_t elapsed_ns)
+{
+    printResult(name, tasks, elapsed_ns);
+    printf("  %-32s allocs/task=%.2f\n", "", tasks ? double(allocs) / tasks : 0);
+}
+
+template <typename Func>
+void runConstructBench(const char* name, int tasks, Sink &sink)
+{
+    auto ptr = std::make_shared<int>(1);
+    StopWatch sw;
+    auto allocs = allocCount();
+    for (int i = 0; i < tasks; ++i) {
+        Capture c{ ptr, &sink, uint32_t(i), size_t(i), nullptr };
+        Func f([c, &sink] { sink.executed.fetch_add(c.events ? 1 : 0, std::memory_order_relaxed); });
+        f();
+    }
+    allocs = allocCount() - allocs;
+    printAllocs(name, tasks, allocs, sw.elapsedNs());
+}
+
+// the DLQueue path of the old EventLoop::post, std::function plus shared_ptr node
+void runLegacyPostBench(int tasks, Sink &sink)
+{
+    using LegacyTask = std::function<void(void)>;
+    auto ptr = std::make_shared<int>(1);
+    DLQueue<LegacyTask> queue;
+    std::mutex mutex;
+    StopWatch sw;
+    auto allocs = allocCount();
+    for (int i = 0; i < tasks; ++i) {
+        Capture c{ ptr, &sink, uint32_t(i), size_t(i), nullptr };
+        LegacyTask task([c, &sink] { sink.executed.fetch_add(c.events ? 1 : 0, std::memory_order_relaxed); });
+        std::lock_guard<std::mutex> g(mutex);
+        queue.enqueue(std::move(task));
+    }
+    LegacyTask task;
+    while (queue.dequeue(task)) {
+        task();
+    }
+    allocs = allocCount() - allocs;
+    printAllocs("DLQueue+std::function post", tasks, allocs, sw.elapsedNs());
+}
+
+void runEventLoopPostBench(int tasks, Sink &sink)
+{
+    EventLoop loop;
+    std::thread loop_thread([&] {
+        if (loop.init()) {
+            loop.loop();
+        }
+    });
+    while (loop.sync([] {}) != KMError::NOERR) {
+        std::this_thread::yield();
+    }
+    auto ptr = std::make_shared<int>(1);
+    // warm up the task pool
+    for (int i = 0; i < 1024; ++i) {
+        loop.post([] {});
+    }
+    loop.sync([] {});
+
+    StopWatch sw;
+    auto allocs = allocCount();
+    for (int i = 0; i < tasks; ++i) {
+        Capture c{ ptr, &sink, uint32_t(i), size_t(i), nullptr };
+        loop.post([c, &sink] { sink.executed.fetch_add(c.events ? 1 : 0, std::memory_order_relaxed); });
+        if ((i & 511) == 511) {
+            loop.sync([] {}); // don't let the queue grow beyond the pool
+        }
+    }
+    loop.sync([] {});
+    allocs = allocCount() - allocs;
+    printAllocs("EventLoop::post", tasks, allocs, sw.elapsedNs());
+    loop.stop();
+    loop_thread.join();
+}
+
+int taskAllocBench(int argc, char *argv[])
+{
+    int tasks = getIntArg(argc, argv, 1, 1000000);
+    Sink sink;
+    printf("  tasks=%d, capture size=%d\n", tasks, int(sizeof(Capture)));
+    runConstructBench<std::function<void(void)>>("std::function", tasks, sink);
+    runConstructBench<EventLoop::Task>("EventLoop::Task", tasks, sink);
+    runLegacyPostBench(tasks, sink);
+    runEventLoopPostBench(tasks, sink);
+    return 0;
+}
+
+} // namespace
+
+BENCH_REGISTER("taskalloc", "[tasks]", taskAllocBench);
@@ -0,0 +1,219 @@
+#include "kmapi.h"
+#include "util/kmqueue.h"
+#include "BenchUtil.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+using namespace kuma;
+
+namespace {
+
+using Task = EventLoop::Task;
+using LegacyTask = std::function<void(void)>;
+
+//////////////////////////////////////////////////////////////////////////
+// the DLQueue + mutex task queue that EventLoop used before
+struct LegacySlot
+{
+    enum class State { ACTIVE, RUNNING, INACTIVE };
+    LegacySlot(LegacyTask &&t) : task(std::move(t)) {}
+    LegacyTask task;
+    State state = State::ACTIVE;
+};
+
+class LegacyTaskQueue
+{
+public:
+    void post(LegacyTask task)
+    {
+        auto node = std::make_shared<DLQueue<LegacySlot>::DLNode>(std::move(task));
+        std::lock_guard<std::mutex> g(task_mutex_);
+        task_queue_.enqueue(node);
+    }
+
+    size_t process()
+    {
+        size_t count = 0;
+        DLQueue<LegacySlot> tq;
+        std::unique_lock<std::mutex> ul(task_mutex_);
+        task_queue_.swap(tq);
+        while (auto node = tq.front_node()) {
+            tq.pop_front();
+            auto &slot = node->element();
+            slot.state = LegacySlot::State::RUNNING;
+            ul.unlock();
+            {
+                std::lock_guard<std::mutex> g(task_run_mutex_);
+                if (slot.state != LegacySlot::State::INACTIVE) {
+                    slot.task();
+                    slot.state = LegacySlot::State::INACTIVE;
+                }
+            }
+            ul.lock();
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    DLQueue<LegacySlot> task_queue_;
+    std::mutex task_mutex_;
+    std::mutex task_run_mutex_;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// intrusive MPSC queue with pooled nodes
+struct PooledSlot
+{
+    Task task;
+    std::atomic<PooledSlot*> mpsc_next_{ nullptr };
+    uint32_t pool_index_ = 0;
+    std::atomic<uint32_t> pool_next_{ 0 };
+};
+
+class MPSCTaskQueue
+{
+public:
+    void post(Task task)
+    {
+        auto *slot = pool_.acquire();
+        slot->task = std::move(task);
+        queue_.enqueue(slot);
+    }
+
+    size_t process()
+    {
+        size_t count = 0;
+        while (auto *slot = queue_.dequeue()) {
+            slot->task();
+            slot->task = nullptr;
+            pool_.release(slot);
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    NodePool<PooledSlot> pool_;
+    MPSCQueue<PooledSlot> queue_;
+};
+
+template <typename Queue>
+uint64_t runQueueBench(int producers, int tasks_per_producer)
+{
+    Queue q;
+    std::atomic<uint64_t> executed{ 0 };
+    std::atomic<bool> start{ false };
+    const uint64_t total = uint64_t(producers) * tasks_per_producer;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back([&] {
+            while (!start) std::this_thread::yield();
+            for (int j = 0; j < tasks_per_producer; ++j) {
+                q.post([&executed] { executed.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+
+    StopWatch sw;
+    start = true;
+    uint64_t processed = 0;
+    while (processed < total) {
+        auto n = q.process();
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        processed += n;
+    }
+    auto elapsed = sw.elapsedNs();
+    for (auto &t : threads) {
+        t.join();
+    }
+    if (executed != total) {
+        printf("  ERROR: executed=%llu, expected=%llu\n", (unsigned long long)executed.load(), (unsigned long long)total);
+    }
+    return elapsed;
+}
+
+// end to end, post tasks to a running EventLoop from worker threads
+uint64_t runEventLoopBench(int producers, int tasks_per_producer, bool with_token, int batch = 1)
+{
+    EventLoop loop;
+    std::atomic<uint64_t> executed{ 0 };
+    const uint64_t total = uint64_t(producers) * tasks_per_producer;
+
+    std::thread loop_thread([&] {
+        if (!loop.init()) {
+            printf("  ERROR: failed to init EventLoop\n");
+            return;
+        }
+        loop.loop();
+    });
+    // make sure the loop is initialized
+    while (loop.sync([] {}) != KMError::NOERR) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<bool> start{ false };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back([&] {
+            auto token = loop.createToken();
+            std::vector<EventLoop::Task> tasks;
+            while (!start) std::this_thread::yield();
+            for (int j = 0; j < tasks_per_producer; ++j) {
+                Task task([&executed] { executed.fetch_add(1, std::memory_order_relaxed); });
+                if (batch <= 1) {
+                    loop.post(std::move(task), with_token ? &token : nullptr);
+                    continue;
+                }
+                tasks.emplace_back(std::move(task));
+                if (tasks.size() >= size_t(batch) || j + 1 == tasks_per_producer) {
+                    loop.postBatch(tasks, with_token ? &token : nullptr);
+                    tasks.clear();
+                }
+            }
+            while (with_token && executed < total) {
+                std::this_thread::yield(); // don't cancel the tasks
+            }
+        });
+    }
+
+    StopWatch sw;
+    start = true;
+    while (executed < total) {
+        std::this_thread::yield();
+    }
+    auto elapsed = sw.elapsedNs();
+    for (auto &t : threads) {
+        t.join();
+    }
+    loop.stop();
+    loop_thread.join();
+    return elapsed;
+}
+
+int taskQueueBench(int argc, char *argv[])
+{
+    int producers = getIntArg(argc, argv, 1, 4);
+    int tasks = getIntArg(argc, argv, 2, 500000);
+    int batch = getIntArg(argc, argv, 3, 64);
+    uint64_t total = uint64_t(producers) * tasks;
+    printf("  producers=%d, tasks_per_producer=%d, batch=%d\n", producers, tasks, batch);
+
+    printResult("DLQueue+mutex", total, runQueueBench<LegacyTaskQueue>(producers, tasks));
+    printResult("MPSCQueue+NodePool", total, runQueueBench<MPSCTaskQueue>(producers, tasks));
+    printResult("EventLoop::post", total, runEventLoopBench(producers, tasks, false));
+    printResult("EventLoop::post with token", total, runEventLoopBench(producers, tasks, true));
+    printResult("EventLoop::postBatch", total, runEventLoopBench(producers, tasks, false, batch));
+    printResult("EventLoop::postBatch with token", total, runEventLoopBench(producers, tasks, true, batch));
+    return 0;
+}
+
+} // namespace
+
+BENCH_REGISTER("taskqueue", "[producers] [tasks_per_producer] [batch]", taskQueueBench);
@@ -0,0 +1,69 @@
+#include "kmapi.h"
+#include "BenchUtil.h"
+
+#include <memory>
+#include <vector>
+#include <thread>
+
+using namespace kuma;
+
+namespace {
+
+using TimerList = std::vector<std::unique_ptr<Timer>>;
+
+// all timers are scheduled and cancelled in loop thread, which is the usual
+// case of per-connection idle timers
+int timerBench(int argc, char *argv[])
+{
+    int timers = getIntArg(argc, argv, 1, 1000000);
+    EventLoop loop;
+    if (!loop.init()) {
+        printf("failed to init EventLoop\n");
+        return -1;
+    }
+    TimerList timer_list;
+    timer_list.reserve(timers);
+    for (int i = 0; i < timers; ++i) {
+        timer_list.emplace_back(new Timer(&loop));
+    }
+    uint64_t fired = 0;
+    printf("  timers=%d\n", timers);
+
+    // delays spread over all the timer vectors
+    StopWatch sw;
+    for (int i = 0; i < timers; ++i) {
+        timer_list[i]->schedule(1000 + uint32_t(i) * 7 % 3600000, [&fired] { ++fired; });
+    }
+    printResult("schedule", timers, sw.elapsedNs());
+
+    sw.start();
+    for (int i = 0; i < timers; ++i) {
+        timer_list[i]->schedule(2000 + uint32_t(i) * 13 % 3600000, [&fired] { ++fired; });
+    }
+    printResult("reschedule armed timer", timers, sw.elapsedNs());
+
+    sw.start();
+    for (int i = 0; i < timers; ++i) {
+        timer_list[i]->cancel();
+    }
+    printResult("cancel", timers, sw.elapsedNs());
+
+    for (int i = 0; i < timers; ++i) {
+        timer_list[i]->schedule(1 + i % 64, [&fired] { ++fired; });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    sw.start();
+    while (fired < uint64_t(timers)) {
+        loop.loopOnce(0);
+    }
+    printResult("expire", timers, sw.elapsedNs());
+
+    sw.start();
+    timer_list.clear();
+    printResult("destroy", timers, sw.elapsedNs());
+    return 0;
+}
+
+} // namespace
+
+BENCH_REGISTER("timer", "[timers]", timerBench);
@@ -0,0 +1,85 @@
+#include "kmapi.h"
+#include "BenchUtil.h"
+
+#include <string.h>
+#include <atomic>
+#include <new>
+
+#ifndef KUMA_OS_WIN
+#include <signal.h>
+#endif
+
+using namespace kuma;
+
+static std::atomic<uint64_t> s_alloc_count{ 0 };
+
+void* operator new(size_t size)
+{
+    s_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+uint64_t allocCount()
+{
+    return s_alloc_count.load(std::memory_order_relaxed);
+}
+
+std::vector<BenchEntry>& benchRegistry()
+{
+    static std::vector<BenchEntry> s_registry;
+    return s_registry;
+}
+
+void printUsage()
+{
+    printf("   bench <name> [args]\n");
+    for (auto &entry : benchRegistry()) {
+        printf("   bench %s %s\n", entry.name, entry.usage);
+    }
+    printf("   bench all\n");
+}
+
+int main(int argc, char *argv[])
+{
+#ifndef KUMA_OS_WIN
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    if (argc < 2) {
+        printUsage();
+        return -1;
+    }
+
+    kuma::init();
+    setTraceFunc([] (int level, const char* msg) {
+        if (level <= 1) { // error only
+            printf("%s\n", msg);
+        }
+    });
+
+    int ret = -1;
+    bool run_all = strcmp(argv[1], "all") == 0;
+    for (auto &entry : benchRegistry()) {
+        if (run_all || strcmp(argv[1], entry.name) == 0) {
+            printf("[%s]\n", entry.name);
+            ret = entry.func(run_all ? 1 : argc - 1, argv + 1);
+            if (!run_all) {
+                break;
+            }
+        }
+    }
+    if (ret == -1 && !run_all) {
+        printUsage();
+    }
+
+    kuma::fini();
+    return ret;
+}
@@ -51,6 +51,7 @@ static const std::string g_usage =
 "   client [option] mcast//224.0.0.1:52328\n\n"
 "   -b host:port    local host and port to be bound to\n"
 "   -c number       concurrent clients\n"
+"   -p poll         poll type of the client loops, epoll|poll|select|kqueue|iocp|uring\n"
 "   -t ms           send interval\n"
 "   -v              print version\n"
 "   --http2         test http2\n"
@@ -68,6 +69,24 @@ std::string getHttpVersion()
     return g_test_http2 ? "HTTP/2.0": "HTTP/1.1";
 }
 
+static PollType getPollType(const char *name)
+{
+    if (strcmp(name, "epoll") == 0) {
+        return PollType::EPOLL;
+    } else if (strcmp(name, "poll") == 0) {
+        return PollType::POLL;
+    } else if (strcmp(name, "select") == 0) {
+        return PollType::SELECT;
+    } else if (strcmp(name, "kqueue") == 0) {
+        return PollType::KQUEUE;
+    } else if (strcmp(name, "iocp") == 0) {
+        return PollType::IOCP;
+    } else if (strcmp(name, "uring") == 0) {
+        return PollType::IO_URING;
+    }
+    return PollType::NONE;
+}
+
 static uint32_t _send_interval_ = 0;
 uint32_t getSendInterval()
 {
@@ -93,6 +112,7 @@ int main(int argc, char *argv[])
     std::string addr;
     std::string bind_addr;
     int concurrent = 1;
+    PollType poll_type = PollType::NONE;
     
     for (int i=1; i<argc; ++i) {
         if(argv[i][0] == '-') {
@@ -116,6 +136,14 @@ int main(int argc, char *argv[])
                         return -1;
                     }
                     break;
+                case 'p':
+                    if (++i < argc) {
+                        poll_type = getPollType(argv[i]);
+                    } else {
+                        printUsage();
+                        return -1;
+                    }
+                    break;
                 case 't':
                     if (++i < argc) {
                         _send_interval_ = atoi(argv[i]);
@@ -161,7 +189,10 @@ int main(int argc, char *argv[])
     }
     
     LoopPool loop_pool;
-    loop_pool.init(THREAD_COUNT, main_loop.getPollType());
+    if (poll_type == PollType::NONE) {
+        poll_type = main_loop.getPollType();
+    }
+    loop_pool.init(THREAD_COUNT, poll_type);
     loop_pool.startTest(addr, bind_addr, concurrent);
     
     main_loop.loop();
@@ -0,0 +1,93 @@
+#include "AcceptBench.h"
+#include "util/util.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#ifdef KUMA_OS_WIN
+# include <Ws2tcpip.h>
+# define close_socket closesocket
+#else
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# include <unistd.h>
+# define close_socket ::close
+#endif
+
+static void connectLoop(const std::string &host, uint16_t port, int count, std::atomic<int> &failed)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+    for (int i = 0; i < count; ++i) {
+        auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == INVALID_FD) {
+            ++failed;
+            continue;
+        }
+        if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            ++failed;
+            close_socket(fd);
+            continue;
+        }
+        // wait for the server closing, so TIME_WAIT stays on server side
+        char buf[16];
+        ::recv(fd, buf, sizeof(buf), 0);
+        close_socket(fd);
+    }
+}
+
+int runAcceptBench(const std::string &host, uint16_t port, int conn_count, int client_count)
+{
+    EventLoop loop;
+    if (!loop.init()) {
+        printf("failed to init EventLoop\n");
+        return -1;
+    }
+    std::atomic<int> accepted{0};
+    TcpListener listener(&loop);
+    listener.setAcceptCallback([&accepted] (SOCKET_FD, const char*, uint16_t) {
+        ++accepted;
+        return false; // close the fd
+    });
+    listener.setBacklog(1024);
+    auto ret = listener.startListen(host.c_str(), port);
+    if (ret != KMError::NOERR) {
+        printf("failed to listen on %s:%u\n", host.c_str(), port);
+        return -1;
+    }
+    std::thread loop_thread([&loop] { loop.loop(); });
+
+    std::string conn_host = host == "0.0.0.0" ? "127.0.0.1" : host;
+    std::atomic<int> failed{0};
+    std::vector<std::thread> clients;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < client_count; ++i) {
+        int count = conn_count / client_count + (i < conn_count % client_count ? 1 : 0);
+        clients.emplace_back(connectLoop, conn_host, port, count, std::ref(failed));
+    }
+    for (auto &thr : clients) {
+        thr.join();
+    }
+    while (accepted + failed < conn_count) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    loop.sync([&listener] { listener.close(); });
+    loop.stop();
+    loop_thread.join();
+
+    double secs = elapsed / 1000000.0;
+    printf("accept bench: clients=%d, accepted=%d, failed=%d, time=%.3fs, rate=%.0f accepts/sec\n",
+           client_count, accepted.load(), failed.load(), secs, secs > 0 ? accepted / secs : 0.0);
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef __AcceptBench_H__
+#define __AcceptBench_H__
+
+#include "kmapi.h"
+
+#include <string>
+
+using namespace kuma;
+
+/* connection rate benchmark, conn_count connections are made to host:port by
+ * client threads, the listener closes the fd once accepted.
+ * it prints accepted connections per second
+ */
+int runAcceptBench(const std::string &host, uint16_t port, int conn_count, int client_count);
+
+#endif
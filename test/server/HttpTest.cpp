@@ -49,6 +49,7 @@ KMError HttpTest::attachStream(H2Connection* conn, uint32_t streamId)
 int HttpTest::close()
 {
     http_.close();
+    closeTestFile();
     return 0;
 }
 
@@ -65,6 +66,7 @@ void HttpTest::onClose(KMError err)
 {
     printf("HttpTest_%ld::onClose, err=%d\n", conn_id_, err);
     http_.close();
+    closeTestFile();
     obj_mgr_->removeObject(conn_id_);
 }
 
@@ -121,18 +123,21 @@ void HttpTest::onRequestComplete()
             state_ = State::SENDING_FILE;
         }
         if (State::SENDING_FILE == state_) {
-            if (fileExist(file)) {
+            if (fileExist(file) && (file_fd_ = openFile(file, file_size_)) >= 0) {
                 file_name_ = std::move(file);
+                file_offset_ = 0;
                 std::string path, name, ext;
                 splitPath(file_name_, path, name, ext);
                 http_.addHeader("Content-Type", getMime(ext).c_str());
+                // the file is sent by sendfile with Content-Length
+                http_.addHeader("Content-Length", std::to_string(file_size_).c_str());
             } else {
                 file_name_.clear();
                 status = 404;
                 desc = "Not Found";
                 http_.addHeader("Content-Type", "text/html");
+                http_.addHeader("Transfer-Encoding", "chunked");
             }
-            http_.addHeader("Transfer-Encoding", "chunked");
         }
     }
     http_.sendResponse(status, desc.c_str());
@@ -141,22 +146,13 @@ void HttpTest::onRequestComplete()
 void HttpTest::onResponseComplete()
 {
     printf("HttpTest_%ld::onResponseComplete\n", conn_id_);
+    closeTestFile();
     http_.reset();
 }
 
 void HttpTest::sendTestFile()
 {
-    FILE *fp = nullptr;
-#ifdef KUMA_OS_WIN
-    auto err = fopen_s(&fp, file_name_.c_str(), "rb");
-#else
-    fp = fopen(file_name_.c_str(), "rb");
-#endif
-    if (!fp) {
-        printf("failed to open file %s\n", file_name_.c_str());
-        file_name_.clear();
-    }
-    if (file_name_.empty()) {
+    if (file_fd_ < 0) {
         static const std::string not_found("<html><body>404 Not Found!</body></html>");
         //http_.sendData((const uint8_t*)(not_found.c_str()), not_found.size());
         //http_.sendData(nullptr, 0);
@@ -166,24 +162,21 @@ void HttpTest::sendTestFile()
         http_.sendData(buf);
         return;
     }
-    //uint8_t buf[4096];
-    //auto nread = fread(buf, 1, sizeof(buf), fp);
-    KMBuffer buf(4096);
-    auto nread = fread(buf.writePtr(), 1, buf.space(), fp);
-    buf.bytesWritten(nread);
-    fclose(fp);
-    if (nread > 0) {
-        //int ret = http_.sendData(buf, nread);
-        int ret = http_.sendData(buf);
-        if (ret < 0) {
+    while (file_offset_ < file_size_) {
+        int ret = http_.sendFile(file_fd_, file_offset_, size_t(file_size_ - file_offset_));
+        if (ret <= 0) {
+            // wait for write callback if ret is 0
             return;
-        } else if (ret < nread) {
-            // should buffer remain data
-            return;
-        } else {
-            // end response
-            http_.sendData(nullptr, 0);
         }
+        file_offset_ += ret;
+    }
+}
+
+void HttpTest::closeTestFile()
+{
+    if (file_fd_ >= 0) {
+        closeFile(file_fd_);
+        file_fd_ = -1;
     }
 }
 
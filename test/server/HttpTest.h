@@ -39,6 +39,7 @@ private:
     void sendTestFile();
     void sendTestData();
     void sendNormal();
+    void closeTestFile();
     
 private:
     ObjectManager*  obj_mgr_;
@@ -48,6 +49,9 @@ private:
     bool            is_options_ = false;
     size_t          total_bytes_read_ = 0;
     std::string     file_name_;
+    int             file_fd_ = -1;
+    int64_t         file_size_ = 0;
+    int64_t         file_offset_ = 0;
 };
 
 #endif
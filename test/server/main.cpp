@@ -2,6 +2,7 @@
 #include "util/util.h"
 #include "TcpServer.h"
 #include "UdpServer.h"
+#include "AcceptBench.h"
 #include "util/defer.h"
 #include "testutil.h"
 
@@ -19,9 +20,10 @@
 using namespace kuma;
 
 #define THREAD_COUNT    5
+#define BENCH_CLIENT_COUNT  4
 
 static bool g_exit = false;
-EventLoop main_loop(PollType::NONE);
+EventLoop* main_loop = nullptr;
 std::string www_path;
 
 #ifdef KUMA_OS_WIN
@@ -29,7 +31,7 @@ BOOL WINAPI HandlerRoutine(DWORD dwCtrlType)
 {
     if(CTRL_C_EVENT == dwCtrlType) {
         g_exit = TRUE;
-        main_loop.stop();
+        if (main_loop) main_loop->stop();
         return TRUE;
     }
     return FALSE;
@@ -39,7 +41,7 @@ void HandlerRoutine(int sig)
 {
     if(sig == SIGTERM || sig == SIGINT || sig == SIGKILL) {
         g_exit = true;
-        main_loop.stop();
+        if (main_loop) main_loop->stop();
     }
 }
 #endif
@@ -50,11 +52,31 @@ static const std::string g_usage =
 "   server [option] ws://0.0.0.0:8443\n"
 "   server [option] udp://0.0.0.0:52328\n"
 "   server [option] auto://0.0.0.0:8443\n"
+"   -c connections  run connection rate benchmark against tcp listen address\n"
+"   -p poll         poll type of the server loops, epoll|poll|select|kqueue|iocp|uring\n"
 "   -v              print version\n"
 ;
 
 std::vector<std::thread> event_threads;
 
+static PollType getPollType(const char *name)
+{
+    if (strcmp(name, "epoll") == 0) {
+        return PollType::EPOLL;
+    } else if (strcmp(name, "poll") == 0) {
+        return PollType::POLL;
+    } else if (strcmp(name, "select") == 0) {
+        return PollType::SELECT;
+    } else if (strcmp(name, "kqueue") == 0) {
+        return PollType::KQUEUE;
+    } else if (strcmp(name, "iocp") == 0) {
+        return PollType::IOCP;
+    } else if (strcmp(name, "uring") == 0) {
+        return PollType::IO_URING;
+    }
+    return PollType::NONE;
+}
+
 void printUsage()
 {
     printf("%s\n", g_usage.c_str());
@@ -88,10 +110,28 @@ int main(int argc, char *argv[])
     www_path += "test/www";
     
     std::string listen_addr;
+    int bench_conns = 0;
+    PollType poll_type = PollType::NONE;
     
     for (int i=1; i<argc; ++i) {
         if(argv[i][0] == '-') {
             switch (argv[i][1]) {
+                case 'c':
+                    if (i + 1 < argc) {
+                        bench_conns = atoi(argv[++i]);
+                    } else {
+                        printUsage();
+                        return -1;
+                    }
+                    break;
+                case 'p':
+                    if (i + 1 < argc) {
+                        poll_type = getPollType(argv[++i]);
+                    } else {
+                        printUsage();
+                        return -1;
+                    }
+                    break;
                 case 'v':
                     printf("kuma test server v1.0\n");
                     return 0;
@@ -118,23 +158,29 @@ int main(int argc, char *argv[])
     
     kuma::init();
     DEFER([]{ kuma::fini(); });
-    if (!main_loop.init()) {
+    if (bench_conns > 0) {
+        return runAcceptBench(host, port, bench_conns, BENCH_CLIENT_COUNT);
+    }
+    EventLoop loop(poll_type);
+    main_loop = &loop;
+    if (!loop.init()) {
         printf("failed to init EventLoop\n");
         return -1;
     }
     
     if(strcmp(proto, "udp") == 0) {
-        UdpServer udp_server(&main_loop);
+        UdpServer udp_server(&loop);
         udp_server.bind(host, port);
-        main_loop.loop();
+        loop.loop();
         udp_server.close();
     } else {
-        TcpServer tcp_server(&main_loop, THREAD_COUNT);
+        TcpServer tcp_server(&loop, THREAD_COUNT);
         tcp_server.startListen(proto, host, port);
-        main_loop.loop();
+        loop.loop();
         tcp_server.stopListen();
     }
     
+    main_loop = nullptr;
     printf("main exit...\n");
 #ifdef KUMA_OS_WIN
     SetConsoleCtrlHandler(HandlerRoutine, FALSE);
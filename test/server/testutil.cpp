@@ -2,9 +2,11 @@
 
 #include <string>
 #include <sys/stat.h>
+#include <fcntl.h>
 
 #ifdef KUMA_OS_WIN
 # include <direct.h>
+# include <io.h>
 #else
 # include <unistd.h>
 # ifdef KUMA_OS_MAC
@@ -119,6 +121,36 @@ bool fileExist(const std::string &file)
     return true;
 }
 
+int openFile(const std::string &file, int64_t &size)
+{
+#ifdef KUMA_OS_WIN
+    int fd = _open(file.c_str(), _O_RDONLY | _O_BINARY);
+    struct _stat64 st;
+    if (fd >= 0 && _fstat64(fd, &st) != 0) {
+        _close(fd);
+        fd = -1;
+    }
+#else
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) != 0) {
+        close(fd);
+        fd = -1;
+    }
+#endif
+    size = fd >= 0 ? st.st_size : 0;
+    return fd;
+}
+
+void closeFile(int fd)
+{
+#ifdef KUMA_OS_WIN
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
 bool isDir(const std::string &dir)
 {
     _f_stat_t buf;
@@ -14,6 +14,9 @@ std::string getCurrentModulePath();
 bool splitPath(const std::string &uri, std::string &path, std::string &name, std::string &ext);
 bool fileExist(const std::string &file);
 bool isDir(const std::string &dir);
+// open file for read, return -1 on failure
+int openFile(const std::string &file, int64_t &size);
+void closeFile(int fd);
 std::string getMime(const std::string &ext);
 
 #endif
@@ -0,0 +1,225 @@
+
+#include <gtest/gtest.h>
+#include "kmcoro.h"
+
+#ifdef KUMA_HAS_COROUTINE
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace kuma;
+
+namespace {
+    coro::Task<int> add(int a, int b)
+    {
+        co_return a + b;
+    }
+
+    coro::Task<int> sum(int n)
+    {
+        int total = 0;
+        for (int i = 0; i < n; ++i) {
+            total = co_await add(total, i);
+        }
+        co_return total;
+    }
+
+    coro::Task<> runSum(int n, int *result)
+    {
+        *result = co_await sum(n);
+    }
+
+    // echo the data back after a delay, until the peer is closed
+    coro::Task<> echo(coro::TcpStream *stream, Timer *timer, std::atomic<int> *state)
+    {
+        char buf[64];
+        while (true) {
+            int ret = co_await stream->read(buf, sizeof(buf));
+            if (ret < 0) {
+                break;
+            }
+            co_await coro::sleep(*timer, 1);
+            if (co_await stream->write(buf, ret) != ret) {
+                break;
+            }
+            ++*state;
+        }
+        *state = -1;
+    }
+
+    coro::Task<> fetch(coro::HttpClient *client, const char *url, KMError *err, std::atomic<int> *state)
+    {
+        *err = co_await client->send("GET", url);
+        *state = 1;
+    }
+
+    int listenLoopback(uint16_t &port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addr_len = sizeof(addr);
+        if (fd < 0 || bind(fd, (sockaddr*)&addr, addr_len) != 0 || listen(fd, 1) != 0 ||
+            getsockname(fd, (sockaddr*)&addr, &addr_len) != 0) {
+            if (fd >= 0) ::close(fd);
+            return -1;
+        }
+        port = ntohs(addr.sin_port);
+        return fd;
+    }
+}
+
+TEST(CoroTest, Task)
+{
+    int result = 0;
+    runSum(10, &result).start();
+    EXPECT_EQ(45, result);
+
+    auto task = sum(3);
+    EXPECT_TRUE(task.valid());
+    EXPECT_FALSE(task.done());
+}
+
+TEST(CoroTest, Echo)
+{
+    EventLoop loop;
+    std::thread thread([&loop] {
+        if (loop.init()) {
+            loop.loop();
+        }
+    });
+    while (loop.sync([] {}) != KMError::NOERR) {
+        std::this_thread::yield();
+    }
+
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    std::unique_ptr<TcpSocket> sock;
+    std::unique_ptr<coro::TcpStream> stream;
+    std::unique_ptr<Timer> timer;
+    std::atomic<int> state{ 0 };
+    loop.sync([&] {
+        sock.reset(new TcpSocket(&loop));
+        stream.reset(new coro::TcpStream(*sock));
+        timer.reset(new Timer(&loop));
+        EXPECT_EQ(KMError::NOERR, sock->attachFd(fds[0]));
+        echo(stream.get(), timer.get(), &state).start();
+    });
+
+    for (int i = 1; i <= 3; ++i) {
+        std::string msg = "hello " + std::to_string(i);
+        ASSERT_EQ(int(msg.size()), write(fds[1], msg.c_str(), msg.size()));
+        char buf[64];
+        ASSERT_EQ(int(msg.size()), read(fds[1], buf, sizeof(buf)));
+        EXPECT_EQ(msg, std::string(buf, msg.size()));
+    }
+    ::close(fds[1]);
+    while (state != -1) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(-1, state.load());
+
+    loop.sync([&] {
+        stream.reset();
+        sock.reset();
+        timer.reset();
+    });
+    loop.stop();
+    thread.join();
+}
+
+TEST(CoroTest, HttpClient)
+{
+    uint16_t port = 0;
+    int lfd = listenLoopback(port);
+    ASSERT_GE(lfd, 0);
+    std::thread server([lfd] {
+        int fd = accept(lfd, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        std::string req;
+        char c = 0;
+        while (req.find("\r\n\r\n") == std::string::npos && read(fd, &c, 1) == 1) {
+            req += c;
+        }
+        std::string rsp = "HTTP/1.1 200 OK\r\n"
+                          "Content-Length: 5\r\n"
+                          "\r\n"
+                          "hello";
+        EXPECT_EQ(ssize_t(rsp.size()), write(fd, rsp.c_str(), rsp.size()));
+        ::close(fd);
+    });
+
+    EventLoop loop;
+    std::thread thread([&loop] {
+        if (loop.init()) {
+            loop.loop();
+        }
+    });
+    while (loop.sync([] {}) != KMError::NOERR) {
+        std::this_thread::yield();
+    }
+
+    std::unique_ptr<HttpRequest> request;
+    std::unique_ptr<coro::HttpClient> client;
+    std::string body;
+    KMError err = KMError::FAILED;
+    std::atomic<int> state{ 0 };
+    std::string url = "http://127.0.0.1:" + std::to_string(port) + "/coro";
+    loop.sync([&] {
+        request.reset(new HttpRequest(&loop));
+        request->setDataCallback([&body] (KMBuffer &buf) {
+            std::string str(buf.chainLength(), 0);
+            buf.readChained(&str[0], str.size());
+            body += str;
+        });
+        client.reset(new coro::HttpClient(*request));
+        fetch(client.get(), url.c_str(), &err, &state).start();
+    });
+    for (int i = 0; i < 3000 && state == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(1, state.load());
+    loop.sync([&] {
+        EXPECT_EQ(KMError::NOERR, err);
+        EXPECT_EQ(200, request->getStatusCode());
+        EXPECT_EQ("hello", body);
+        client.reset();
+        request.reset();
+    });
+    server.join();
+    ::close(lfd);
+
+    // the port is closed, it is resumed by the error callback
+    state = 0;
+    loop.sync([&] {
+        request.reset(new HttpRequest(&loop));
+        client.reset(new coro::HttpClient(*request));
+        fetch(client.get(), url.c_str(), &err, &state).start();
+    });
+    for (int i = 0; i < 3000 && state == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(1, state.load());
+    EXPECT_NE(KMError::NOERR, err);
+
+    loop.sync([&] {
+        client.reset();
+        request.reset();
+    });
+    loop.stop();
+    thread.join();
+}
+
+#endif // KUMA_HAS_COROUTINE
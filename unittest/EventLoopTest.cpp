@@ -0,0 +1,1270 @@
+
+#include <gtest/gtest.h>
+#include "kmapi.h"
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string.h>
+
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace kuma;
+
+namespace {
+    class EventLoopTest : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            thread_ = std::thread([this] {
+                if (loop_.init()) {
+                    loop_.loop();
+                }
+            });
+            while (loop_.sync([] {}) != KMError::NOERR) {
+                std::this_thread::yield();
+            }
+        }
+        void TearDown() override
+        {
+            loop_.stop();
+            thread_.join();
+        }
+
+        EventLoop loop_;
+        std::thread thread_;
+    };
+}
+
+TEST_F(EventLoopTest, PostBatch)
+{
+    std::vector<int> result;
+    std::vector<EventLoop::Task> tasks;
+    for (int i = 0; i < 100; ++i) {
+        tasks.emplace_back([&result, i] { result.push_back(i); });
+    }
+    EXPECT_EQ(KMError::NOERR, loop_.postBatch(tasks));
+    EXPECT_EQ(KMError::NOERR, loop_.postBatch(nullptr, 0));
+    loop_.sync([] {});
+    ASSERT_EQ(100, result.size());
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i, result[i]);
+    }
+}
+
+TEST_F(EventLoopTest, PostBatch_Cancel)
+{
+    std::atomic<int> count{ 0 };
+    auto token = loop_.createToken();
+    // block the loop so the batch stays queued
+    std::atomic<bool> blocked{ true };
+    loop_.post([&blocked] { while (blocked) std::this_thread::yield(); });
+
+    std::vector<EventLoop::Task> tasks;
+    for (int i = 0; i < 10; ++i) {
+        tasks.emplace_back([&count] { ++count; });
+    }
+    EXPECT_EQ(KMError::NOERR, loop_.postBatch(tasks, &token));
+    loop_.cancel(&token);
+    blocked = false;
+    loop_.sync([] {});
+    EXPECT_EQ(0, count.load());
+
+    EventLoop other;
+    auto other_token = other.createToken();
+    EXPECT_EQ(KMError::INVALID_PARAM, loop_.postBatch(tasks, &other_token));
+}
+
+TEST(EventLoopStopTest, Post_Racing_Stop)
+{
+    for (int round = 0; round < 20; ++round) {
+        EventLoop loop;
+        ASSERT_TRUE(loop.init());
+        std::atomic<int> accepted{ 0 };
+        std::atomic<int> executed{ 0 };
+        std::vector<std::thread> posters;
+        for (int i = 0; i < 4; ++i) {
+            posters.emplace_back([&] {
+                // the task accepted by loop is always run, and sync never hangs
+                while (true) {
+                    if (loop.post([&executed] { ++executed; }) != KMError::NOERR) {
+                        break;
+                    }
+                    ++accepted;
+                    if (loop.sync([&executed] { ++executed; }) != KMError::NOERR) {
+                        break;
+                    }
+                    ++accepted;
+                }
+            });
+        }
+        std::thread stopper([&loop] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            loop.stop();
+        });
+        loop.loop();
+        for (auto &t : posters) {
+            t.join();
+        }
+        stopper.join();
+        EXPECT_EQ(accepted.load(), executed.load());
+    }
+}
+
+TEST_F(EventLoopTest, Priority)
+{
+    std::vector<int> result;
+    std::atomic<bool> blocked{ true };
+    loop_.post([&blocked] { while (blocked) std::this_thread::yield(); });
+    loop_.post([&result] { result.push_back(3); }, nullptr, TaskPriority::IDLE);
+    loop_.post([&result] { result.push_back(2); });
+    loop_.post([&result] { result.push_back(1); }, nullptr, TaskPriority::URGENT);
+    blocked = false;
+    while (loop_.sync([] {}) == KMError::NOERR && result.size() < 3) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(3, result.size());
+    EXPECT_EQ(1, result[0]);
+    EXPECT_EQ(2, result[1]);
+    EXPECT_EQ(3, result[2]);
+}
+
+TEST_F(EventLoopTest, Idle_Task_Timer)
+{
+    // the idle task runs before the loop waits for the timer, the wait is shortened by it
+    std::atomic<bool> fired{ false };
+    Timer timer(&loop_);
+    auto start = std::chrono::steady_clock::now();
+    loop_.sync([&] { timer.schedule(50, [&fired] { fired = true; }); });
+    // it wakes up the loop that is waiting for the timer
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    loop_.post([] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    }, nullptr, TaskPriority::IDLE);
+    while (!fired) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 80);
+}
+
+TEST_F(EventLoopTest, Idle_Task_Schedule_Timer)
+{
+    // no timer is armed, the timer scheduled by idle task doesn't wake up the poll
+    std::atomic<bool> fired{ false };
+    Timer timer(&loop_);
+    // the loop is blocked in poll without timeout
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    auto start = std::chrono::steady_clock::now();
+    loop_.post([&] {
+        timer.schedule(1, [&fired] { fired = true; });
+    }, nullptr, TaskPriority::IDLE);
+    for (int i = 0; i < 1000 && !fired; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(fired.load());
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 50);
+}
+
+TEST_F(EventLoopTest, Task_Time_Budget)
+{
+    loop_.setTaskTimeBudget(5);
+    std::vector<int> result;
+    std::vector<EventLoop::Task> tasks;
+    for (int i = 0; i < 100; ++i) {
+        tasks.emplace_back([this, &result, i] {
+            if (i == 0) {
+                loop_.post([&result] { result.push_back(-1); }, nullptr, TaskPriority::URGENT);
+            }
+            result.push_back(i);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+    loop_.postBatch(tasks);
+    while (loop_.sync([] {}) == KMError::NOERR && result.size() < 101) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(101, result.size());
+    // the urgent task is not blocked by the whole batch
+    auto it = std::find(result.begin(), result.end(), -1);
+    EXPECT_LT(it - result.begin(), 50);
+}
+
+TEST_F(EventLoopTest, Timer_Cross_Thread)
+{
+    std::atomic<int> count{ 0 };
+    std::unique_ptr<Timer> timer(new Timer(&loop_));
+    EXPECT_TRUE(timer->schedule(1, [&count] { ++count; }, TimerMode::REPEATING));
+    while (count < 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // the callback is not running after cancel returns
+    timer->cancel();
+    int fired = count;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(fired, count.load());
+
+    // destroy a timer while its schedule task is still queued
+    std::atomic<bool> blocked{ true };
+    loop_.post([&blocked] { while (blocked) std::this_thread::yield(); });
+    timer->schedule(1, [&count] { ++count; });
+    std::thread thr([&blocked] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        blocked = false;
+    });
+    timer.reset();
+    thr.join();
+    loop_.sync([] {});
+    EXPECT_EQ(fired, count.load());
+}
+
+TEST(TimerTest, Destroy_After_Loop_Stop)
+{
+    EventLoop loop;
+    std::atomic<bool> blocked{ true };
+    std::thread thr([&loop] {
+        if (loop.init()) {
+            loop.loop();
+        }
+    });
+    while (loop.sync([] {}) != KMError::NOERR) {
+        std::this_thread::yield();
+    }
+    loop.post([&blocked] { while (blocked) std::this_thread::yield(); });
+    
+    // the schedule task is queued, and would be run when loop exits
+    std::atomic<int> count{ 0 };
+    std::unique_ptr<Timer> timer(new Timer(&loop));
+    EXPECT_TRUE(timer->schedule(1, [&count] { ++count; }));
+    std::unique_ptr<Timer> timer_us(new Timer(&loop));
+    EXPECT_TRUE(timer_us->scheduleUs(100, [&count] { ++count; }));
+    loop.stop();
+    timer.reset();
+    timer_us.reset();
+    blocked = false;
+    thr.join();
+    EXPECT_EQ(0, count.load());
+}
+
+TEST_F(EventLoopTest, Timer_High_Resolution)
+{
+    EXPECT_EQ(KMError::NOERR, loop_.enableHighResTimer());
+    std::atomic<int> count{ 0 };
+    Timer timer(&loop_);
+    // 50 ms of 250 us period, it is at most 50 if rounded up to milliseconds
+    EXPECT_TRUE(timer.scheduleUs(250, [&count] { ++count; }, TimerMode::REPEATING));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    timer.cancel();
+    EXPECT_GT(count.load(), 80);
+    
+    std::atomic<bool> fired{ false };
+    Timer coarse_timer(&loop_);
+    EXPECT_TRUE(coarse_timer.schedule(1, [&fired] { fired = true; }));
+    while (!fired) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST_F(EventLoopTest, Busy_Poll)
+{
+    // spin long enough that the task below arrives while the loop is spinning
+    loop_.setBusyPoll(200*1000);
+    loop_.sync([] {});
+    auto spin_hits = loop_.getSpinHitCount();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::atomic<bool> done{ false };
+    loop_.post([&done] { done = true; });
+    while (!done) {
+        std::this_thread::yield();
+    }
+    EXPECT_GT(loop_.getSpinHitCount(), spin_hits);
+    
+    loop_.setBusyPoll(0);
+    loop_.sync([] {});
+    auto blocking_waits = loop_.getBlockingWaitCount();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    loop_.sync([] {});
+    EXPECT_GT(loop_.getBlockingWaitCount(), blocking_waits);
+}
+
+TEST_F(EventLoopTest, Notify_Coalesce)
+{
+    loop_.sync([] {});
+    auto before = loop_.getStats();
+    // the loop is awake while running the first task, the posts don't notify poll
+    std::atomic<bool> blocked{ true };
+    loop_.post([&blocked] { while (blocked) std::this_thread::yield(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    for (int i = 0; i < 100; ++i) {
+        loop_.post([] {});
+    }
+    blocked = false;
+    loop_.sync([] {});
+    auto after = loop_.getStats();
+    EXPECT_GE(after.notifies_suppressed - before.notifies_suppressed, 100);
+    EXPECT_LE(after.notifies - before.notifies, 3);
+}
+
+TEST_F(EventLoopTest, Stats)
+{
+    loop_.sync([] {});
+    auto before = loop_.getStats();
+    
+    // the tasks are queued while the first one is running
+    std::atomic<bool> blocked{ true };
+    loop_.post([&blocked] {
+        while (blocked) std::this_thread::yield();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    });
+    for (int i = 0; i < 10; ++i) {
+        loop_.post([] {});
+    }
+    blocked = false;
+    
+    std::atomic<bool> fired{ false };
+    Timer timer(&loop_);
+    EXPECT_TRUE(timer.schedule(1, [&fired] { fired = true; }));
+    while (!fired) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    
+    int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ASSERT_GE(efd, 0);
+    std::atomic<bool> readable{ false };
+    EXPECT_EQ(KMError::NOERR, loop_.registerFd(efd, KUMA_EV_READ, [&readable] (KMEvent, void*, size_t) {
+        readable = true;
+    }));
+    uint64_t val = 1;
+    EXPECT_EQ(sizeof(val), write(efd, &val, sizeof(val)));
+    while (!readable) {
+        std::this_thread::yield();
+    }
+    loop_.sync([] {});
+    
+    auto after = loop_.getStats();
+    EXPECT_GT(after.iterations, before.iterations);
+    EXPECT_GE(after.tasks_executed - before.tasks_executed, 11u);
+    EXPECT_GE(after.max_pending_tasks, 10u);
+    EXPECT_GE(after.timers_fired - before.timers_fired, 1u);
+    EXPECT_GT(after.io_events, before.io_events);
+    EXPECT_GE(after.task_us - before.task_us, 5000u);
+    EXPECT_GE(after.max_callback_us, 5000u);
+    uint64_t waits = 0, callbacks = 0;
+    for (int i = 0; i < EventLoop::Stats::HISTOGRAM_BUCKETS; ++i) {
+        waits += after.events_per_wait[i];
+        callbacks += after.callback_us[i];
+    }
+    EXPECT_GT(waits, 0u);
+    // every task and I/O callback is counted in histogram
+    EXPECT_GT(callbacks, after.tasks_executed);
+    
+    loop_.unregisterFd(efd, true);
+}
+
+TEST_F(EventLoopTest, Watchdog)
+{
+    std::mutex mutex;
+    std::vector<std::string> reports;
+    setTraceFunc([&mutex, &reports] (int level, const char *msg) {
+        if (strstr(msg, "slow ")) {
+            std::lock_guard<std::mutex> g(mutex);
+            reports.emplace_back(msg);
+        }
+    });
+    EXPECT_EQ(KMError::NOERR, loop_.setWatchdog(10));
+    loop_.sync([] {});
+    loop_.post([] { std::this_thread::sleep_for(std::chrono::milliseconds(50)); });
+    
+    int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ASSERT_GE(efd, 0);
+    EXPECT_EQ(KMError::NOERR, loop_.registerFd(efd, KUMA_EV_READ, [] (KMEvent, void*, size_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }));
+    uint64_t val = 1;
+    EXPECT_EQ(sizeof(val), write(efd, &val, sizeof(val)));
+    loop_.sync([] {});
+    // the fast callbacks are not reported
+    for (int i = 0; i < 100; ++i) {
+        loop_.sync([] {});
+    }
+    loop_.unregisterFd(efd, true);
+    EXPECT_EQ(KMError::NOERR, loop_.setWatchdog(0));
+    loop_.sync([] {});
+    setTraceFunc(nullptr);
+    
+    ASSERT_EQ(2u, reports.size());
+    EXPECT_NE(std::string::npos, reports[0].find("slow task callback"));
+    EXPECT_NE(std::string::npos, reports[1].find("slow I/O callback, obj_id="));
+}
+
+TEST_F(EventLoopTest, ThreadPool_Offload)
+{
+    ThreadPool pool;
+    EXPECT_EQ(KMError::INVALID_STATE, pool.offload(&loop_, [] {}, [] {}));
+    ASSERT_EQ(KMError::NOERR, pool.start(2));
+    EXPECT_EQ(2, pool.size());
+
+    std::thread::id loop_tid;
+    loop_.sync([&loop_tid] { loop_tid = std::this_thread::get_id(); });
+    std::thread::id work_tid, done_tid;
+    std::atomic<bool> done{ false };
+    EXPECT_EQ(KMError::NOERR, pool.offload(&loop_, [&work_tid] {
+        work_tid = std::this_thread::get_id();
+    }, [&done_tid, &done] {
+        done_tid = std::this_thread::get_id();
+        done = true;
+    }));
+    while (!done) {
+        std::this_thread::yield();
+    }
+    EXPECT_NE(loop_tid, work_tid);
+    EXPECT_EQ(loop_tid, done_tid);
+
+    // the continuation is dropped once the token is cancelled
+    auto token = loop_.createToken();
+    std::atomic<bool> started{ false };
+    std::atomic<bool> blocked{ true };
+    std::atomic<bool> worked{ false };
+    std::atomic<int> count{ 0 };
+    pool.offload(&loop_, [&started, &blocked, &worked] {
+        started = true;
+        while (blocked) std::this_thread::yield();
+        worked = true;
+    }, [&count] { ++count; }, &token);
+    while (!started) {
+        std::this_thread::yield();
+    }
+    loop_.cancel(&token);
+    blocked = false;
+    while (!worked) {
+        std::this_thread::yield();
+    }
+    // the work not started is skipped
+    worked = false;
+    blocked = true;
+    std::atomic<int> busy{ 0 };
+    for (int i = 0; i < 2; ++i) {
+        pool.post([&busy, &blocked] {
+            ++busy;
+            while (blocked) std::this_thread::yield();
+        });
+    }
+    while (busy < 2) {
+        std::this_thread::yield();
+    }
+    pool.offload(&loop_, [&worked] { worked = true; }, [&count] { ++count; }, &token);
+    loop_.cancel(&token);
+    blocked = false;
+    pool.stop();
+    loop_.sync([] {});
+    EXPECT_FALSE(worked);
+    EXPECT_EQ(0, count.load());
+}
+
+TEST(ThreadPoolTest, Post_Steal)
+{
+    ThreadPool pool;
+    ASSERT_EQ(KMError::NOERR, pool.start(4));
+    const int kTasks = 200;
+    std::atomic<int> count{ 0 };
+    // the tasks posted in worker thread are queued to that worker, the idle ones steal them
+    pool.post([&pool, &count] {
+        for (int i = 0; i < kTasks; ++i) {
+            pool.post([&count] {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                ++count;
+            });
+        }
+    });
+    while (count < kTasks) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_GT(pool.getStolenTaskCount(), 0u);
+    EXPECT_EQ(0, pool.getPendingTaskCount());
+    pool.stop();
+    EXPECT_EQ(0, pool.size());
+    EXPECT_EQ(KMError::INVALID_STATE, pool.post([] {}));
+}
+
+TEST(ThreadPoolTest, Post_Racing_Stop)
+{
+    for (int round = 0; round < 20; ++round) {
+        ThreadPool pool;
+        ASSERT_EQ(KMError::NOERR, pool.start(2));
+        std::atomic<bool> started{ false };
+        std::vector<std::thread> posters;
+        for (int i = 0; i < 4; ++i) {
+            posters.emplace_back([&] {
+                // post fails once the pool is stopped, it never touches the workers cleared
+                while (pool.post([] {}) == KMError::NOERR) {
+                    started = true;
+                }
+            });
+        }
+        while (!started) {
+            std::this_thread::yield();
+        }
+        pool.stop();
+        for (auto &t : posters) {
+            t.join();
+        }
+        EXPECT_EQ(0, pool.size());
+    }
+}
+
+TEST(EventLoopGroupTest, Select_Loop)
+{
+    EventLoopGroup group;
+    EXPECT_EQ(nullptr, group.selectLoop());
+    ASSERT_EQ(KMError::NOERR, group.start(3, true));
+    EXPECT_EQ(3, group.size());
+    EXPECT_EQ(KMError::INVALID_STATE, group.start(3));
+
+    // round robin
+    auto *first = group.selectLoop();
+    EXPECT_NE(first, group.selectLoop());
+    EXPECT_NE(first, group.selectLoop());
+    EXPECT_EQ(first, group.selectLoop());
+
+    // least pending tasks
+    std::atomic<bool> blocked{ true };
+    auto *busy = group.getLoop(1);
+    busy->post([&blocked] { while (blocked) std::this_thread::yield(); });
+    busy->post([] {});
+    while (group.getPendingTaskCount(1) != 1) {
+        std::this_thread::yield();
+    }
+    group.setPolicy(EventLoopGroup::Policy::LEAST_PENDING_TASKS);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_NE(busy, group.selectLoop());
+    }
+    blocked = false;
+    
+    // the timerfd of loop is not a connection
+    Timer timer(group.getLoop(0));
+    EXPECT_TRUE(timer.scheduleUs(500, [] {}));
+    group.getLoop(0)->sync([] {});
+    EXPECT_EQ(0, group.getConnectionCount(0));
+    timer.cancel();
+
+    auto select_cb = [] (EventLoopGroup *g) { return g->size() - 1; };
+    EXPECT_EQ(KMError::INVALID_STATE, group.setSelectCallback(select_cb));
+    group.stop();
+    EXPECT_EQ(0, group.size());
+    
+    EXPECT_EQ(KMError::NOERR, group.setSelectCallback(select_cb));
+    ASSERT_EQ(KMError::NOERR, group.start(3));
+    EXPECT_EQ(group.getLoop(2), group.selectLoop());
+    group.stop();
+}
+
+TEST(EventLoopGroupTest, Listener_Dispatch)
+{
+    EventLoopGroup group;
+    ASSERT_EQ(KMError::NOERR, group.start(2));
+    group.setPolicy(EventLoopGroup::Policy::LEAST_CONNECTIONS);
+
+    EventLoop loop;
+    ASSERT_TRUE(loop.init());
+    TcpListener listener(&loop);
+    std::atomic<int> accepted{ 0 };
+    std::atomic<bool> in_loop_thread{ true };
+    listener.setAcceptCallback(&group, [&] (EventLoop *l, SOCKET_FD fd, const char*, uint16_t) {
+        in_loop_thread = in_loop_thread && l->inSameThread();
+        ++accepted;
+        return false;
+    });
+    ASSERT_EQ(KMError::NOERR, listener.startListen("127.0.0.1", 52329));
+
+    TcpSocket client(&loop);
+    client.setWriteCallback([] (KMError) {});
+    client.setErrorCallback([] (KMError) {});
+    ASSERT_EQ(KMError::NOERR, client.connect("127.0.0.1", 52329, [] (KMError) {}));
+    for (int i = 0; i < 200 && accepted == 0; ++i) {
+        loop.loopOnce(10);
+    }
+    EXPECT_EQ(1, accepted.load());
+    EXPECT_TRUE(in_loop_thread.load());
+    client.close();
+    listener.close();
+    group.stop();
+}
+
+TEST(EventLoopGroupTest, Migrate_Socket)
+{
+    EventLoopGroup group;
+    ASSERT_EQ(KMError::NOERR, group.start(2));
+    auto *loop0 = group.getLoop(0);
+    auto *loop1 = group.getLoop(1);
+    std::thread::id thread1;
+    loop1->sync([&thread1] { thread1 = std::this_thread::get_id(); });
+    
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    std::unique_ptr<TcpSocket> sock(new TcpSocket(loop0));
+    std::mutex mutex;
+    std::string received;
+    std::thread::id read_thread;
+    auto *s = sock.get();
+    sock->setReadCallback([&, s] (KMError) {
+        char buf[64];
+        int ret = 0;
+        while ((ret = s->receive(buf, sizeof(buf))) > 0) {
+            std::lock_guard<std::mutex> g(mutex);
+            received.append(buf, ret);
+            read_thread = std::this_thread::get_id();
+            if (received == "a") {
+                // migrate in read callback, the rest data is read in loop1
+                EXPECT_EQ(KMError::NOERR, s->migrate(loop1));
+            }
+        }
+    });
+    sock->setWriteCallback([] (KMError) {});
+    sock->setErrorCallback([] (KMError) {});
+    loop0->sync([&] { EXPECT_EQ(KMError::NOERR, sock->attachFd(fds[0])); });
+    // not in loop thread
+    EXPECT_EQ(KMError::INVALID_STATE, sock->migrate(loop1));
+    
+    auto wait_for = [&] (const std::string &str) {
+        for (int i = 0; i < 1000; ++i) {
+            {
+                std::lock_guard<std::mutex> g(mutex);
+                if (received == str) {
+                    return true;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    };
+    EXPECT_EQ(1, write(fds[1], "a", 1));
+    ASSERT_TRUE(wait_for("a"));
+    EXPECT_EQ(1, write(fds[1], "b", 1));
+    ASSERT_TRUE(wait_for("ab"));
+    EXPECT_EQ(thread1, read_thread);
+    EXPECT_EQ(0, group.getConnectionCount(0));
+    EXPECT_EQ(1, group.getConnectionCount(1));
+    
+    // send in the thread of target loop
+    loop1->sync([&] { EXPECT_EQ(1, sock->send("c", 1)); });
+    char c = 0;
+    EXPECT_EQ(1, read(fds[1], &c, 1));
+    EXPECT_EQ('c', c);
+    
+    loop1->sync([&] { sock.reset(); });
+    EXPECT_EQ(0, group.getConnectionCount(1));
+    ::close(fds[1]);
+    group.stop();
+}
+
+namespace {
+    // the raw peer of migration tests reads in blocking mode
+    void setRecvTimeout(int fd)
+    {
+        timeval tv{ 3, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    bool readFully(int fd, std::string &str, size_t len)
+    {
+        char buf[16 * 1024];
+        while (str.size() < len) {
+            auto ret = read(fd, buf, std::min(sizeof(buf), len - str.size()));
+            if (ret <= 0) {
+                return false;
+            }
+            str.append(buf, ret);
+        }
+        return true;
+    }
+
+    bool readHttpHeader(int fd, std::string &str)
+    {
+        // byte by byte, the data following header is not consumed
+        while (str.size() < 4 || str.compare(str.size() - 4, 4, "\r\n\r\n") != 0) {
+            if (!readFully(fd, str, str.size() + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string h2Frame(uint8_t type, uint8_t flags, uint32_t stream_id, const std::string &payload)
+    {
+        std::string frame(9, 0);
+        frame[0] = char(payload.size() >> 16);
+        frame[1] = char(payload.size() >> 8);
+        frame[2] = char(payload.size());
+        frame[3] = char(type);
+        frame[4] = char(flags);
+        frame[5] = char(stream_id >> 24);
+        frame[6] = char(stream_id >> 16);
+        frame[7] = char(stream_id >> 8);
+        frame[8] = char(stream_id);
+        return frame + payload;
+    }
+
+    const uint8_t kH2Settings = 4;
+    const uint8_t kH2Ping = 6;
+
+    // returns after the ACK of PING with data is received
+    bool waitH2PingAck(int fd, const std::string &data)
+    {
+        while (true) {
+            std::string hdr;
+            if (!readFully(fd, hdr, 9)) {
+                return false;
+            }
+            size_t len = (uint8_t(hdr[0]) << 16) | (uint8_t(hdr[1]) << 8) | uint8_t(hdr[2]);
+            std::string payload;
+            if (!readFully(fd, payload, len)) {
+                return false;
+            }
+            if (uint8_t(hdr[3]) == kH2Ping && (hdr[4] & 0x1) && payload == data) {
+                return true;
+            }
+        }
+    }
+
+    // the h2c upgrade request is demuxed as server does, then it is attached
+    KMError attachH2Connection(H2Connection &conn, EventLoop *loop, SOCKET_FD fd)
+    {
+        std::string req = "GET / HTTP/1.1\r\n"
+                          "Host: localhost\r\n"
+                          "Connection: Upgrade, HTTP2-Settings\r\n"
+                          "Upgrade: h2c\r\n"
+                          "HTTP2-Settings: AAMAAABkAAQAAP__\r\n"
+                          "\r\n";
+        HttpParser parser;
+        parser.parse(req.c_str(), req.size());
+        TcpSocket tcp(loop);
+        auto ret = tcp.attachFd(fd);
+        if (ret != KMError::NOERR) {
+            return ret;
+        }
+        return conn.attachSocket(std::move(tcp), std::move(parser));
+    }
+
+    // the peer of upgraded connection, it is OPEN after the first PING is acked
+    bool openH2Connection(int fd)
+    {
+        std::string rsp;
+        if (!readHttpHeader(fd, rsp) || rsp.find("HTTP/1.1 101") != 0) {
+            return false;
+        }
+        std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+        preface += h2Frame(kH2Settings, 0, 0, "");
+        preface += h2Frame(kH2Ping, 0, 0, "ping0001");
+        if (write(fd, preface.c_str(), preface.size()) != ssize_t(preface.size())) {
+            return false;
+        }
+        return waitH2PingAck(fd, "ping0001");
+    }
+}
+
+TEST(EventLoopGroupTest, Migrate_WebSocket)
+{
+    EventLoopGroup group;
+    ASSERT_EQ(KMError::NOERR, group.start(2));
+    auto *loop0 = group.getLoop(0);
+    auto *loop1 = group.getLoop(1);
+    std::thread::id thread1;
+    loop1->sync([&thread1] { thread1 = std::this_thread::get_id(); });
+
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    // the message sent before migration is partly queued
+    int sndbuf = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    setRecvTimeout(fds[1]);
+
+    std::unique_ptr<WebSocket> ws(new WebSocket(loop0));
+    std::atomic<bool> opened{ false };
+    std::mutex mutex;
+    std::string received;
+    std::thread::id data_thread;
+    ws->setWriteCallback([&opened] (KMError) { opened = true; });
+    ws->setErrorCallback([] (KMError) {});
+    ws->setDataCallback([&] (KMBuffer &buf, bool, bool) {
+        std::string str(buf.chainLength(), 0);
+        buf.readChained(&str[0], str.size());
+        std::lock_guard<std::mutex> g(mutex);
+        received += str;
+        data_thread = std::this_thread::get_id();
+    });
+    loop0->sync([&] { EXPECT_EQ(KMError::NOERR, ws->attachFd(fds[0])); });
+
+    std::string req = "GET / HTTP/1.1\r\n"
+                      "Host: localhost\r\n"
+                      "Upgrade: websocket\r\n"
+                      "Connection: Upgrade\r\n"
+                      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                      "Sec-WebSocket-Version: 13\r\n"
+                      "\r\n";
+    ASSERT_EQ(ssize_t(req.size()), write(fds[1], req.c_str(), req.size()));
+    std::string rsp;
+    ASSERT_TRUE(readHttpHeader(fds[1], rsp));
+    EXPECT_EQ(0u, rsp.find("HTTP/1.1 101"));
+    for (int i = 0; i < 1000 && !opened; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(opened.load());
+
+    const size_t kMessageSize = 256 * 1024;
+    std::string message(kMessageSize, 0);
+    for (size_t i = 0; i < kMessageSize; ++i) {
+        message[i] = char(i % 251);
+    }
+    loop0->sync([&] {
+        EXPECT_EQ(int(kMessageSize), ws->send(message.c_str(), message.size(), false));
+        // the queued part of message is sent by loop1
+        EXPECT_EQ(KMError::NOERR, ws->migrate(loop1));
+    });
+    std::string frame;
+    ASSERT_TRUE(readFully(fds[1], frame, 10 + kMessageSize));
+    EXPECT_EQ(0x82, uint8_t(frame[0]));
+    EXPECT_EQ(127, uint8_t(frame[1]));
+    EXPECT_TRUE(frame.compare(10, kMessageSize, message) == 0);
+
+    // masked by zero key
+    std::string client_frame = { char(0x82), char(0x83), 0, 0, 0, 0, 'x', 'y', 'z' };
+    ASSERT_EQ(ssize_t(client_frame.size()), write(fds[1], client_frame.c_str(), client_frame.size()));
+    bool done = false;
+    for (int i = 0; i < 1000 && !done; ++i) {
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            done = received == "xyz";
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(done);
+    EXPECT_EQ(thread1, data_thread);
+    EXPECT_EQ(0, group.getConnectionCount(0));
+    EXPECT_EQ(1, group.getConnectionCount(1));
+
+    loop1->sync([&] { ws.reset(); });
+    EXPECT_EQ(0, group.getConnectionCount(1));
+    ::close(fds[1]);
+    group.stop();
+}
+
+TEST(EventLoopGroupTest, Migrate_H2Connection)
+{
+    EventLoopGroup group;
+    ASSERT_EQ(KMError::NOERR, group.start(2));
+    auto *loop0 = group.getLoop(0);
+    auto *loop1 = group.getLoop(1);
+
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    setRecvTimeout(fds[1]);
+    std::unique_ptr<H2Connection> conn(new H2Connection(loop0));
+    conn->setErrorCallback([] (int) {});
+    loop0->sync([&] { EXPECT_EQ(KMError::NOERR, attachH2Connection(*conn, loop0, fds[0])); });
+    ASSERT_TRUE(openH2Connection(fds[1]));
+
+    // an idle connection is moved
+    loop0->sync([&] { EXPECT_EQ(KMError::NOERR, conn->migrate(loop1)); });
+    auto ping = h2Frame(kH2Ping, 0, 0, "ping0002");
+    ASSERT_EQ(ssize_t(ping.size()), write(fds[1], ping.c_str(), ping.size()));
+    EXPECT_TRUE(waitH2PingAck(fds[1], "ping0002"));
+    EXPECT_EQ(0, group.getConnectionCount(0));
+    EXPECT_EQ(1, group.getConnectionCount(1));
+
+    loop1->sync([&] { conn.reset(); });
+    EXPECT_EQ(0, group.getConnectionCount(1));
+    ::close(fds[1]);
+    group.stop();
+}
+
+TEST(EventLoopGroupTest, Migrate_H2Connection_With_Streams)
+{
+    EventLoopGroup group;
+    ASSERT_EQ(KMError::NOERR, group.start(2));
+    auto *loop0 = group.getLoop(0);
+    auto *loop1 = group.getLoop(1);
+
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    setRecvTimeout(fds[1]);
+    std::unique_ptr<H2Connection> conn(new H2Connection(loop0));
+    std::atomic<uint32_t> accepted{ 0 };
+    conn->setAcceptCallback([&accepted] (uint32_t stream_id) {
+        accepted = stream_id;
+        return true;
+    });
+    conn->setErrorCallback([] (int) {});
+    loop0->sync([&] { EXPECT_EQ(KMError::NOERR, attachH2Connection(*conn, loop0, fds[0])); });
+    ASSERT_TRUE(openH2Connection(fds[1]));
+
+    // GET / on stream 1 by indexed headers, the stream is left open
+    std::string block = { char(0x82), char(0x86), char(0x84) };
+    auto headers = h2Frame(1/*HEADERS*/, 0x4/*END_HEADERS*/, 1, block);
+    ASSERT_EQ(ssize_t(headers.size()), write(fds[1], headers.c_str(), headers.size()));
+    for (int i = 0; i < 1000 && accepted == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(1u, accepted.load());
+
+    // the streams are bound to current loop
+    loop0->sync([&] { EXPECT_EQ(KMError::INVALID_STATE, conn->migrate(loop1)); });
+    auto ping = h2Frame(kH2Ping, 0, 0, "ping0002");
+    ASSERT_EQ(ssize_t(ping.size()), write(fds[1], ping.c_str(), ping.size()));
+    EXPECT_TRUE(waitH2PingAck(fds[1], "ping0002"));
+    EXPECT_EQ(1, group.getConnectionCount(0));
+    EXPECT_EQ(0, group.getConnectionCount(1));
+
+    loop0->sync([&] { conn.reset(); });
+    ::close(fds[1]);
+    group.stop();
+}
+
+TEST(TcpSocketTest, Cork)
+{
+    EventLoop loop;
+    ASSERT_TRUE(loop.init());
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    TcpSocket sock(&loop);
+    sock.setWriteCallback([] (KMError) {});
+    sock.setErrorCallback([] (KMError) {});
+    ASSERT_EQ(KMError::NOERR, sock.attachFd(fds[0]));
+    EXPECT_EQ(KMError::NOERR, sock.setCork(true));
+    EXPECT_TRUE(sock.getCork());
+    
+    char b = 'b', c = 'c';
+    iovec iovs[2];
+    iovs[0].iov_base = &b;
+    iovs[0].iov_len = 1;
+    iovs[1].iov_base = &c;
+    iovs[1].iov_len = 1;
+    EXPECT_EQ(1, sock.send("a", 1));
+    EXPECT_EQ(2, sock.send(iovs, 2));
+    // nothing is written before the loop flushes
+    char buf[16];
+    EXPECT_EQ(-1, recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT));
+    loop.loopOnce(0);
+    ASSERT_EQ(3, recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT));
+    EXPECT_EQ(0, memcmp(buf, "abc", 3));
+    
+    // the corked data is written out when cork mode is disabled
+    EXPECT_EQ(1, sock.send("d", 1));
+    EXPECT_EQ(KMError::NOERR, sock.setCork(false));
+    ASSERT_EQ(1, recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT));
+    EXPECT_EQ('d', buf[0]);
+    
+    sock.close();
+    ::close(fds[1]);
+}
+
+TEST(TcpSocketTest, SendFile)
+{
+    EventLoop loop;
+    ASSERT_TRUE(loop.init());
+    char path[] = "/tmp/kuma_sendfile_XXXXXX";
+    int file_fd = mkstemp(path);
+    ASSERT_GE(file_fd, 0);
+    unlink(path);
+    std::string content(10000, 'a');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = char('a' + i % 26);
+    }
+    ASSERT_EQ(int(content.size()), write(file_fd, content.data(), content.size()));
+    
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    TcpSocket sock(&loop);
+    sock.setWriteCallback([] (KMError) {});
+    sock.setErrorCallback([] (KMError) {});
+    ASSERT_EQ(KMError::NOERR, sock.attachFd(fds[0]));
+    // the corked data is sent ahead of the file
+    sock.setCork(true);
+    EXPECT_EQ(1, sock.send("<", 1));
+    EXPECT_EQ(5000, sock.sendFile(file_fd, 100, 5000));
+    char buf[8192];
+    ASSERT_EQ(5001, recv(fds[1], buf, sizeof(buf), MSG_WAITALL | MSG_DONTWAIT));
+    EXPECT_EQ('<', buf[0]);
+    EXPECT_EQ(0, memcmp(buf + 1, content.data() + 100, 5000));
+    
+    // the range out of file
+    EXPECT_EQ(-1, sock.sendFile(file_fd, 9000, 2000));
+    
+    ::close(fds[1]);
+    ::close(file_fd);
+}
+
+TEST(EventLoopGroupTest, Listener_ReusePort)
+{
+    EventLoopGroup group;
+    ASSERT_EQ(KMError::NOERR, group.start(2));
+
+    EventLoop loop;
+    ASSERT_TRUE(loop.init());
+    TcpListener listener(&loop);
+    std::atomic<int> accepted{ 0 };
+    std::atomic<bool> in_loop_thread{ true };
+    listener.setAcceptCallback(&group, [&] (EventLoop *l, SOCKET_FD fd, const char*, uint16_t) {
+        in_loop_thread = in_loop_thread && l->inSameThread();
+        ++accepted;
+        return false;
+    });
+    listener.setBacklog(1024);
+    ASSERT_EQ(KMError::NOERR, listener.startListen("127.0.0.1", 52330, LISTEN_FLAG_REUSEPORT|LISTEN_FLAG_CPU_STEERING));
+
+    const int kClients = 8;
+    std::vector<std::unique_ptr<TcpSocket>> clients;
+    for (int i = 0; i < kClients; ++i) {
+        clients.emplace_back(new TcpSocket(&loop));
+        ASSERT_EQ(KMError::NOERR, clients.back()->connect("127.0.0.1", 52330, [] (KMError) {}));
+    }
+    for (int i = 0; i < 200 && accepted < kClients; ++i) {
+        loop.loopOnce(10);
+    }
+    EXPECT_EQ(kClients, accepted.load());
+    EXPECT_TRUE(in_loop_thread.load());
+    for (auto &c : clients) {
+        c->close();
+    }
+    listener.close();
+    group.stop();
+}
+
+TEST(IOPollTest, IoUring_Echo)
+{
+    // falls back to the default poll if io_uring is not supported
+    EventLoop loop(PollType::IO_URING);
+    ASSERT_TRUE(loop.init());
+
+    TcpListener listener(&loop);
+    std::unique_ptr<TcpSocket> server;
+    listener.setAcceptCallback([&] (SOCKET_FD fd, const char*, uint16_t) {
+        server.reset(new TcpSocket(&loop));
+        server->setReadCallback([&] (KMError) {
+            char buf[256];
+            int ret = 0;
+            while ((ret = server->receive(buf, sizeof(buf))) > 0) {
+                server->send(buf, ret);
+            }
+        });
+        server->setErrorCallback([] (KMError) {});
+        return server->attachFd(fd) == KMError::NOERR;
+    });
+    ASSERT_EQ(KMError::NOERR, listener.startListen("127.0.0.1", 52332));
+
+    const std::string msg(10000, 'k');
+    std::string echo;
+    TcpSocket client(&loop);
+    client.setReadCallback([&] (KMError) {
+        char buf[256];
+        int ret = 0;
+        while ((ret = client.receive(buf, sizeof(buf))) > 0) {
+            echo.append(buf, ret);
+        }
+    });
+    client.setErrorCallback([] (KMError) {});
+    ASSERT_EQ(KMError::NOERR, client.connect("127.0.0.1", 52332, [&] (KMError err) {
+        if (err == KMError::NOERR) {
+            client.send(msg.c_str(), msg.size());
+        }
+    }));
+    for (int i = 0; i < 200 && echo.size() < msg.size(); ++i) {
+        loop.loopOnce(10);
+    }
+    EXPECT_EQ(msg, echo);
+    client.close();
+    if (server) {
+        server->close();
+    }
+    listener.close();
+}
+
+TEST(IOPollTest, IoUring_Resume_Destroy)
+{
+    EventLoop loop(PollType::IO_URING);
+    ASSERT_TRUE(loop.init());
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    int reads = 0;
+    std::unique_ptr<TcpSocket> sock(new TcpSocket(&loop));
+    sock->setReadCallback([&reads] (KMError) { ++reads; });
+    sock->setErrorCallback([] (KMError) {});
+    ASSERT_EQ(KMError::NOERR, sock->attachFd(fds[0]));
+    EXPECT_EQ(KMError::NOERR, sock->pause());
+    EXPECT_EQ(1, write(fds[1], "a", 1));
+    for (int i = 0; i < 10; ++i) {
+        loop.loopOnce(1);
+    }
+    EXPECT_EQ(0, reads);
+    // resume posts the read notification, it is cancelled with the socket
+    EXPECT_EQ(KMError::NOERR, sock->resume());
+    sock.reset();
+    for (int i = 0; i < 10; ++i) {
+        loop.loopOnce(1);
+    }
+    EXPECT_EQ(0, reads);
+    ::close(fds[1]);
+}
+
+TEST(IOPollTest, IoUring_Buffer_Ring)
+{
+    EventLoop loop(PollType::IO_URING);
+    ASSERT_TRUE(loop.init());
+
+    // the received buffers are held until the end, more than the buffer ring has
+    const int kRounds = 300;
+    std::vector<KMBuffer> held;
+    size_t bytes_held = 0;
+    TcpListener listener(&loop);
+    std::unique_ptr<TcpSocket> server;
+    listener.setAcceptCallback([&] (SOCKET_FD fd, const char*, uint16_t) {
+        server.reset(new TcpSocket(&loop));
+        server->setReadCallback([&] (KMError) {
+            KMBuffer buf;
+            while (server->receive(buf) > 0) {
+                bytes_held += buf.chainLength();
+                server->send(buf);
+                held.push_back(std::move(buf));
+            }
+        });
+        server->setErrorCallback([] (KMError) {});
+        return server->attachFd(fd) == KMError::NOERR;
+    });
+    ASSERT_EQ(KMError::NOERR, listener.startListen("127.0.0.1", 52333));
+
+    int rounds = 0;
+    TcpSocket client(&loop);
+    client.setReadCallback([&] (KMError) {
+        char c;
+        while (client.receive(&c, 1) > 0) {
+            if (++rounds < kRounds) {
+                client.send("k", 1);
+            }
+        }
+    });
+    client.setErrorCallback([] (KMError) {});
+    ASSERT_EQ(KMError::NOERR, client.connect("127.0.0.1", 52333, [&] (KMError err) {
+        if (err == KMError::NOERR) {
+            client.send("k", 1);
+        }
+    }));
+    for (int i = 0; i < 3000 && rounds < kRounds; ++i) {
+        loop.loopOnce(10);
+    }
+    EXPECT_EQ(kRounds, rounds);
+    EXPECT_EQ(size_t(kRounds), bytes_held);
+    held.clear();
+    client.close();
+    if (server) {
+        server->close();
+    }
+    listener.close();
+}
+
+TEST(IOPollTest, IoUring_Release_Other_Thread)
+{
+    EventLoop loop(PollType::IO_URING);
+    ASSERT_TRUE(loop.init());
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    KMBuffer held;
+    TcpSocket sock(&loop);
+    sock.setReadCallback([&] (KMError) {
+        KMBuffer buf;
+        while (sock.receive(buf) > 0) {
+            held = std::move(buf);
+        }
+    });
+    sock.setErrorCallback([] (KMError) {});
+    ASSERT_EQ(KMError::NOERR, sock.attachFd(fds[0]));
+    // the data is handed over in the buffer of ring
+    const std::string msg(1000, 'k');
+    EXPECT_EQ(ssize_t(msg.size()), write(fds[1], msg.c_str(), msg.size()));
+    for (int i = 0; i < 100 && held.empty(); ++i) {
+        loop.loopOnce(10);
+    }
+    ASSERT_FALSE(held.empty());
+    for (int i = 0; i < 10; ++i) {
+        loop.loopOnce(1);
+    }
+    // the buffer released in other thread wakes up the loop
+    std::thread releaser([&held] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        held.reset();
+    });
+    auto start = std::chrono::steady_clock::now();
+    loop.loopOnce(3000);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    releaser.join();
+    EXPECT_LT(elapsed, std::chrono::milliseconds(1000));
+    sock.close();
+    ::close(fds[1]);
+}
+
+TEST(IOPollTest, EPoll_Direct_Item)
+{
+    // 2500 eventfds are opened, the soft limit is raised if it is too low
+    const rlim_t kFdCount = 2500 + 64;
+    rlimit old_limit;
+    ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &old_limit));
+    if (old_limit.rlim_cur != RLIM_INFINITY && old_limit.rlim_cur < kFdCount) {
+        if (old_limit.rlim_max != RLIM_INFINITY && old_limit.rlim_max < kFdCount) {
+            GTEST_SKIP() << "RLIMIT_NOFILE is too low, hard limit=" << old_limit.rlim_max;
+        }
+        rlimit new_limit = old_limit;
+        new_limit.rlim_cur = kFdCount;
+        ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &new_limit));
+    }
+
+    EventLoop loop(PollType::EPOLL);
+    ASSERT_EQ(KMError::NOERR, loop.setPollBatchSize(8));
+    ASSERT_EQ(KMError::NOERR, loop.enablePollDirectItem());
+    ASSERT_TRUE(loop.init());
+    EXPECT_EQ(KMError::INVALID_STATE, loop.enablePollDirectItem());
+
+    std::vector<SOCKET_FD> fds;
+    std::vector<bool> fd_fired;
+    size_t fired = 0;
+    std::function<void(size_t)> add_fds;
+    add_fds = [&] (size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            SOCKET_FD fd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+            ASSERT_NE(INVALID_FD, fd);
+            fds.push_back(fd);
+            if (fd_fired.size() <= (size_t)fd) {
+                fd_fired.resize(fd + 1);
+            }
+            loop.registerFd(fd, KUMA_EV_READ, [&, fd] (KMEvent ev, void*, size_t) {
+                // count each fd once, readiness may be reported more than once
+                if ((ev & KUMA_EV_READ) && !fd_fired[fd]) {
+                    fd_fired[fd] = true;
+                    ++fired;
+                }
+                if (fired == 1) {
+                    // add fds of new pages while dispatching a batch
+                    add_fds(2000);
+                }
+            });
+        }
+    };
+    add_fds(500);
+    for (int i = 0; i < 500 && fired < fds.size(); ++i) {
+        loop.loopOnce(10);
+    }
+    EXPECT_EQ(2500u, fds.size());
+    EXPECT_EQ(fds.size(), fired);
+    for (auto fd : fds) {
+        loop.unregisterFd(fd, true);
+    }
+    setrlimit(RLIMIT_NOFILE, &old_limit);
+}
@@ -2,6 +2,8 @@
 #include <gtest/gtest.h>
 #include "kmbuffer.h"
 
+#include <thread>
+
 using namespace kuma;
 
 TEST(KMBufferTest, allocBuffer)
@@ -267,3 +269,121 @@ TEST(KMBufferTest, Test_Unlink)
     EXPECT_FALSE(buf3.isChained());
     EXPECT_EQ(256, buf3.length());
 }
+
+TEST(KMBufferTest, Pool_Size_Class)
+{
+    // the class sizes have room for the shared header
+    const size_t H = KMBufferPool::HEADER_SIZE;
+    EXPECT_EQ(0, KMBufferPool::classIndex(1));
+    EXPECT_EQ(0, KMBufferPool::classIndex(256 + H));
+    EXPECT_EQ(1, KMBufferPool::classIndex(257 + H));
+    EXPECT_EQ(2, KMBufferPool::classIndex(512 + H));
+    EXPECT_EQ(3, KMBufferPool::classIndex(513 + H));
+    EXPECT_EQ(16, KMBufferPool::classIndex(64*1024 + H));
+    EXPECT_EQ(KMBufferPool::CLASS_COUNT, KMBufferPool::classIndex(64*1024 + H + 1));
+    for (size_t i = 0; i < KMBufferPool::CLASS_COUNT; ++i) {
+        auto size = KMBufferPool::classSize(i);
+        EXPECT_EQ(i, KMBufferPool::classIndex(size));
+        EXPECT_EQ(i + 1, KMBufferPool::classIndex(size + 1));
+    }
+    EXPECT_EQ(384 + H, KMBufferPool::classSize(1));
+    EXPECT_EQ(16*1024 + H, KMBufferPool::classSize(12));
+    EXPECT_EQ(24*1024 + H, KMBufferPool::classSize(13));
+}
+
+TEST(KMBufferTest, Pool_Reuse)
+{
+    // the storage of a freed buffer is reused by the next one of same size class
+    void *data = nullptr;
+    {
+        KMBuffer buf(16*1024 + 100);
+        data = buf.writePtr();
+    }
+    {
+        KMBuffer buf(16*1024 + 1000);
+        EXPECT_EQ(data, buf.writePtr());
+    }
+    
+    // the power of two sizes are not moved up to next class
+    {
+        KMBuffer buf(4096);
+        data = buf.writePtr();
+    }
+    {
+        KMBuffer buf(3500);
+        EXPECT_EQ(data, buf.writePtr());
+    }
+    {
+        KMBuffer buf(64*1024);
+        data = buf.writePtr();
+    }
+    {
+        KMBuffer buf(60*1024);
+        EXPECT_EQ(data, buf.writePtr());
+    }
+    
+    auto limit = KMBufferPool::getCacheLimit();
+    KMBufferPool::setCacheLimit(0);
+    auto *p1 = KMBufferPool::allocate(1000);
+    KMBufferPool::deallocate(p1, 1000);
+    KMBufferPool::setCacheLimit(limit);
+    auto *p2 = KMBufferPool::allocate(1000);
+    KMBufferPool::deallocate(p2, 1000);
+    auto *p3 = KMBufferPool::allocate(1000);
+    EXPECT_EQ(p2, p3);
+    KMBufferPool::deallocate(p3, 1000);
+    
+    // freed in other thread
+    KMBuffer *buf = new KMBuffer(3000);
+    std::thread([buf] { buf->destroy(); }).join();
+}
+
+TEST(KMBufferTest, Shared_Rewind)
+{
+    KMBuffer buf(1024);
+    EXPECT_EQ(1024, buf.capacity());
+    EXPECT_FALSE(buf.isShared());
+    buf.bytesWritten(100);
+    {
+        KMBuffer::Ptr sub(buf.subbuffer(10, 20));
+        EXPECT_TRUE(buf.isShared());
+        EXPECT_EQ(buf.readPtr() + 10, sub->readPtr());
+    }
+    EXPECT_FALSE(buf.isShared());
+    buf.bytesRead(50);
+    buf.rewind();
+    EXPECT_EQ(0, buf.length());
+    EXPECT_EQ(1024, buf.space());
+    
+    char data[16];
+    KMBuffer buf2(data, sizeof(data), sizeof(data));
+    EXPECT_FALSE(buf2.isShared());
+}
+
+TEST(KMBufferTest, FillIov_Batch)
+{
+    KMBuffer::Ptr buf(new KMBuffer(16));
+    buf->bytesWritten(16);
+    for (int i = 0; i < 4; ++i) {
+        auto *kmb = new KMBuffer(i == 1 ? 0 : 16);
+        kmb->bytesWritten(16);
+        buf->append(kmb);
+    }
+    iovec iovs[2];
+    const KMBuffer *pos = buf.get();
+    EXPECT_EQ(2, buf->fillIov(iovs, 2, pos));
+    EXPECT_NE(nullptr, pos);
+    EXPECT_EQ(16, iovs[1].iov_len);
+    // the empty buffer is skipped
+    EXPECT_EQ(2, buf->fillIov(iovs, 2, pos));
+    EXPECT_EQ(nullptr, pos);
+    
+    buf->bytesRead(40);
+    auto *head = buf.release()->popFront();
+    ASSERT_NE(nullptr, head);
+    buf.reset(head);
+    EXPECT_EQ(8, buf->length());
+    EXPECT_EQ(24, buf->chainLength());
+    buf->bytesRead(24);
+    EXPECT_EQ(nullptr, buf.release()->popFront());
+}
@@ -0,0 +1,86 @@
+
+#include <gtest/gtest.h>
+#include "kmtask.h"
+
+#include <memory>
+#include <functional>
+
+using namespace kuma;
+
+TEST(KMTaskTest, Empty)
+{
+    KMTask t;
+    EXPECT_FALSE(t);
+    KMTask t2(nullptr);
+    EXPECT_FALSE(t2);
+    std::function<void(void)> f;
+    KMTask t3(f);
+    EXPECT_FALSE(t3);
+    void (*fp)() = nullptr;
+    KMTask t4(fp);
+    EXPECT_FALSE(t4);
+    EXPECT_THROW(t4(), std::bad_function_call);
+    
+    // only the callables of void(void) are accepted
+    EXPECT_TRUE((std::is_constructible<KMTask, void(*)()>::value));
+    EXPECT_FALSE((std::is_constructible<KMTask, int>::value));
+    EXPECT_FALSE((std::is_constructible<KMTask, void(*)(int)>::value));
+    EXPECT_FALSE((std::is_constructible<KMTask, const KMTask&>::value));
+    EXPECT_FALSE((std::is_assignable<KMTask&, int>::value));
+}
+
+TEST(KMTaskTest, Inline)
+{
+    int count = 0;
+    KMTask t([&count] { ++count; });
+    EXPECT_TRUE(t);
+    EXPECT_TRUE(t.isInline());
+    t();
+    EXPECT_EQ(1, count);
+
+    KMTask t2(std::move(t));
+    EXPECT_FALSE(t);
+    EXPECT_TRUE(t2.isInline());
+    t2();
+    EXPECT_EQ(2, count);
+
+    t2 = nullptr;
+    EXPECT_FALSE(t2);
+}
+
+TEST(KMTaskTest, Heap)
+{
+    auto ptr = std::make_shared<int>(0);
+    char big[KMTask::INLINE_SIZE] = { 0 };
+    KMTask t([ptr, big] { *ptr += 1 + big[0]; });
+    EXPECT_FALSE(t.isInline());
+    t();
+    EXPECT_EQ(1, *ptr);
+
+    KMTask t2;
+    t2 = std::move(t);
+    EXPECT_FALSE(t);
+    t2();
+    EXPECT_EQ(2, *ptr);
+    EXPECT_EQ(2, ptr.use_count());
+    t2.reset();
+    EXPECT_EQ(1, ptr.use_count());
+}
+
+TEST(KMTaskTest, Move_Only)
+{
+    std::unique_ptr<int> up(new int(5));
+    int *raw = up.get();
+    int result = 0;
+    struct Fn {
+        std::unique_ptr<int> p;
+        int *result;
+        void operator()() { *result = *p; }
+    };
+    KMTask t(Fn{ std::move(up), &result });
+    EXPECT_TRUE(t.isInline());
+    KMTask t2(std::move(t));
+    t2();
+    EXPECT_EQ(5, result);
+    EXPECT_EQ(5, *raw);
+}
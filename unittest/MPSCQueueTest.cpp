@@ -0,0 +1,138 @@
+
+#include <gtest/gtest.h>
+#include "util/kmqueue.h"
+
+#include <thread>
+#include <vector>
+
+using namespace kuma;
+
+namespace {
+    struct TestNode
+    {
+        int producer = -1;
+        int seq = 0;
+        std::atomic<TestNode*> mpsc_next_{ nullptr };
+        uint32_t pool_index_ = 0;
+        std::atomic<uint32_t> pool_next_{ 0 };
+    };
+}
+
+TEST(MPSCQueueTest, FIFO)
+{
+    MPSCQueue<TestNode> q;
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(nullptr, q.dequeue());
+
+    TestNode nodes[16];
+    for (int i = 0; i < 16; ++i) {
+        nodes[i].seq = i;
+        q.enqueue(&nodes[i]);
+    }
+    EXPECT_FALSE(q.empty());
+    for (int i = 0; i < 16; ++i) {
+        auto *n = q.dequeue();
+        ASSERT_NE(nullptr, n);
+        EXPECT_EQ(i, n->seq);
+    }
+    EXPECT_EQ(nullptr, q.dequeue());
+    EXPECT_TRUE(q.empty());
+
+    // reuse the nodes after dequeued
+    q.enqueue(&nodes[3]);
+    q.enqueue(&nodes[1]);
+    EXPECT_EQ(&nodes[3], q.dequeue());
+    EXPECT_EQ(&nodes[1], q.dequeue());
+    EXPECT_EQ(nullptr, q.dequeue());
+}
+
+TEST(MPSCQueueTest, Enqueue_List)
+{
+    MPSCQueue<TestNode> q;
+    TestNode nodes[4];
+    for (int i = 0; i < 4; ++i) {
+        nodes[i].seq = i;
+    }
+    q.enqueue(&nodes[0]);
+    nodes[1].mpsc_next_ = &nodes[2];
+    q.enqueue(&nodes[1], &nodes[2]);
+    q.enqueue(&nodes[3]);
+    for (int i = 0; i < 4; ++i) {
+        auto *n = q.dequeue();
+        ASSERT_NE(nullptr, n);
+        EXPECT_EQ(i, n->seq);
+    }
+    EXPECT_EQ(nullptr, q.dequeue());
+}
+
+TEST(MPSCQueueTest, Multi_Producer)
+{
+    const int kProducers = 4;
+    const int kCount = 100000;
+    MPSCQueue<TestNode> q;
+    NodePool<TestNode> pool;
+    std::atomic<int> done{ 0 };
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < kCount; ++i) {
+                auto *n = pool.acquire();
+                n->producer = p;
+                n->seq = i;
+                q.enqueue(n);
+            }
+            ++done;
+        });
+    }
+
+    int next_seq[kProducers] = { 0 };
+    int total = 0;
+    while (total < kProducers * kCount) {
+        auto *n = q.dequeue();
+        if (!n) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_GE(n->producer, 0);
+        ASSERT_LT(n->producer, kProducers);
+        EXPECT_EQ(next_seq[n->producer], n->seq); // FIFO per producer
+        next_seq[n->producer] = n->seq + 1;
+        pool.release(n);
+        ++total;
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    EXPECT_EQ(kProducers, done.load());
+    EXPECT_EQ(nullptr, q.dequeue());
+}
+
+TEST(NodePoolTest, Reuse_Nodes)
+{
+    NodePool<TestNode, 4, 2> pool;
+    EXPECT_EQ(0, pool.capacity());
+
+    std::vector<TestNode*> nodes;
+    for (int i = 0; i < 8; ++i) {
+        auto *n = pool.acquire();
+        ASSERT_NE(nullptr, n);
+        EXPECT_NE(NodePool<TestNode>::kInvalidIndex, n->pool_index_);
+        nodes.push_back(n);
+    }
+    EXPECT_EQ(8, pool.capacity());
+
+    // over capacity, node is allocated from heap
+    auto *extra = pool.acquire();
+    EXPECT_EQ(NodePool<TestNode>::kInvalidIndex, extra->pool_index_);
+    pool.release(extra);
+
+    for (auto *n : nodes) {
+        pool.release(n);
+    }
+    for (int i = 0; i < 8; ++i) {
+        auto *n = pool.acquire();
+        EXPECT_NE(NodePool<TestNode>::kInvalidIndex, n->pool_index_);
+    }
+    EXPECT_EQ(8, pool.capacity());
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include "poll/IOPoll.h"
+
+using namespace kuma;
+
+TEST(PollItemTableTest, Add_Remove)
+{
+    PollItemTable table;
+    EXPECT_EQ(nullptr, table.find(3));
+    EXPECT_EQ(nullptr, table.find(-1));
+
+    auto &item = table.add(3);
+    EXPECT_EQ(3, item.fd);
+    EXPECT_EQ(&item, table.find(3));
+    EXPECT_EQ(&item, &table.add(3));
+    EXPECT_EQ(1u, table.count());
+    EXPECT_EQ(nullptr, table.find(4));
+
+    // the address is stable when other pages are added
+    auto &high = table.add(100000);
+    EXPECT_EQ(&item, table.find(3));
+    EXPECT_EQ(&high, table.find(100000));
+    EXPECT_EQ(2u, table.count());
+
+    table.remove(3);
+    EXPECT_EQ(nullptr, table.find(3));
+    EXPECT_EQ(1u, table.count());
+    table.remove(3);
+    EXPECT_EQ(1u, table.count());
+}
+
+TEST(PollItemTableTest, Shrink)
+{
+    PollItemTable table;
+    table.add(10);
+    auto base_usage = table.memoryUsage();
+    table.add(1000000);
+    auto high_usage = table.memoryUsage();
+    // one more page and the page pointers, rather than an item per fd up to the max fd
+    EXPECT_LT(high_usage, 2 * base_usage + 64 * 1024);
+    EXPECT_LT(high_usage, 1000000 * sizeof(PollItem) / 100);
+
+    table.remove(1000000);
+    // the empty page is kept until shrink
+    EXPECT_EQ(high_usage, table.memoryUsage());
+    table.shrink();
+    EXPECT_NE(nullptr, table.find(10));
+    EXPECT_EQ(nullptr, table.find(1000000));
+    EXPECT_GT(high_usage, table.memoryUsage());
+}
@@ -0,0 +1,177 @@
+
+#include <gtest/gtest.h>
+#include "TcpConnection.h"
+#include "EventLoopImpl.h"
+
+#include <string>
+#include <vector>
+#include <new>
+#include <stdlib.h>
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace kuma;
+
+// the heap allocations of each thread, to check the blocks are taken from KMBufferPool
+static thread_local size_t t_heap_allocs = 0;
+
+void* operator new(size_t size)
+{
+    ++t_heap_allocs;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace {
+class TestConnection : public TcpConnection
+{
+public:
+    using TcpConnection::TcpConnection;
+
+    size_t queuedBytes() const { return send_buffer_len_; }
+
+    int write_count = 0;
+    size_t queued_on_write = 0;
+
+protected:
+    KMError handleInputData(uint8_t *, size_t) override { return KMError::NOERR; }
+    void onWrite() override
+    {
+        ++write_count;
+        queued_on_write = send_buffer_len_;
+    }
+    void onError(KMError) override {}
+};
+
+// keeps the read block of last read, like a handler that references a partial message
+class KeepConnection : public TcpConnection
+{
+public:
+    using TcpConnection::TcpConnection;
+
+    KMBuffer kept;
+    std::vector<const void*> read_ptrs;
+
+protected:
+    KMError handleInputData(uint8_t *, size_t) override { return KMError::NOERR; }
+    KMError handleInputData(KMBuffer &buf) override
+    {
+        read_ptrs.push_back(buf.readPtr());
+        kept = buf;
+        return KMError::NOERR;
+    }
+    void onWrite() override {}
+    void onError(KMError) override {}
+};
+}
+
+TEST(TcpConnectionTest, Send_Queue_Watermarks)
+{
+    EventLoop loop;
+    ASSERT_TRUE(loop.init());
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    // the peer does not read until the queue is full
+    int sndbuf = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+    const size_t kHigh = 64 * 1024;
+    const size_t kLow = 8 * 1024;
+    TestConnection conn(getEventLoopPtr(loop.pimpl()));
+    conn.setSendWatermarks(kHigh, kLow);
+    ASSERT_EQ(KMError::NOERR, conn.attachFd(fds[0], nullptr));
+
+    // each message is a buffer of queue, so a writev batch cannot cover the queue
+    const size_t kMessageSize = 16;
+    size_t total = 0;
+    bool queued = false;
+    while (true) {
+        KMBuffer msg(kMessageSize);
+        for (size_t i = 0; i < kMessageSize; ++i) {
+            uint8_t b = uint8_t((total + i) % 251);
+            msg.write(&b, 1);
+        }
+        int ret = conn.send(msg);
+        ASSERT_GE(ret, 0);
+        if (ret == 0) {
+            // send returns 0 only when the queue reaches high watermark
+            EXPECT_GE(conn.queuedBytes(), kHigh);
+            break;
+        }
+        // the data not accepted by socket is queued, the whole message is reported as sent
+        EXPECT_EQ(int(kMessageSize), ret);
+        total += kMessageSize;
+        queued = queued || conn.queuedBytes() > 0;
+    }
+    EXPECT_TRUE(queued);
+    EXPECT_GT(conn.queuedBytes() / kMessageSize, size_t(KM_IOV_MAX));
+    EXPECT_EQ(0, conn.write_count);
+
+    std::string received;
+    for (int i = 0; i < 1000 && received.size() < total; ++i) {
+        char buf[4096];
+        ssize_t n = 0;
+        while ((n = ::read(fds[1], buf, sizeof(buf))) > 0) {
+            received.append(buf, n);
+        }
+        loop.loopOnce(10);
+    }
+    ASSERT_EQ(total, received.size());
+    for (size_t i = 0; i < received.size(); ++i) {
+        if (uint8_t(received[i]) != uint8_t(i % 251)) {
+            FAIL() << "out of order at " << i;
+        }
+    }
+    // onWrite is called once the queue drops to low watermark
+    EXPECT_GT(conn.write_count, 0);
+    EXPECT_LE(conn.queued_on_write, kLow);
+    EXPECT_EQ(0u, conn.queuedBytes());
+    conn.close();
+    ::close(fds[1]);
+}
+
+TEST(TcpConnectionTest, Recv_Block_From_Pool)
+{
+    EventLoop loop;
+    ASSERT_TRUE(loop.init());
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+    KeepConnection conn(getEventLoopPtr(loop.pimpl()));
+    ASSERT_EQ(KMError::NOERR, conn.attachFd(fds[0], nullptr));
+    // the block kept by handler is replaced, the replaced one is freed to pool when
+    // handler keeps the next block, and it is the replacement of next block
+    size_t heap_allocs = 0;
+    conn.read_ptrs.reserve(3);
+    for (size_t i = 1; i <= 3; ++i) {
+        EXPECT_EQ(1, ::write(fds[1], "a", 1));
+        heap_allocs = t_heap_allocs;
+        for (int j = 0; j < 100 && conn.read_ptrs.size() < i; ++j) {
+            loop.loopOnce(10);
+        }
+        heap_allocs = t_heap_allocs - heap_allocs;
+        ASSERT_EQ(i, conn.read_ptrs.size());
+    }
+    EXPECT_NE(conn.read_ptrs[0], conn.read_ptrs[1]);
+    EXPECT_EQ(conn.read_ptrs[0], conn.read_ptrs[2]);
+    // the third read takes no block from heap
+    EXPECT_EQ(0u, heap_allocs);
+    conn.close();
+    ::close(fds[1]);
+}
@@ -0,0 +1,80 @@
+
+#include <gtest/gtest.h>
+#include "ws/WSHandler.h"
+
+#include <string>
+#include <vector>
+
+using namespace kuma;
+
+namespace {
+// the size of the loop read block that TcpConnection receives into
+const size_t kReadBlockSize = 64 * 1024;
+
+void openClient(WSHandler &handler)
+{
+    handler.setMode(WSHandler::WSMode::CLIENT);
+    std::string rsp = "HTTP/1.1 101 Switching Protocols\r\n"
+                      "Upgrade: websocket\r\n"
+                      "Connection: Upgrade\r\n"
+                      "\r\n";
+    KMBuffer buf(kReadBlockSize);
+    buf.write(rsp.c_str(), rsp.size());
+    EXPECT_EQ(WSHandler::WSError::NOERR, handler.handleData(buf));
+}
+
+std::string encodeFrame(const std::string &payload)
+{
+    uint8_t hdr[WS_MAX_HEADER_SIZE];
+    auto hdr_len = WSHandler::encodeFrameHeader(WSHandler::WS_OPCODE_BINARY, true, nullptr, payload.size(), hdr);
+    return std::string((char*)hdr, hdr_len) + payload;
+}
+}
+
+TEST(WSHandlerTest, Small_Reads_Copied)
+{
+    WSHandler handler;
+    std::string received;
+    handler.setFrameCallback([&received] (uint8_t, bool, KMBuffer &buf) {
+        received.resize(buf.chainLength());
+        buf.readChained(&received[0], received.size());
+    });
+    openClient(handler);
+
+    // a frame of one byte per read, the read blocks are not kept by the partial payload
+    const std::string payload(1000, 'k');
+    auto frame = encodeFrame(payload);
+    std::vector<KMBuffer> blocks;
+    for (auto c : frame) {
+        blocks.emplace_back(kReadBlockSize);
+        auto &block = blocks.back();
+        block.write(&c, 1);
+        handler.handleData(block);
+        EXPECT_FALSE(block.isShared());
+    }
+    EXPECT_EQ(payload, received);
+}
+
+TEST(WSHandlerTest, Large_Reads_Referenced)
+{
+    WSHandler handler;
+    std::string received;
+    handler.setFrameCallback([&received] (uint8_t, bool, KMBuffer &buf) {
+        received.resize(buf.chainLength());
+        buf.readChained(&received[0], received.size());
+    });
+    openClient(handler);
+
+    // the big slice of a read block is referenced without copy
+    const std::string payload(40000, 'k');
+    auto frame = encodeFrame(payload);
+    KMBuffer first(kReadBlockSize);
+    first.write(frame.c_str(), 30000);
+    EXPECT_EQ(WSHandler::WSError::NEED_MORE_DATA, handler.handleData(first));
+    EXPECT_TRUE(first.isShared());
+    KMBuffer second(kReadBlockSize);
+    second.write(frame.c_str() + 30000, frame.size() - 30000);
+    EXPECT_EQ(WSHandler::WSError::NOERR, handler.handleData(second));
+    EXPECT_FALSE(first.isShared());
+    EXPECT_EQ(payload, received);
+}